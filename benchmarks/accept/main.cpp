@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// Accept rate of a blocking `TCPSocket` listener while a single client opens
+// connections back to back, accepting one connection per call or draining the
+// backlog with `accept_batch`.
+
+void run(const std::string &address, uint16_t port, size_t connections, size_t batch) {
+    std::promise<void> ready;
+    std::promise<void> hungup;
+    uint64_t           accepted = 0;
+
+    std::thread server([&]() {
+        auto listener = Sockets::TCPSocket::service(address, port, Sockets::Domain::IPv4);
+        std::vector<std::shared_ptr<Sockets::TCPSocket>> conns;
+
+        conns.reserve(connections);
+        ready.set_value();
+
+        if (batch > 1) {
+            while (conns.size() < connections)
+                listener->accept_batch(conns, std::min(batch, connections - conns.size()));
+        } else {
+            for (size_t i = 0; i < connections; i++)
+                conns.push_back(listener->accept());
+        }
+
+        accepted = Bench::now();
+
+        // Hold on to the connections until the client has closed its end so
+        // that TIME_WAIT lands on the client's ephemeral ports
+        hungup.get_future().wait();
+    });
+
+    ready.get_future().wait();
+
+    std::vector<std::shared_ptr<Sockets::TCPSocket>> socks;
+    Bench::Samples                                   samples;
+
+    socks.reserve(connections);
+    samples.reserve(connections);
+
+    uint64_t start = Bench::now();
+
+    for (size_t i = 0; i < connections; i++) {
+        uint64_t begin = Bench::now();
+        socks.push_back(Sockets::TCPSocket::connect(address, port, Sockets::Domain::IPv4));
+        samples.add(Bench::now() - begin);
+    }
+
+    while (socks.size()) {
+        socks.back()->close();
+        socks.pop_back();
+    }
+
+    hungup.set_value();
+    server.join();
+
+    double seconds = (accepted - start) / 1e9;
+
+    Bench::Record("accept")
+        .field("connections", connections)
+        .field("batch", batch)
+        .field("seconds", seconds)
+        .field("accepts_per_second", static_cast<uint64_t>(connections / seconds))
+        .percentiles(samples)
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address     = opts.get("address", "127.0.0.1");
+    uint16_t    port        = opts.get("port", 23430);
+    size_t      connections = opts.get("connections", 2000);
+    size_t      batch       = opts.get("batch", 64);
+
+    try {
+        run(address, port, connections, 1);
+        run(address, port + 1, connections, batch);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,130 @@
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+#include "../utility/headers/tls.hpp"
+
+// Cost of a short lived connection: connect, send one request, wait for the
+// response and hang up, with and without TCP Fast Open. The first Fast Open
+// connection fetches the cookie, later ones send their first bytes (the
+// request or the ClientHello) with the SYN. Loopback round trips are short,
+// so the saving grows with the real network latency.
+
+void run(const std::string &address, uint16_t port, bool tls, bool fast_open, size_t warmup,
+         size_t iterations, size_t bytes, SSL_CTX *server, SSL_CTX *client) {
+    std::promise<void> ready;
+    std::vector<char>  request(bytes, 'x');
+    size_t             total = warmup + iterations;
+
+    std::thread loop([&]() {
+        std::shared_ptr<Sockets::TCPSocket> listener;
+        std::vector<char>                   buf(bytes);
+
+        if (tls)
+            listener = Sockets::TLSSocket::service(address, port, Sockets::Domain::IPv4, server,
+                                                   Sockets::Operation::Blocking, 1024,
+                                                   fast_open ? 256 : 0);
+        else
+            listener = Sockets::TCPSocket::service(address, port, Sockets::Domain::IPv4,
+                                                   Sockets::Operation::Blocking, 1024,
+                                                   fast_open ? 256 : 0);
+
+        ready.set_value();
+
+        for (size_t i = 0; i < total; i++) {
+            std::shared_ptr<Sockets::TCPSocket> conn;
+
+            if (tls)
+                conn = std::static_pointer_cast<Sockets::TLSSocket>(listener)->accept(server);
+            else
+                conn = listener->accept();
+
+            conn->recv(buf.data(), buf.size());
+            conn->send(buf.data(), buf.size());
+        }
+    });
+
+    ready.get_future().wait();
+
+    Bench::Samples    samples;
+    std::vector<char> buf(bytes);
+    size_t            opened = 0;
+
+    samples.reserve(iterations);
+
+    for (size_t i = 0; i < total; i++) {
+        uint64_t start = Bench::now();
+
+        std::shared_ptr<Sockets::TCPSocket> sock;
+
+        if (tls)
+            sock = Sockets::TLSSocket::connect(address, port, Sockets::Domain::IPv4, client,
+                                               Sockets::Operation::Blocking, fast_open);
+        else
+            sock = Sockets::TCPSocket::connect(address, port, Sockets::Domain::IPv4,
+                                               Sockets::Operation::Blocking, fast_open);
+
+        sock->send(request.data(), request.size());
+        sock->recv(buf.data(), buf.size());
+
+        if (i >= warmup) {
+            samples.add(Bench::now() - start);
+            opened += sock->fast_opened();
+        }
+    }
+
+    loop.join();
+
+    Bench::Record("connect")
+        .field("transport", tls ? "tls" : "tcp")
+        .field("fast_open", fast_open ? "on" : "off")
+        .field("bytes", bytes)
+        .field("syn_data_accepted", opened)
+        .percentiles(samples)
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address    = opts.get("address", "127.0.0.1");
+    uint16_t    port       = opts.get("port", 23490);
+    size_t      warmup     = opts.get("warmup", 100);
+    size_t      iterations = opts.get("iterations", 2000);
+    size_t      bytes      = opts.get("bytes", 64);
+
+    // The server may still be writing its session tickets when a TLS client
+    // hangs up
+    signal(SIGPIPE, SIG_IGN);
+
+    setup_openssl();
+
+    Credentials creds  = generate_credentials();
+    SSL_CTX *   server = setup_server_ctx(creds);
+    SSL_CTX *   client = setup_client_ctx(creds);
+
+    try {
+        // Every run listens on a port of its own, the previous one is left
+        // with connections in TIME_WAIT
+        run(address, port, false, false, warmup, iterations, bytes, server, client);
+        run(address, port + 1, false, true, warmup, iterations, bytes, server, client);
+        run(address, port + 2, true, false, warmup, iterations, bytes, server, client);
+        run(address, port + 3, true, true, warmup, iterations, bytes, server, client);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    SSL_CTX_free(client);
+    SSL_CTX_free(server);
+    free_credentials(creds);
+}
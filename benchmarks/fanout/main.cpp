@@ -0,0 +1,225 @@
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <socket/Polling/polling.hpp>
+#include <socket/Socket/socket.hpp>
+#include <socket/WriteQueue/fanout.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// Cost of sending every message to every subscriber. The baseline calls
+// `send` on one blocking socket after the other, `FanOut` queues the shared
+// buffer on every subscriber and writes out a burst of messages with one
+// `sendv` per subscriber. Samples are the time taken to hand one burst to
+// every subscriber.
+//
+// The stalled runs leave one subscriber unread, which would hang the
+// baseline. `FanOut` skips or evicts it once `--limit=` bytes are queued for
+// it while the others carry on.
+
+enum class Mode { Loop, FanOut };
+
+struct Run {
+    Mode                  mode;
+    size_t                burst;
+    bool                  stalled;
+    Sockets::SlowConsumer policy;
+};
+
+void run(const std::string &address, uint16_t port, const Run &r, size_t subscribers,
+         size_t messages, size_t bytes, size_t limit) {
+    auto listener = Sockets::TCPSocket::service(address, port, Sockets::Domain::IPv4,
+                                                Sockets::Operation::Blocking, 4096);
+
+    std::vector<std::shared_ptr<Sockets::TCPSocket>> clients;
+    std::vector<std::shared_ptr<Sockets::TCPSocket>> conns;
+
+    for (size_t i = 0; i < subscribers; i++) {
+        clients.push_back(Sockets::TCPSocket::connect(address, port, Sockets::Domain::IPv4,
+                                                      Sockets::Operation::Non_blocking));
+        conns.push_back(listener->accept(r.mode == Mode::Loop ? Sockets::Operation::Blocking
+                                                              : Sockets::Operation::Non_blocking));
+    }
+
+    // The stalled subscriber is the first one, nobody reads from it. Small
+    // buffers on both ends make it back up into its queue soon.
+    if (r.stalled) {
+        int size = 4096;
+
+        setsockopt(clients[0]->fd(), SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(conns[0]->fd(), SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+
+    size_t                readers  = r.stalled ? subscribers - 1 : subscribers;
+    uint64_t              expected = (uint64_t)readers * messages * bytes;
+    std::vector<char>     sink(64 * 1024);
+    std::atomic_bool      done(false);
+    std::atomic<uint64_t> received(0);
+
+    std::thread drain([&]() {
+        Sockets::Poll<Sockets::TCPSocket> poll;
+
+        for (size_t i = r.stalled ? 1 : 0; i < subscribers; i++)
+            poll.enroll(clients[i], POLLIN);
+
+        // Skipped messages never arrive, so a run with a stalled subscriber
+        // ends once the sender is done and the sockets are empty
+        while (received < expected) {
+            auto ready = poll.poll(100);
+
+            if (ready[1].empty() && done && r.stalled)
+                break;
+
+            for (auto &c : ready[1]) {
+                size_t n;
+
+                while ((n = c->recv(sink.data(), sink.size())) > 0)
+                    received += n;
+            }
+        }
+    });
+
+    Bench::Samples samples;
+    auto           payload = std::make_shared<const std::string>(bytes, 'x');
+    uint64_t       start   = Bench::now();
+
+    Sockets::FanOut                   fanout(r.policy, limit);
+    Sockets::Poll<Sockets::TCPSocket> writable;
+    std::unordered_set<int>           waiting;
+    int                               stalled = r.stalled ? conns[0]->fd() : -1;
+
+    fanout.on_interest = [&](const std::shared_ptr<Sockets::TCPSocket> &s, bool want) {
+        writable.modify(s, want ? POLLOUT : 0);
+
+        if (want)
+            waiting.insert(s->fd());
+        else
+            waiting.erase(s->fd());
+    };
+
+    fanout.on_evict = [&](const std::shared_ptr<Sockets::TCPSocket> &s, bool) {
+        writable.disenroll(s);
+        waiting.erase(s->fd());
+    };
+
+    if (r.mode == Mode::FanOut) {
+        for (auto &c : conns) {
+            fanout.subscribe(c);
+            writable.enroll(c, 0);
+        }
+    }
+
+    for (size_t sent = 0; sent < messages; sent += r.burst) {
+        size_t   count = std::min(r.burst, messages - sent);
+        uint64_t begin = Bench::now();
+
+        if (r.mode == Mode::Loop) {
+            for (size_t i = 0; i < count; i++)
+                for (auto &c : conns)
+                    c->send(payload->data(), payload->size());
+        } else {
+            // A fresh buffer per message, as a publisher would have
+            for (size_t i = 0; i < count; i++)
+                fanout.publish(std::make_shared<const std::string>(*payload));
+
+            fanout.flush();
+
+            if (waiting.size() > waiting.count(stalled)) {
+                auto ready = writable.poll(0);
+
+                for (auto &s : ready[2])
+                    fanout.ready(s);
+            }
+        }
+
+        samples.add(Bench::now() - begin);
+    }
+
+    // Wait for everything but the stalled subscriber to drain
+    while (waiting.size() > waiting.count(stalled)) {
+        auto ready = writable.poll(100);
+
+        for (auto &s : ready[2])
+            if (s->fd() != stalled)
+                fanout.ready(s);
+    }
+
+    uint64_t elapsed = Bench::now() - start;
+
+    done = true;
+    drain.join();
+
+    const Sockets::FanOutStatistics &stats = fanout.statistics();
+
+    Bench::Record("fanout")
+        .field("mode", r.mode == Mode::Loop ? "loop" : "fanout")
+        .field("subscribers", subscribers)
+        .field("bytes", bytes)
+        .field("burst", r.burst)
+        .field("stalled", r.stalled ? "yes" : "no")
+        .field("policy", r.policy == Sockets::SlowConsumer::Skip ? "skip" : "evict")
+        .field("deliveries_per_sec", (uint64_t)(1e9 * messages * subscribers / elapsed))
+        .field("ns_per_delivery", elapsed / (messages * subscribers))
+        .field("flushes", stats.flushes)
+        .field("skipped", stats.skipped)
+        .field("evicted", stats.evicted)
+        .field("received", received.load())
+        .percentiles(samples)
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address     = opts.get("address", "127.0.0.1");
+    uint16_t    port        = opts.get("port", 23500);
+    size_t      subscribers = opts.get("subscribers", 256);
+    size_t      messages    = opts.get("messages", 2000);
+    size_t      bytes       = opts.get("bytes", 512);
+    size_t      burst       = opts.get("burst", 16);
+    size_t      limit       = opts.get("limit", 64 * 1024);
+
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    if (subscribers * 3 + 64 > lim.rlim_cur) {
+        std::cerr << "Too many subscribers for a descriptor limit of " << lim.rlim_cur
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    const Sockets::SlowConsumer skip  = Sockets::SlowConsumer::Skip;
+    const Sockets::SlowConsumer evict = Sockets::SlowConsumer::Evict;
+
+    std::vector<Run> runs = {
+        {Mode::Loop, 1, false, skip},
+        {Mode::FanOut, 1, false, skip},
+        {Mode::FanOut, burst, false, skip},
+        {Mode::FanOut, burst, true, skip},
+        {Mode::FanOut, burst, true, evict},
+    };
+
+    try {
+        // Every run listens on a port of its own, the previous one is left
+        // with connections in TIME_WAIT
+        for (size_t i = 0; i < runs.size(); i++)
+            run(address, port + i, runs[i], subscribers, messages, bytes, limit);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+
+#include <socket/Handshake/handshake.hpp>
+#include <socket/Polling/polling.hpp>
+#include <socket/Socket/socket.hpp>
+#include <socket/ThreadPool/threadpool.hpp>
+
+#include "../utility/headers/bench.hpp"
+#include "../utility/headers/tls.hpp"
+
+// TLS handshake rate of a single event loop thread, either running every
+// handshake inline or handing them to a `HandshakePool`. Besides the rate the
+// time the loop spends per iteration is recorded, which is how long any other
+// connection served by the loop would have to wait.
+
+void run(const std::string &address, uint16_t port, size_t workers, size_t clients,
+         size_t handshakes, SSL_CTX *server, SSL_CTX *client) {
+    std::promise<void> ready;
+    Bench::Samples     stalls;
+    uint64_t           finished = 0;
+
+    stalls.reserve(handshakes);
+
+    std::thread loop([&]() {
+        auto listener = Sockets::TCPSocket::service(address, port, Sockets::Domain::IPv4,
+                                                    Sockets::Operation::Non_blocking, 1024);
+
+        std::unique_ptr<Sockets::ThreadPool>    pool;
+        std::unique_ptr<Sockets::HandshakePool> offload;
+
+        if (workers) {
+            pool.reset(new Sockets::ThreadPool(workers));
+            offload.reset(new Sockets::HandshakePool(*pool, server));
+        }
+
+        Sockets::Poll<Sockets::TCPSocket> poll;
+        poll.enroll(listener, POLLIN);
+
+        std::vector<std::shared_ptr<Sockets::TCPSocket>> conns;
+        std::vector<std::shared_ptr<Sockets::TLSSocket>> done;
+        size_t                                           count = 0;
+
+        ready.set_value();
+
+        while (count < handshakes) {
+            poll.poll(1);
+
+            uint64_t begin = Bench::now();
+
+            if (offload) {
+                offload->accept(*listener);
+                count += offload->collect(done);
+            } else {
+                listener->accept_batch(conns, 64);
+
+                for (auto &conn : conns) {
+                    try {
+                        done.push_back(Sockets::TLSSocket::upgrade(*conn, server));
+                        count++;
+                    } catch (const std::exception &e) {
+                    }
+                }
+
+                conns.clear();
+            }
+
+            stalls.add(Bench::now() - begin);
+            done.clear();
+        }
+
+        finished = Bench::now();
+    });
+
+    ready.get_future().wait();
+
+    std::vector<std::thread> threads;
+    uint64_t                 start = Bench::now();
+
+    for (size_t i = 0; i < clients; i++) {
+        threads.emplace_back([&, i]() {
+            for (size_t j = i; j < handshakes; j += clients)
+                Sockets::TLSSocket::connect(address, port, Sockets::Domain::IPv4, client);
+        });
+    }
+
+    for (auto &t : threads)
+        t.join();
+
+    loop.join();
+
+    double seconds = (finished - start) / 1e9;
+
+    Bench::Record("handshake")
+        .field("workers", workers)
+        .field("clients", clients)
+        .field("handshakes", handshakes)
+        .field("seconds", seconds)
+        .field("handshakes_per_second", static_cast<uint64_t>(handshakes / seconds))
+        .percentiles(stalls)
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address    = opts.get("address", "127.0.0.1");
+    uint16_t    port       = opts.get("port", 23440);
+    size_t      handshakes = opts.get("handshakes", 2000);
+    size_t      cores      = std::max(1u, std::thread::hardware_concurrency());
+    size_t      clients    = opts.get("clients", cores);
+
+    std::vector<size_t> workers = {0, 1, 2, 4, cores};
+    std::sort(workers.begin(), workers.end());
+    workers.erase(std::unique(workers.begin(), workers.end()), workers.end());
+
+    // Clients hang up straight after their handshake, possibly before the
+    // server has sent its session tickets
+    signal(SIGPIPE, SIG_IGN);
+
+    setup_openssl();
+
+    Credentials creds  = generate_credentials();
+    SSL_CTX *   server = setup_server_ctx(creds);
+    SSL_CTX *   client = setup_client_ctx(creds);
+
+    try {
+        for (size_t i = 0; i < workers.size(); i++)
+            run(address, port + i, workers[i], clients, handshakes, server, client);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    SSL_CTX_free(client);
+    SSL_CTX_free(server);
+    free_credentials(creds);
+}
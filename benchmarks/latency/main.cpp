@@ -0,0 +1,268 @@
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+#include "../utility/headers/tls.hpp"
+
+// Loopback ping-pong latency. The client sends a message of a given size, the
+// server echoes it back and the round trip is recorded. For UDP the round trip
+// is also broken down with kernel timestamps.
+
+const std::vector<size_t> sizes = {16, 64, 256, 1024, 4096, 16384};
+
+template <class S>
+void echo(std::shared_ptr<S> conn, size_t rounds) {
+    std::vector<char> buf(sizes.back());
+
+    for (auto size : sizes) {
+        for (size_t i = 0; i < rounds; i++) {
+            conn->recv(buf.data(), size);
+            conn->send(buf.data(), size);
+        }
+    }
+}
+
+// Wait for the client to hang up first so the server port does not end up in
+// TIME_WAIT and block the next run
+template <class S>
+void linger(std::shared_ptr<S> conn) {
+    char c;
+
+    try {
+        conn->recv(&c, 1);
+    } catch (const std::exception &e) {
+    }
+}
+
+template <class S>
+void pingpong(const std::string &transport, std::shared_ptr<S> sock, size_t warmup,
+              size_t iterations) {
+    std::vector<char> buf(sizes.back(), 'x');
+
+    for (auto size : sizes) {
+        Bench::Samples samples;
+        samples.reserve(iterations);
+
+        for (size_t i = 0; i < warmup + iterations; i++) {
+            uint64_t start = Bench::now();
+
+            sock->send(buf.data(), size);
+            sock->recv(buf.data(), size);
+
+            if (i >= warmup)
+                samples.add(Bench::now() - start);
+        }
+
+        Bench::Record("latency")
+            .field("transport", transport)
+            .field("size", size)
+            .percentiles(samples)
+            .emit();
+    }
+}
+
+void tcp(const std::string &address, uint16_t port, size_t warmup, size_t iterations) {
+    std::promise<void> ready;
+
+    std::thread server([&]() {
+        auto listener = Sockets::TCPSocket::service(address, port, Sockets::Domain::IPv4);
+        ready.set_value();
+
+        auto conn = listener->accept();
+        echo(conn, warmup + iterations);
+        linger(conn);
+    });
+
+    ready.get_future().wait();
+
+    auto sock = Sockets::TCPSocket::connect(address, port, Sockets::Domain::IPv4);
+    pingpong("tcp", sock, warmup, iterations);
+    sock->close();
+
+    server.join();
+}
+
+void udp(const std::string &address, uint16_t port, size_t warmup, size_t iterations) {
+    std::promise<void> ready;
+
+    std::thread server([&]() {
+        auto listener = Sockets::UDPSocket::service(address, port, Sockets::Domain::IPv4);
+        ready.set_value();
+
+        echo(listener, warmup + iterations);
+    });
+
+    ready.get_future().wait();
+
+    auto sock = Sockets::UDPSocket::connect(address, port, Sockets::Domain::IPv4);
+    pingpong("udp", sock, warmup, iterations);
+
+    server.join();
+}
+
+void tls(const std::string &address, uint16_t port, size_t warmup, size_t iterations) {
+    Credentials        creds  = generate_credentials();
+    SSL_CTX *          server = setup_server_ctx(creds);
+    SSL_CTX *          client = setup_client_ctx(creds);
+    std::promise<void> ready;
+
+    std::thread t([&]() {
+        auto listener =
+            Sockets::TLSSocket::service(address, port, Sockets::Domain::IPv4, server);
+        ready.set_value();
+
+        auto conn = listener->accept(server);
+        echo(conn, warmup + iterations);
+        linger(conn);
+    });
+
+    ready.get_future().wait();
+
+    auto sock = Sockets::TLSSocket::connect(address, port, Sockets::Domain::IPv4, client);
+    pingpong("tls", sock, warmup, iterations);
+    sock->close();
+
+    t.join();
+
+    SSL_CTX_free(client);
+    SSL_CTX_free(server);
+    free_credentials(creds);
+}
+
+void dtls(const std::string &address, uint16_t port, size_t warmup, size_t iterations) {
+    Credentials        creds  = generate_credentials();
+    SSL_CTX *          server = setup_server_ctx(creds, DTLS_server_method());
+    SSL_CTX *          client = setup_client_ctx(creds, DTLS_client_method());
+    std::promise<void> ready;
+
+    std::thread t([&]() {
+        auto listener = Sockets::DTLSSocket::service(address, port, Sockets::Domain::IPv4);
+        ready.set_value();
+
+        auto conn = listener->accept(server);
+        echo(conn, warmup + iterations);
+    });
+
+    ready.get_future().wait();
+
+    auto sock = Sockets::DTLSSocket::connect(address, port, Sockets::Domain::IPv4, client);
+    pingpong("dtls", sock, warmup, iterations);
+
+    t.join();
+    sock->close();
+
+    SSL_CTX_free(client);
+    SSL_CTX_free(server);
+    free_credentials(creds);
+}
+
+// Kernel timestamps are taken from the realtime clock
+uint64_t realtime() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Where the time of a UDP round trip goes. `tx` is the time from calling
+// `send` until the kernel hands the datagram to the device, `rx` the time from
+// the kernel receiving the reply until the application has read it.
+void stages(const std::string &address, uint16_t port, size_t warmup, size_t iterations) {
+    std::promise<void> ready;
+
+    std::thread server([&]() {
+        auto listener = Sockets::UDPSocket::service(address, port, Sockets::Domain::IPv4);
+        ready.set_value();
+
+        echo(listener, warmup + iterations);
+    });
+
+    ready.get_future().wait();
+
+    auto sock = Sockets::UDPSocket::connect(address, port, Sockets::Domain::IPv4);
+
+    std::vector<char>                 buf(sizes.back(), 'x');
+    std::vector<Sockets::TxTimestamp> stamps;
+    Sockets::Peer                     peer;
+    Sockets::Timestamp                ts;
+
+    sock->timestamping(true);
+
+    for (auto size : sizes) {
+        Bench::Samples tx;
+        Bench::Samples rx;
+
+        tx.reserve(iterations);
+        rx.reserve(iterations);
+
+        for (size_t i = 0; i < warmup + iterations; i++) {
+            uint64_t sent = realtime();
+
+            sock->send(buf.data(), size);
+            sock->recv_from(buf.data(), size, peer, ts);
+
+            uint64_t read = realtime();
+
+            stamps.clear();
+            sock->tx_timestamps(stamps);
+
+            if (i < warmup)
+                continue;
+
+            rx.add(read - ts.software);
+
+            for (auto &it : stamps)
+                if (it.id == sock->tx_id() && it.time.software >= sent)
+                    tx.add(it.time.software - sent);
+        }
+
+        Bench::Record("latency_stage")
+            .field("transport", "udp")
+            .field("stage", "tx")
+            .field("size", size)
+            .percentiles(tx)
+            .emit();
+
+        Bench::Record("latency_stage")
+            .field("transport", "udp")
+            .field("stage", "rx")
+            .field("size", size)
+            .percentiles(rx)
+            .emit();
+    }
+
+    server.join();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address    = opts.get("address", "127.0.0.1");
+    uint16_t    port       = opts.get("port", 23400);
+    size_t      warmup     = opts.get("warmup", 1000);
+    size_t      iterations = opts.get("iterations", 20000);
+
+    setup_openssl();
+
+    try {
+        tcp(address, port, warmup, iterations);
+        udp(address, port + 1, warmup, iterations);
+        tls(address, port + 2, warmup, iterations);
+        dtls(address, port + 3, warmup, iterations);
+        stages(address, port + 4, warmup, iterations);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        ERR_print_errors_fp(stderr);
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,646 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <signal.h>
+#include <sys/resource.h>
+
+#include <socket/Polling/polling.hpp>
+#include <socket/Socket/socket.hpp>
+#include <socket/Statistics/histogram.hpp>
+
+#include "../utility/headers/bench.hpp"
+#include "../utility/headers/tls.hpp"
+
+// Open loop load generator in the spirit of wrk2. A few threads spread many
+// connections between them and send requests on a fixed schedule, whether or
+// not earlier requests have been answered. Latency is measured from when a
+// request was due rather than from when it went out, so a stalled server is
+// charged for every request it held up instead of just the one in flight.
+//
+// Requests are `--payload` bytes which the server has to echo back. Either a
+// built-in echo server is started on `--port`, or with `--server=none` an
+// echo server which is already running there is targeted. A TLS server of
+// our own is trusted through `--ca=`.
+
+enum class Protocol { TCP, TLS, UDP };
+
+struct Config {
+    std::string address;
+    uint16_t    port;
+    Protocol    protocol;
+    size_t      connections;
+    size_t      threads;
+    size_t      rate;
+    size_t      payload;
+    uint64_t    duration_ns;
+    uint64_t    warmup_ns;
+    SSL_CTX *   client = nullptr;
+    SSL_CTX *   server = nullptr;
+};
+
+const char *name(Protocol p) {
+    switch (p) {
+    case Protocol::TCP:
+        return "tcp";
+    case Protocol::TLS:
+        return "tls";
+    default:
+        return "udp";
+    }
+}
+
+/**
+ * @brief What one client thread saw. Merged into the final report once every
+ * thread is done.
+ *
+ */
+struct Results {
+    uint64_t scheduled  = 0;
+    uint64_t completed  = 0;
+    uint64_t unanswered = 0;
+    uint64_t errors     = 0;
+    uint64_t min_ns     = UINT64_MAX;
+    uint64_t max_ns     = 0;
+
+    Sockets::HistogramSnapshot latency;
+};
+
+// Stream echo servers answer in order, so the response completing the head
+// of `due` belongs to the oldest request. Datagrams may be lost or reordered
+// and carry the time they were due in their first bytes instead.
+template <class S>
+struct Connection {
+    std::shared_ptr<S>   sock;
+    std::deque<uint64_t> due;
+    size_t               queued   = 0;
+    size_t               offset   = 0;
+    size_t               received = 0;
+    bool                 writing  = false;
+    bool                 alive    = true;
+};
+
+size_t transmit(Sockets::TCPSocket &s, const char *buf, size_t len, const Sockets::Peer &) {
+    return s.send(buf, len);
+}
+
+size_t transmit(Sockets::UDPSocket &s, const char *buf, size_t len, const Sockets::Peer &to) {
+    return s.send_to(buf, len, to);
+}
+
+size_t receive(Sockets::TCPSocket &s, char *buf, size_t len) { return s.recv(buf, len); }
+
+size_t receive(Sockets::UDPSocket &s, char *buf, size_t len) {
+    Sockets::Peer from;
+    return s.recv_from(buf, len, from);
+}
+
+std::shared_ptr<Sockets::TCPSocket> open_stream(const Config &cfg) {
+    if (cfg.protocol == Protocol::TLS)
+        return Sockets::TLSSocket::connect(cfg.address, cfg.port, Sockets::Domain::IPv4, cfg.client,
+                                           Sockets::Operation::Non_blocking);
+
+    return Sockets::TCPSocket::connect(cfg.address, cfg.port, Sockets::Domain::IPv4,
+                                       Sockets::Operation::Non_blocking);
+}
+
+template <class S>
+class Client {
+    static const bool datagram = std::is_same<S, Sockets::UDPSocket>::value;
+
+    const Config &cfg;
+    Results &     out;
+    uint64_t      measure_from;
+
+    std::vector<Connection<S>>      conns;
+    std::unordered_map<int, size_t> index;
+    Sockets::Poll<S>                poll;
+    Sockets::Peer                   server;
+    Sockets::Histogram              latency;
+
+    std::vector<char> request;
+    std::vector<char> buffer;
+
+    void complete(uint64_t due, uint64_t now) {
+        if (due < this->measure_from)
+            return;
+
+        uint64_t took = now - due;
+
+        this->latency.add(took);
+        this->out.completed++;
+        this->out.min_ns = std::min(this->out.min_ns, took);
+        this->out.max_ns = std::max(this->out.max_ns, took);
+    }
+
+    void fail(Connection<S> &c) {
+        if (!c.alive)
+            return;
+
+        c.alive = false;
+        this->out.errors++;
+        this->poll.disenroll(c.sock);
+    }
+
+    void flush(Connection<S> &c) {
+        while (c.alive && c.queued) {
+            // Datagrams carry the time they were due, a retry after a full
+            // send buffer simply stamps the next one
+            if (datagram) {
+                uint64_t stamp = c.due[c.due.size() - c.queued];
+                std::memcpy(this->request.data(), &stamp, sizeof(stamp));
+            }
+
+            size_t n = 0;
+
+            try {
+                n = transmit(*c.sock, &this->request[c.offset], this->request.size() - c.offset,
+                             this->server);
+            } catch (const std::exception &e) {
+                this->fail(c);
+                return;
+            }
+
+            if (n == 0)
+                break;
+
+            c.offset += n;
+
+            if (c.offset == this->request.size()) {
+                c.offset = 0;
+                c.queued--;
+            }
+        }
+
+        if (c.alive && c.writing != (c.queued > 0)) {
+            c.writing = c.queued > 0;
+            this->poll.modify(c.sock, c.writing ? POLLIN | POLLOUT : POLLIN);
+        }
+    }
+
+    void drain(Connection<S> &c, uint64_t now) {
+        while (c.alive) {
+            size_t n = 0;
+
+            errno = 0;
+
+            try {
+                n = receive(*c.sock, this->buffer.data(), this->buffer.size());
+            } catch (const std::exception &e) {
+                this->fail(c);
+                return;
+            }
+
+            if (n == 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    this->fail(c);
+                return;
+            }
+
+            if (datagram) {
+                uint64_t stamp = 0;
+
+                if (n >= sizeof(stamp) && !c.due.empty()) {
+                    std::memcpy(&stamp, this->buffer.data(), sizeof(stamp));
+                    this->complete(stamp, now);
+                    c.due.pop_front();
+                }
+
+                continue;
+            }
+
+            c.received += n;
+
+            while (c.received >= this->request.size() && !c.due.empty()) {
+                this->complete(c.due.front(), now);
+                c.due.pop_front();
+                c.received -= this->request.size();
+            }
+        }
+    }
+
+    public:
+    Client(const Config &cfg, Results &out, size_t count)
+        : cfg(cfg), out(out), request(std::max<size_t>(cfg.payload, 8), 'x'),
+          buffer(std::max<size_t>(64 * 1024, cfg.payload)) {
+        std::string address = cfg.address;
+
+        auto addr =
+            Sockets::resolve(address, cfg.port, Sockets::Domain::IPv4, Sockets::Type::Datagram);
+
+        std::memcpy(&this->server.addr, addr->ai_addr, addr->ai_addrlen);
+        this->server.len = addr->ai_addrlen;
+        freeaddrinfo(addr);
+
+        this->conns.resize(count);
+
+        for (auto &c : this->conns) {
+            c.sock = open(cfg);
+            this->index[c.sock->fd()] = &c - this->conns.data();
+            this->poll.enroll(c.sock, POLLIN);
+        }
+    }
+
+    static std::shared_ptr<S> open(const Config &cfg);
+
+    void run(uint64_t start) {
+        uint64_t interval = 1000000000ULL * this->cfg.threads / std::max<size_t>(1, this->cfg.rate);
+        uint64_t end      = start + this->cfg.warmup_ns + this->cfg.duration_ns;
+        uint64_t next     = start;
+        size_t   turn     = 0;
+
+        this->measure_from = start + this->cfg.warmup_ns;
+
+        // Responses to requests which went out in time are waited for a
+        // little past the end of the run
+        uint64_t grace = end + 1000000000ULL;
+
+        while (true) {
+            uint64_t now = Sockets::now_ns();
+
+            while (next <= now && next < end) {
+                Connection<S> &c = this->conns[turn++ % this->conns.size()];
+
+                if (c.alive) {
+                    c.due.push_back(next);
+                    c.queued++;
+
+                    if (next >= this->measure_from)
+                        this->out.scheduled++;
+
+                    this->flush(c);
+                }
+
+                next += interval;
+            }
+
+            bool waiting = false;
+
+            for (auto &c : this->conns)
+                waiting |= c.alive && !c.due.empty();
+
+            if (now >= grace || (now >= end && !waiting))
+                break;
+
+            // Sleep until the next request is due, rounded up to what `poll`
+            // can time. Requests which go out late still count from when
+            // they were due.
+            uint64_t until   = next < end ? next : grace;
+            int      timeout = until > now ? (until - now + 999999) / 1000000 : 0;
+
+            auto activity = this->poll.poll(timeout);
+
+            now = Sockets::now_ns();
+
+            for (auto &it : activity[0])
+                this->fail(this->conns[this->index[it->fd()]]);
+
+            for (auto &it : activity[1])
+                this->drain(this->conns[this->index[it->fd()]], now);
+
+            for (auto &it : activity[2])
+                this->flush(this->conns[this->index[it->fd()]]);
+        }
+
+        for (auto &c : this->conns)
+            for (auto due : c.due)
+                if (due >= this->measure_from)
+                    this->out.unanswered++;
+
+        this->latency.accumulate(this->out.latency);
+    }
+};
+
+template <>
+std::shared_ptr<Sockets::TCPSocket> Client<Sockets::TCPSocket>::open(const Config &cfg) {
+    return open_stream(cfg);
+}
+
+template <>
+std::shared_ptr<Sockets::UDPSocket> Client<Sockets::UDPSocket>::open(const Config &cfg) {
+    return Sockets::UDPSocket::connect(cfg.address, cfg.port, Sockets::Domain::IPv4,
+                                       Sockets::Operation::Non_blocking);
+}
+
+// Single threaded echo server for streams. Whatever arrives is written back,
+// output which does not fit the socket buffer waits for it to drain.
+void echo_stream(const Config &cfg, std::atomic<bool> &running, std::promise<void> &ready) {
+    auto listener = Sockets::TCPSocket::service(cfg.address, cfg.port, Sockets::Domain::IPv4,
+                                                Sockets::Operation::Non_blocking, 4096);
+
+    Sockets::Poll<Sockets::TCPSocket>                poll;
+    std::unordered_map<int, std::string>             backlog;
+    std::vector<std::shared_ptr<Sockets::TCPSocket>> accepted;
+    std::vector<char>                                buf(64 * 1024);
+
+    poll.enroll(listener, POLLIN);
+    ready.set_value();
+
+    auto drop = [&](const std::shared_ptr<Sockets::TCPSocket> &s) {
+        backlog.erase(s->fd());
+        poll.disenroll(s);
+    };
+
+    auto write = [&](const std::shared_ptr<Sockets::TCPSocket> &s, const char *data, size_t len) {
+        std::string &rest = backlog[s->fd()];
+        size_t       n    = 0;
+
+        if (rest.empty())
+            n = s->send(data, len);
+
+        rest.append(data + n, len - n);
+        poll.modify(s, rest.empty() ? POLLIN : POLLIN | POLLOUT);
+    };
+
+    while (running.load()) {
+        auto activity = poll.poll(100);
+
+        for (auto &it : activity[0])
+            if (it != listener)
+                drop(it);
+
+        for (auto &it : activity[1]) {
+            if (it == listener) {
+                listener->accept_batch(accepted, 64, Sockets::Operation::Non_blocking);
+
+                for (auto &conn : accepted) {
+                    try {
+                        if (cfg.protocol == Protocol::TLS)
+                            poll.enroll(
+                                Sockets::TLSSocket::upgrade(*conn, cfg.server,
+                                                            Sockets::Operation::Non_blocking),
+                                POLLIN);
+                        else
+                            poll.enroll(conn, POLLIN);
+                    } catch (const std::exception &e) {
+                    }
+                }
+
+                accepted.clear();
+                continue;
+            }
+
+            if (!poll.enrolled(it))
+                continue;
+
+            try {
+                while (true) {
+                    errno    = 0;
+                    size_t n = it->recv(buf.data(), buf.size());
+
+                    if (n == 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK)
+                            drop(it);
+                        break;
+                    }
+
+                    write(it, buf.data(), n);
+                }
+            } catch (const std::exception &e) {
+                drop(it);
+            }
+        }
+
+        for (auto &it : activity[2]) {
+            if (!poll.enrolled(it))
+                continue;
+
+            std::string rest;
+
+            rest.swap(backlog[it->fd()]);
+
+            try {
+                write(it, rest.data(), rest.size());
+            } catch (const std::exception &e) {
+                drop(it);
+            }
+        }
+    }
+}
+
+void echo_datagram(const Config &cfg, std::atomic<bool> &running, std::promise<void> &ready) {
+    auto sock = Sockets::UDPSocket::service(cfg.address, cfg.port, Sockets::Domain::IPv4,
+                                            Sockets::Operation::Non_blocking);
+
+    Sockets::Poll<Sockets::UDPSocket> poll;
+    Sockets::Peer                     from;
+    std::vector<char>                 buf(64 * 1024);
+
+    sock->receive_buffer(4 * 1024 * 1024);
+    poll.enroll(sock, POLLIN);
+    ready.set_value();
+
+    while (running.load()) {
+        poll.poll(100);
+
+        // Replies which do not fit the send buffer are dropped like any
+        // other datagram
+        while (size_t n = sock->recv_from(buf.data(), buf.size(), from))
+            sock->send_to(buf.data(), n, from);
+    }
+}
+
+template <class S>
+void generate(const Config &cfg, Results &total) {
+    std::vector<Results>     results(cfg.threads);
+    std::vector<std::thread> threads;
+    std::atomic<size_t>      connected(0);
+    std::atomic<bool>        failed(false);
+    std::atomic<uint64_t>    start(0);
+
+    for (size_t i = 0; i < cfg.threads; i++) {
+        size_t count = cfg.connections / cfg.threads + (i < cfg.connections % cfg.threads);
+
+        threads.emplace_back([&, i, count]() {
+            std::unique_ptr<Client<S>> client;
+
+            try {
+                client.reset(new Client<S>(cfg, results[i], std::max<size_t>(1, count)));
+            } catch (const std::exception &e) {
+                std::cerr << e.what() << std::endl;
+                failed = true;
+            }
+
+            // Everyone starts on the same schedule once all connections are up
+            connected++;
+
+            while (connected.load() < cfg.threads)
+                std::this_thread::yield();
+
+            if (i == 0)
+                start = Sockets::now_ns() + 10000000;
+
+            while (start.load() == 0)
+                std::this_thread::yield();
+
+            if (client && !failed.load())
+                client->run(start.load());
+        });
+    }
+
+    for (auto &t : threads)
+        t.join();
+
+    if (failed.load())
+        throw std::runtime_error("Error when opening connections");
+
+    for (auto &r : results) {
+        total.scheduled += r.scheduled;
+        total.completed += r.completed;
+        total.unanswered += r.unanswered;
+        total.errors += r.errors;
+        total.min_ns = std::min(total.min_ns, r.min_ns);
+        total.max_ns = std::max(total.max_ns, r.max_ns);
+        total.latency += r.latency;
+    }
+}
+
+void run(Config cfg, bool builtin) {
+    std::atomic<bool>  running(true);
+    std::promise<void> ready;
+    std::thread        server;
+    Results            total;
+
+    if (builtin) {
+        server = std::thread([&]() {
+            if (cfg.protocol == Protocol::UDP)
+                echo_datagram(cfg, running, ready);
+            else
+                echo_stream(cfg, running, ready);
+        });
+
+        ready.get_future().wait();
+    }
+
+    try {
+        if (cfg.protocol == Protocol::UDP)
+            generate<Sockets::UDPSocket>(cfg, total);
+        else
+            generate<Sockets::TCPSocket>(cfg, total);
+    } catch (...) {
+        running = false;
+
+        if (server.joinable())
+            server.join();
+
+        throw;
+    }
+
+    running = false;
+
+    if (server.joinable())
+        server.join();
+
+    double seconds = cfg.duration_ns / 1e9;
+
+    Bench::Record("loadgen")
+        .field("protocol", name(cfg.protocol))
+        .field("connections", cfg.connections)
+        .field("threads", cfg.threads)
+        .field("payload", std::max<size_t>(cfg.payload, 8))
+        .field("seconds", seconds)
+        .field("target_rate", cfg.rate)
+        .field("requests", total.scheduled)
+        .field("completed", total.completed)
+        .field("unanswered", total.unanswered)
+        .field("errors", total.errors)
+        .field("requests_per_second", static_cast<uint64_t>(total.completed / seconds))
+        .field("min_ns", total.completed ? total.min_ns : 0)
+        .field("p50_ns", total.latency.percentile(50))
+        .field("p90_ns", total.latency.percentile(90))
+        .field("p99_ns", total.latency.percentile(99))
+        .field("p999_ns", total.latency.percentile(99.9))
+        .field("p9999_ns", total.latency.percentile(99.99))
+        .field("max_ns", total.max_ns)
+        .field("mean_ns", static_cast<uint64_t>(total.latency.mean()))
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+    Config         cfg;
+
+    cfg.address     = opts.get("address", "127.0.0.1");
+    cfg.port        = opts.get("port", 23470);
+    cfg.connections = std::max<size_t>(1, opts.get("connections", 256));
+    cfg.threads     = std::max<size_t>(1, std::min(opts.get("threads", 2), cfg.connections));
+    cfg.rate        = opts.get("rate", 20000);
+    cfg.payload     = opts.get("payload", 64);
+    cfg.duration_ns = opts.get("duration", 3) * 1000000000ULL;
+    cfg.warmup_ns   = opts.get("warmup", 1) * 1000000000ULL;
+
+    std::string protocol = opts.get("protocol", "all");
+    std::string ca       = opts.get("ca", "");
+    bool        builtin  = opts.get("server", "builtin") != "none";
+
+    // Every connection is a descriptor on both ends, plus the duplicates
+    // held for a moment while a batch is upgraded to TLS
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    if (cfg.connections * 2 + 128 > lim.rlim_cur) {
+        std::cerr << "Too many connections for a descriptor limit of " << lim.rlim_cur
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // A client which goes away mid-write must not take the server with it
+    signal(SIGPIPE, SIG_IGN);
+    setup_openssl();
+
+    Credentials creds = generate_credentials();
+
+    cfg.server = setup_server_ctx(creds);
+    cfg.client = setup_client_ctx(creds);
+
+    // The echo server retries writes with whatever has piled up since
+    SSL_CTX_set_mode(cfg.server, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    if (!ca.empty() && SSL_CTX_load_verify_locations(cfg.client, ca.c_str(), NULL) != 1)
+        fail_openssl();
+
+    std::vector<Protocol> runs;
+
+    if (protocol == "tcp" || protocol == "all")
+        runs.push_back(Protocol::TCP);
+    if (protocol == "tls" || protocol == "all")
+        runs.push_back(Protocol::TLS);
+    if (protocol == "udp" || protocol == "all")
+        runs.push_back(Protocol::UDP);
+
+    if (runs.empty()) {
+        std::cerr << "Unknown protocol " << protocol << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+
+    try {
+        for (auto p : runs) {
+            cfg.protocol = p;
+            run(cfg, builtin);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        status = EXIT_FAILURE;
+    }
+
+    SSL_CTX_free(cfg.server);
+    SSL_CTX_free(cfg.client);
+    free_credentials(creds);
+
+    return status;
+}
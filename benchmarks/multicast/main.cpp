@@ -0,0 +1,98 @@
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <socket/Polling/polling.hpp>
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// Multicast receive rate over the host's own loopback of a group. A sender
+// publishes datagrams as fast as it can and the subscriber counts what
+// arrived along with what the kernel dropped on a full receive buffer.
+
+const std::vector<size_t> sizes = {64, 512, 1400};
+
+void run(const std::string &group, uint16_t port, const std::string &interface, size_t size,
+         size_t datagrams, size_t rcvbuf) {
+    std::promise<void> ready;
+
+    std::thread subscriber([&]() {
+        auto sock = Sockets::UDPSocket::subscribe(group, port, Sockets::Domain::IPv4,
+                                                  Sockets::Operation::Blocking, interface);
+        auto pd   = Sockets::Poll<Sockets::UDPSocket>();
+
+        size_t effective = sock->receive_buffer(rcvbuf);
+        sock->count_drops(true);
+
+        std::vector<char> buf(size);
+        Sockets::Peer     peer;
+        size_t            received = 0;
+        uint64_t          first    = 0;
+        uint64_t          last     = 0;
+
+        pd.enroll(sock, POLLIN);
+        ready.set_value();
+
+        // Stop once the group has been quiet for a while
+        while (!pd.poll(received ? 200 : 5000)[1].empty()) {
+            sock->recv_from(buf.data(), size, peer);
+            last = Bench::now();
+
+            if (received++ == 0)
+                first = last;
+        }
+
+        double seconds = (last - first) / 1e9;
+
+        Bench::Record("multicast")
+            .field("size", size)
+            .field("sent", datagrams)
+            .field("received", received)
+            .field("dropped", sock->dropped())
+            .field("rcvbuf", effective)
+            .field("seconds", seconds)
+            .field("messages_per_second",
+                   static_cast<uint64_t>(seconds > 0 ? received / seconds : 0))
+            .field("loss", 1.0 - static_cast<double>(received) / datagrams)
+            .emit();
+    });
+
+    ready.get_future().wait();
+
+    auto              sock = Sockets::UDPSocket::connect(group, port, Sockets::Domain::IPv4);
+    std::vector<char> buf(size, 'x');
+
+    sock->multicast_loop(true);
+    sock->multicast_ttl(0);
+
+    if (!interface.empty())
+        sock->multicast_interface(interface);
+
+    for (size_t n = 0; n < datagrams; n++)
+        sock->send(buf.data(), size);
+
+    subscriber.join();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string group     = opts.get("group", "239.255.42.1");
+    std::string interface = opts.get("interface", "");
+    uint16_t    port      = opts.get("port", 23450);
+    size_t      datagrams = opts.get("datagrams", 200000);
+    size_t      rcvbuf    = opts.get("rcvbuf", 8 << 20);
+
+    try {
+        for (auto size : sizes)
+            run(group, port, interface, size, datagrams, rcvbuf);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
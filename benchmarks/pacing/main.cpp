@@ -0,0 +1,184 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include <socket/Pacing/pacer.hpp>
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// A UDP sender producing a frame of datagrams every `--frame_us=` towards a
+// receiver with a small buffer which only gets to drain it every
+// `--drain_us=`. Sent as they are produced the frames overflow the buffer.
+// Paced at `--rate=` Mbit/s they trickle in and fit.
+//
+// `pacer` sleeps in user space until every datagram is due, `txtime` hands
+// the departure time to the qdisc with `send_at` and `kernel` sets
+// `SO_MAX_PACING_RATE`. The last two need the `fq` qdisc on the interface,
+// loopback has none, so they send unpaced there. The samples are how late
+// `Pacer::wait` returned past the departure time.
+
+enum class Mode { Burst, Pacer, TxTime, Kernel };
+
+const char *name(Mode m) {
+    switch (m) {
+    case Mode::Burst:
+        return "burst";
+    case Mode::Pacer:
+        return "pacer";
+    case Mode::TxTime:
+        return "txtime";
+    default:
+        return "kernel";
+    }
+}
+
+uint64_t thread_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct Config {
+    std::string address;
+    uint64_t    rate;
+    size_t      size;
+    size_t      burst;
+    uint64_t    frame_ns;
+    uint64_t    drain_ns;
+    size_t      frames;
+    size_t      rcvbuf;
+};
+
+void run(const Config &cfg, uint16_t port, Mode mode) {
+    auto rx = Sockets::UDPSocket::service(cfg.address, port, Sockets::Domain::IPv4,
+                                          Sockets::Operation::Non_blocking);
+    auto tx = Sockets::UDPSocket::connect(cfg.address, port, Sockets::Domain::IPv4);
+
+    if (mode == Mode::TxTime && !tx->txtime()) {
+        std::cerr << "SO_TXTIME is not supported, skipping the txtime run" << std::endl;
+        return;
+    }
+
+    if (mode == Mode::Kernel)
+        tx->pacing_rate(cfg.rate);
+
+    rx->receive_buffer(cfg.rcvbuf);
+    rx->count_drops(true);
+
+    std::atomic_bool done(false);
+    uint64_t         received = 0;
+    uint64_t         drops    = 0;
+
+    std::thread drain([&]() {
+        std::vector<char> buf(65536);
+        Sockets::Peer     peer;
+        bool              last = false;
+
+        while (!last) {
+            last = done;
+            std::this_thread::sleep_for(std::chrono::nanoseconds(cfg.drain_ns));
+
+            while (rx->recv_from(buf.data(), buf.size(), peer) > 0)
+                received++;
+        }
+
+        drops = rx->dropped();
+    });
+
+    Sockets::Pacer    pacer(cfg.rate, cfg.burst);
+    Bench::Samples    samples;
+    std::vector<char> datagram(cfg.size, 'x');
+    size_t            per_frame = cfg.rate * cfg.frame_ns / 1000000000ULL / cfg.size;
+    uint64_t          next      = Bench::now();
+    uint64_t          cpu       = thread_cpu_ns();
+    uint64_t          start     = next;
+
+    for (size_t f = 0; f < cfg.frames; f++) {
+        uint64_t now = Bench::now();
+
+        if (next > now)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+
+        for (size_t i = 0; i < per_frame; i++) {
+            switch (mode) {
+            case Mode::Pacer: {
+                uint64_t due = pacer.wait(datagram.size());
+
+                samples.add(Bench::now() - due);
+                tx->send(datagram.data(), datagram.size());
+                break;
+            }
+            case Mode::TxTime:
+                tx->send_at(datagram.data(), datagram.size(), pacer.reserve(datagram.size()));
+                break;
+            default:
+                tx->send(datagram.data(), datagram.size());
+            }
+        }
+
+        next += cfg.frame_ns;
+    }
+
+    uint64_t sent    = per_frame * cfg.frames;
+    uint64_t elapsed = Bench::now() - start;
+
+    cpu = thread_cpu_ns() - cpu;
+
+    done = true;
+    drain.join();
+
+    Sockets::PacerStatistics stats = pacer.statistics();
+
+    Bench::Record("pacing")
+        .field("mode", name(mode))
+        .field("rate_bps", cfg.rate * 8)
+        .field("size", cfg.size)
+        .field("sent", sent)
+        .field("received", received)
+        .field("dropped", drops)
+        .field("sent_bps", sent * cfg.size * 8000000000ULL / elapsed)
+        .field("sender_cpu_ns_per_datagram", cpu / sent)
+        .field("queue_delay_p50_ns", mode == Mode::Burst || mode == Mode::Kernel
+                                         ? 0
+                                         : stats.delay.percentile(50))
+        .field("queue_delay_p99_ns", mode == Mode::Burst || mode == Mode::Kernel
+                                         ? 0
+                                         : stats.delay.percentile(99))
+        .percentiles(samples)
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    Config   cfg;
+    uint16_t port     = opts.get("port", 23520);
+    size_t   duration = opts.get("duration", 1);
+
+    cfg.address  = opts.get("address", "127.0.0.1");
+    cfg.rate     = opts.get("rate", 100) * 125000ULL;
+    cfg.size     = opts.get("size", 1200);
+    cfg.burst    = opts.get("burst", 16 * 1024);
+    cfg.frame_ns = opts.get("frame_us", 10000) * 1000ULL;
+    cfg.drain_ns = opts.get("drain_us", 1000) * 1000ULL;
+    cfg.rcvbuf   = opts.get("rcvbuf", 64 * 1024);
+    cfg.frames   = duration * 1000000000ULL / cfg.frame_ns;
+
+    try {
+        run(cfg, port, Mode::Burst);
+        run(cfg, port + 1, Mode::Pacer);
+        run(cfg, port + 2, Mode::TxTime);
+        run(cfg, port + 3, Mode::Kernel);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
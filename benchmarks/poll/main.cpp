@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <socket/Polling/polling.hpp>
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// Wakeup cost of `Poll` as a function of the number of registered sockets.
+// A poller thread watches one active socket and a growing number of idle ones.
+// The client measures the round trip of a small datagram which has to pass
+// through `Poll::poll` on the way. Every count is measured once with the
+// poller sleeping in the kernel and once with it spinning first.
+
+const std::vector<size_t> counts = {1, 16, 64, 256, 1024, 4096, 16384};
+
+void run(const std::string &address, uint16_t port, size_t fds, size_t warmup, size_t iterations,
+         std::chrono::microseconds spin) {
+    std::promise<void>      ready;
+    Sockets::SpinStatistics spun;
+
+    std::thread server([&]() {
+        auto pd     = Sockets::Poll<Sockets::UDPSocket>();
+        auto active = Sockets::UDPSocket::service(address, port, Sockets::Domain::IPv4);
+
+        std::vector<std::shared_ptr<Sockets::UDPSocket>> idle;
+        char                                             buf[8];
+
+        // Idle sockets are connected to a port nobody sends from so they never
+        // become readable
+        for (size_t i = 1; i < fds; i++) {
+            idle.push_back(Sockets::UDPSocket::connect(address, port + 1, Sockets::Domain::IPv4));
+            pd.enroll(idle.back(), POLLIN);
+        }
+
+        // Register the active socket last so that `poll` has to walk past all
+        // the idle ones
+        pd.enroll(active, POLLIN);
+        pd.spin(spin);
+        ready.set_value();
+
+        for (size_t i = 0; i < warmup + iterations; i++) {
+            auto activity = pd.poll();
+
+            for (auto it : activity[1]) {
+                it->recv(buf, sizeof(buf));
+                it->send(buf, sizeof(buf));
+            }
+        }
+
+        spun = pd.spinning();
+    });
+
+    ready.get_future().wait();
+
+    auto           sock   = Sockets::UDPSocket::connect(address, port, Sockets::Domain::IPv4);
+    char           buf[8] = {0};
+    Bench::Samples samples;
+
+    samples.reserve(iterations);
+
+    for (size_t i = 0; i < warmup + iterations; i++) {
+        uint64_t start = Bench::now();
+
+        sock->send(buf, sizeof(buf));
+        sock->recv(buf, sizeof(buf));
+
+        if (i >= warmup)
+            samples.add(Bench::now() - start);
+    }
+
+    server.join();
+
+    Bench::Record("poll")
+        .field("fds", fds)
+        .field("spin_us", spin.count())
+        .field("spin_hit_rate", spun.hit_rate())
+        .field("spin_ns_per_poll", spun.polls ? spun.spin_ns / spun.polls : 0)
+        .percentiles(samples)
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address    = opts.get("address", "127.0.0.1");
+    uint16_t    port       = opts.get("port", 23420);
+    size_t      warmup     = opts.get("warmup", 500);
+    size_t      iterations = opts.get("iterations", 5000);
+    size_t      spin       = opts.get("spin_us", 50);
+
+    // Raise the descriptor limit as far as we are allowed to
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    try {
+        for (auto fds : counts) {
+            // Leave some headroom for the descriptors which are duplicated
+            // while constructing sockets
+            if (fds + 64 > lim.rlim_cur) {
+                std::cerr << "Skipping " << fds << " descriptors, limit is " << lim.rlim_cur
+                          << std::endl;
+                continue;
+            }
+
+            run(address, port, fds, warmup, iterations, std::chrono::microseconds(0));
+            run(address, port, fds, warmup, iterations, std::chrono::microseconds(spin));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
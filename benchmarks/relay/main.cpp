@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cerrno>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include <socket/Polling/polling.hpp>
+#include <socket/Relay/relay.hpp>
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// Cost of proxying a TCP stream. A client streams `--volume=` bytes through
+// a relay to an upstream which discards them. The copying relay reads into a
+// buffer and sends it back out, `Relay` splices the bytes through a pipe
+// without them ever reaching user space. The CPU time of the relay thread is
+// reported next to the throughput, which matters most on a busy proxy.
+
+uint64_t thread_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Relay one direction by copying, the way a proxy does without splice
+void copy(std::shared_ptr<Sockets::TCPSocket> from, std::shared_ptr<Sockets::TCPSocket> to,
+          size_t buffer) {
+    Sockets::Poll<Sockets::TCPSocket> poll;
+    std::vector<char>                 buf(buffer);
+    size_t                            head = 0;
+    size_t                            tail = 0;
+    bool                              eof  = false;
+
+    poll.enroll(from, POLLIN);
+    poll.enroll(to, 0);
+
+    while (!eof || head < tail) {
+        poll.poll();
+
+        if (head == tail && !eof) {
+            errno = 0;
+            head  = 0;
+            tail  = from->recv(buf.data(), buf.size());
+
+            if (tail == 0 && errno != EAGAIN)
+                eof = true;
+        }
+
+        if (head < tail)
+            head += to->send(buf.data() + head, tail - head);
+
+        poll.modify(from, head < tail || eof ? 0 : POLLIN);
+        poll.modify(to, head < tail ? POLLOUT : 0);
+    }
+
+    shutdown(to->fd(), SHUT_WR);
+}
+
+void run(const std::string &address, uint16_t port, bool spliced, size_t volume, size_t buffer) {
+    auto front = Sockets::TCPSocket::service(address, port, Sockets::Domain::IPv4);
+    auto back  = Sockets::TCPSocket::service(address, port + 1, Sockets::Domain::IPv4);
+
+    std::promise<uint64_t> cpu;
+
+    std::thread upstream([&]() {
+        auto              conn = back->accept();
+        std::vector<char> buf(256 * 1024);
+
+        while (conn->recv(buf.data(), buf.size()) > 0)
+            ;
+    });
+
+    std::thread relay([&]() {
+        auto client = front->accept(Sockets::Operation::Non_blocking);
+        auto up     = Sockets::TCPSocket::connect(address, port + 1, Sockets::Domain::IPv4,
+                                                  Sockets::Operation::Non_blocking);
+
+        uint64_t start = thread_cpu_ns();
+
+        if (spliced) {
+            Sockets::Relay r(client, up, buffer);
+            r.run();
+        } else {
+            copy(client, up, buffer);
+        }
+
+        cpu.set_value(thread_cpu_ns() - start);
+    });
+
+    auto              sock = Sockets::TCPSocket::connect(address, port, Sockets::Domain::IPv4);
+    std::vector<char> chunk(256 * 1024, 'x');
+    uint64_t          start = Bench::now();
+
+    for (size_t sent = 0; sent < volume; sent += chunk.size())
+        sock->send(chunk.data(), std::min(chunk.size(), volume - sent));
+
+    shutdown(sock->fd(), SHUT_WR);
+
+    relay.join();
+    upstream.join();
+
+    double   seconds = (Bench::now() - start) / 1e9;
+    uint64_t cpu_ns  = cpu.get_future().get();
+
+    Bench::Record("relay")
+        .field("mode", spliced ? "splice" : "copy")
+        .field("buffer", buffer)
+        .field("bytes", volume)
+        .field("seconds", seconds)
+        .field("bytes_per_second", static_cast<uint64_t>(volume / seconds))
+        .field("relay_cpu_ns_per_mb", cpu_ns / (volume >> 20 ? volume >> 20 : 1))
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address = opts.get("address", "127.0.0.1");
+    uint16_t    port    = opts.get("port", 23510);
+    size_t      volume  = opts.get("volume", 1ULL << 30);
+    size_t      buffer  = opts.get("buffer", 64 * 1024);
+
+    signal(SIGPIPE, SIG_IGN);
+
+    try {
+        // Every run listens on ports of its own, the previous one is left
+        // with connections in TIME_WAIT
+        run(address, port, false, volume, buffer);
+        run(address, port + 2, true, volume, buffer);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
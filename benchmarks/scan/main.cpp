@@ -0,0 +1,104 @@
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <socket/Framing/scan.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// Delimiter scanning speed of `find_byte` with every kernel the CPU supports
+// against `memchr` and a plain loop. A buffer of fixed length lines is split
+// into lines the way `LineReader` does it, so short lines measure the cost
+// per call and long ones the raw scan rate.
+
+const std::vector<size_t> lengths = {8, 32, 128, 1024, 8192};
+
+typedef std::function<const char *(const char *, size_t, char)> Finder;
+
+const char *naive(const char *buf, size_t len, char c) {
+    for (size_t i = 0; i < len; i++)
+        if (buf[i] == c)
+            return buf + i;
+
+    return nullptr;
+}
+
+void run(const std::string &method, const Finder &find, const std::vector<char> &buf,
+         size_t length, size_t iterations) {
+    Bench::Samples samples;
+    size_t         lines = 0;
+
+    samples.reserve(iterations);
+
+    for (size_t i = 0; i < iterations; i++) {
+        const char *at   = buf.data();
+        const char *end  = buf.data() + buf.size();
+        uint64_t    start = Bench::now();
+
+        lines = 0;
+
+        while (const char *nl = find(at, end - at, '\n')) {
+            at = nl + 1;
+            lines++;
+        }
+
+        samples.add(Bench::now() - start);
+    }
+
+    if (lines != buf.size() / length)
+        throw std::runtime_error("Scan of " + method + " found the wrong number of lines");
+
+    double seconds = samples.percentile(50) / 1e9;
+
+    Bench::Record("scan")
+        .field("method", method)
+        .field("line_bytes", length)
+        .field("buffer_bytes", buf.size())
+        .field("gb_per_second", buf.size() / seconds / 1e9)
+        .field("ns_per_line", samples.percentile(50) / static_cast<double>(lines))
+        .percentiles(samples)
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    size_t bytes      = opts.get("bytes", 16 * 1024 * 1024);
+    size_t iterations = opts.get("iterations", 20);
+
+    std::vector<std::pair<std::string, Sockets::ScanKernel>> kernels = {
+        {"scalar", Sockets::ScanKernel::Scalar},
+        {"sse2", Sockets::ScanKernel::SSE2},
+        {"avx2", Sockets::ScanKernel::AVX2},
+    };
+
+    try {
+        for (auto length : lengths) {
+            std::vector<char> buf(bytes / length * length, 'x');
+
+            for (size_t i = length - 1; i < buf.size(); i += length)
+                buf[i] = '\n';
+
+            run("naive", naive, buf, length, iterations);
+            run("memchr",
+                [](const char *b, size_t n, char c) {
+                    return static_cast<const char *>(memchr(b, c, n));
+                },
+                buf, length, iterations);
+
+            for (auto &kernel : kernels) {
+                // Kernels the CPU lacks are skipped rather than measured twice
+                if (Sockets::use_scan_kernel(kernel.second) != kernel.second)
+                    continue;
+
+                run("find_byte_" + kernel.first, Sockets::find_byte, buf, length, iterations);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,119 @@
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// Ping-pong round trip between two threads, over TCP on the loopback
+// interface and over a `ShmSocket`, first sleeping on the eventfds whenever
+// the ring is empty and then spinning for up to `--spin_us=` before that.
+// Spinning only pays off with both ends on cores of their own, on a single
+// CPU the spinning side holds up the other one and the run is skipped.
+
+const std::vector<size_t> sizes = {16, 256, 4096};
+
+template <class S>
+void echo(std::shared_ptr<S> conn, size_t rounds) {
+    std::vector<char> buf(sizes.back());
+
+    for (auto size : sizes) {
+        for (size_t i = 0; i < rounds; i++) {
+            conn->recv(buf.data(), size);
+            conn->send(buf.data(), size);
+        }
+    }
+}
+
+template <class S>
+void pingpong(const std::string &transport, std::shared_ptr<S> sock, size_t warmup,
+              size_t iterations) {
+    std::vector<char> buf(sizes.back(), 'x');
+
+    for (auto size : sizes) {
+        Bench::Samples samples;
+        samples.reserve(iterations);
+
+        for (size_t i = 0; i < warmup + iterations; i++) {
+            uint64_t start = Bench::now();
+
+            sock->send(buf.data(), size);
+            sock->recv(buf.data(), size);
+
+            if (i >= warmup)
+                samples.add(Bench::now() - start);
+        }
+
+        Bench::Record("shm")
+            .field("transport", transport)
+            .field("size", size)
+            .percentiles(samples)
+            .emit();
+    }
+}
+
+void tcp(const std::string &address, uint16_t port, size_t warmup, size_t iterations) {
+    auto listener = Sockets::TCPSocket::service(address, port, Sockets::Domain::IPv4);
+
+    std::thread server([&]() {
+        auto conn = listener->accept();
+        echo(conn, warmup + iterations);
+    });
+
+    auto sock = Sockets::TCPSocket::connect(address, port, Sockets::Domain::IPv4);
+
+    pingpong("tcp", sock, warmup, iterations);
+    server.join();
+}
+
+void shm(const std::string &path, size_t capacity, size_t spin_us, size_t warmup,
+         size_t iterations) {
+    auto listener = Sockets::ShmSocket::service(path, Sockets::Operation::Blocking, 1, capacity);
+
+    std::thread server([&]() {
+        auto conn = listener->accept();
+
+        conn->spin(std::chrono::microseconds(spin_us));
+        echo(conn, warmup + iterations);
+    });
+
+    auto sock = Sockets::ShmSocket::connect(path);
+
+    sock->spin(std::chrono::microseconds(spin_us));
+    pingpong(spin_us ? "shm_spin" : "shm", sock, warmup, iterations);
+    server.join();
+
+    unlink(path.c_str());
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address    = opts.get("address", "127.0.0.1");
+    uint16_t    port       = opts.get("port", 23530);
+    std::string path       = opts.get("path", "/tmp/bench_shm.sock");
+    size_t      capacity   = opts.get("capacity", 1024 * 1024);
+    size_t      spin_us    = opts.get("spin_us", 20);
+    size_t      warmup     = opts.get("warmup", 1000);
+    size_t      iterations = opts.get("iterations", 20000);
+
+    try {
+        tcp(address, port, warmup, iterations);
+        shm(path, capacity, 0, warmup, iterations);
+
+        if (std::thread::hardware_concurrency() > 1)
+            shm(path, capacity, spin_us, warmup, iterations);
+        else
+            std::cerr << "A single CPU, skipping the spinning run" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
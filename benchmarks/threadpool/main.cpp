@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <socket/ThreadPool/threadpool.hpp>
+
+#include "../utility/headers/bench.hpp"
+
+// Task throughput of `ThreadPool`. Empty tasks are scheduled as fast as
+// possible so that the pool overhead itself is what gets measured.
+
+void run(size_t workers, size_t tasks, bool pinned = false) {
+    std::atomic<size_t>            done(0);
+    std::vector<std::future<void>> results;
+    Sockets::ThreadPoolConfig      config;
+
+    config.workers  = workers;
+    config.per_core = pinned;
+    config.name     = "bench";
+
+    Sockets::ThreadPool pool(config);
+
+    results.reserve(tasks);
+
+    uint64_t start = Bench::now();
+
+    for (size_t i = 0; i < tasks; i++)
+        results.push_back(
+            pool.schedule([&done]() { done.fetch_add(1, std::memory_order_relaxed); }));
+
+    uint64_t scheduled = Bench::now();
+
+    for (auto &it : results)
+        it.wait();
+
+    uint64_t finished = Bench::now();
+    double   seconds  = (finished - start) / 1e9;
+
+    Sockets::ThreadPoolMetrics metrics = pool.metrics();
+
+    Bench::Record("threadpool")
+        .field("workers", workers)
+        .field("placement", pinned ? "per_core" : "scheduler")
+        .field("tasks", tasks)
+        .field("seconds", seconds)
+        .field("tasks_per_second", static_cast<uint64_t>(tasks / seconds))
+        .field("schedule_ns", (scheduled - start) / tasks)
+        .field("max_queue_depth", metrics.max_queue_depth)
+        .field("wait_p50_ns", metrics.wait.percentile(50))
+        .field("wait_p99_ns", metrics.wait.percentile(99))
+        .field("run_p50_ns", metrics.run.percentile(50))
+        .field("run_p99_ns", metrics.run.percentile(99))
+        .emit();
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    size_t tasks = opts.get("tasks", 200000);
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<size_t> workers = {1, 2, 4, cores};
+    std::sort(workers.begin(), workers.end());
+    workers.erase(std::unique(workers.begin(), workers.end()), workers.end());
+
+    try {
+        for (auto n : workers)
+            run(n, tasks);
+
+        // One worker per physical core, the placement a latency sensitive
+        // server would pick
+        for (auto n : workers)
+            run(n, tasks, true);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
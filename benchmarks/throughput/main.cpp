@@ -0,0 +1,196 @@
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <socket/Polling/polling.hpp>
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/bench.hpp"
+#include "../utility/headers/tls.hpp"
+
+// Loopback streaming throughput. For the stream transports the client pushes
+// a fixed volume of data and the clock stops when the server acknowledges the
+// last byte. For UDP the receiver counts what actually arrived.
+
+const std::vector<size_t> stream_sizes   = {64, 1024, 16384, 65536};
+const std::vector<size_t> datagram_sizes = {64, 1024, 8192};
+
+template <class S>
+void sink(std::shared_ptr<S> conn, size_t volume) {
+    std::vector<char> buf(stream_sizes.back());
+
+    for (auto size : stream_sizes) {
+        for (size_t n = 0; n < volume / size; n++)
+            conn->recv(buf.data(), size);
+
+        conn->send("a", 1);
+    }
+
+    // Let the client hang up first
+    try {
+        conn->recv(buf.data(), 1);
+    } catch (const std::exception &e) {
+    }
+}
+
+// Push out anything a coalescing socket still holds on to
+template <class S>
+void flush(std::shared_ptr<S> sock) { }
+
+void flush(std::shared_ptr<Sockets::TLSSocket> sock) { sock->flush(); }
+
+template <class S>
+void stream(const std::string &transport, std::shared_ptr<S> sock, size_t volume) {
+    std::vector<char> buf(stream_sizes.back(), 'x');
+
+    for (auto size : stream_sizes) {
+        size_t   messages = volume / size;
+        uint64_t start    = Bench::now();
+
+        for (size_t n = 0; n < messages; n++)
+            sock->send(buf.data(), size);
+
+        flush(sock);
+        sock->recv(buf.data(), 1);
+
+        double seconds = (Bench::now() - start) / 1e9;
+
+        Bench::Record("throughput")
+            .field("transport", transport)
+            .field("size", size)
+            .field("bytes", messages * size)
+            .field("seconds", seconds)
+            .field("bytes_per_second", static_cast<uint64_t>(messages * size / seconds))
+            .field("messages_per_second", static_cast<uint64_t>(messages / seconds))
+            .emit();
+    }
+}
+
+void tcp(const std::string &address, uint16_t port, size_t volume) {
+    std::promise<void> ready;
+
+    std::thread server([&]() {
+        auto listener = Sockets::TCPSocket::service(address, port, Sockets::Domain::IPv4);
+        ready.set_value();
+
+        sink(listener->accept(), volume);
+    });
+
+    ready.get_future().wait();
+
+    auto sock = Sockets::TCPSocket::connect(address, port, Sockets::Domain::IPv4);
+    stream("tcp", sock, volume);
+    sock->close();
+
+    server.join();
+}
+
+void tls(const std::string &address, uint16_t port, size_t volume, bool coalesce = false) {
+    Credentials        creds  = generate_credentials();
+    SSL_CTX *          server = setup_server_ctx(creds);
+    SSL_CTX *          client = setup_client_ctx(creds);
+    std::promise<void> ready;
+
+    std::thread t([&]() {
+        auto listener =
+            Sockets::TLSSocket::service(address, port, Sockets::Domain::IPv4, server);
+        ready.set_value();
+
+        sink(listener->accept(server), volume);
+    });
+
+    ready.get_future().wait();
+
+    auto sock = Sockets::TLSSocket::connect(address, port, Sockets::Domain::IPv4, client);
+
+    if (coalesce)
+        sock->coalesce(true);
+
+    stream(coalesce ? "tls_coalesced" : "tls", sock, volume);
+    sock->close();
+
+    t.join();
+
+    SSL_CTX_free(client);
+    SSL_CTX_free(server);
+    free_credentials(creds);
+}
+
+void udp(const std::string &address, uint16_t port, size_t volume) {
+    for (auto size : datagram_sizes) {
+        size_t             sent = volume / size;
+        std::promise<void> ready;
+
+        std::thread server([&]() {
+            auto listener = Sockets::UDPSocket::service(address, port, Sockets::Domain::IPv4);
+            auto pd       = Sockets::Poll<Sockets::UDPSocket>();
+
+            std::vector<char> buf(size);
+            size_t            received = 0;
+            uint64_t          first    = 0;
+            uint64_t          last     = 0;
+
+            pd.enroll(listener, POLLIN);
+            ready.set_value();
+
+            // The sender gives no end marker, so stop once the socket has been
+            // quiet for a while
+            while (!pd.poll(received ? 200 : 5000)[1].empty()) {
+                listener->recv(buf.data(), size);
+                last = Bench::now();
+
+                if (received++ == 0)
+                    first = last;
+            }
+
+            double seconds = (last - first) / 1e9;
+
+            Bench::Record("throughput")
+                .field("transport", "udp")
+                .field("size", size)
+                .field("bytes", received * size)
+                .field("seconds", seconds)
+                .field("bytes_per_second",
+                       static_cast<uint64_t>(seconds > 0 ? received * size / seconds : 0))
+                .field("messages_per_second",
+                       static_cast<uint64_t>(seconds > 0 ? received / seconds : 0))
+                .field("loss", 1.0 - static_cast<double>(received) / sent)
+                .emit();
+        });
+
+        ready.get_future().wait();
+
+        auto              sock = Sockets::UDPSocket::connect(address, port, Sockets::Domain::IPv4);
+        std::vector<char> buf(size, 'x');
+
+        for (size_t n = 0; n < sent; n++)
+            sock->send(buf.data(), size);
+
+        server.join();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Bench::Options opts(argc, argv);
+
+    std::string address = opts.get("address", "127.0.0.1");
+    uint16_t    port    = opts.get("port", 23410);
+    size_t      volume  = opts.get("bytes", 64 << 20);
+
+    setup_openssl();
+
+    try {
+        tcp(address, port, volume);
+        udp(address, port + 1, volume);
+        tls(address, port + 2, volume);
+        tls(address, port + 3, volume, true);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        ERR_print_errors_fp(stderr);
+        return EXIT_FAILURE;
+    }
+}
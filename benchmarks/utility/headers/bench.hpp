@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+    // Monotonic timestamp in nanoseconds
+    uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /**
+     * @brief Raw sample storage which is reduced to the percentiles we track
+     * once a run is finished. Samples are kept in full rather than bucketed
+     * so that the reported tail is exact.
+     *
+     */
+    class Samples {
+        std::vector<uint64_t> data;
+        bool                  sorted = false;
+
+        void sort() {
+            if (!this->sorted)
+                std::sort(this->data.begin(), this->data.end());
+            this->sorted = true;
+        }
+
+        public:
+        void reserve(size_t n) { this->data.reserve(n); }
+
+        void add(uint64_t sample) {
+            this->data.push_back(sample);
+            this->sorted = false;
+        }
+
+        size_t size() const { return this->data.size(); }
+
+        uint64_t percentile(double p) {
+            if (this->data.empty())
+                return 0;
+
+            this->sort();
+
+            size_t idx = static_cast<size_t>(p / 100.0 * (this->data.size() - 1) + 0.5);
+            return this->data[std::min(idx, this->data.size() - 1)];
+        }
+
+        uint64_t min() { return this->percentile(0); }
+        uint64_t max() { return this->percentile(100); }
+
+        double mean() const {
+            double sum = 0;
+
+            for (auto it : this->data)
+                sum += it;
+
+            return this->data.empty() ? 0 : sum / this->data.size();
+        }
+    };
+
+    /**
+     * @brief A single benchmark result. Every benchmark writes one JSON object
+     * per line to stdout so that the output of several runs can be appended to
+     * a file and compared over time.
+     *
+     */
+    class Record {
+        std::ostringstream out;
+
+        Record &key(const std::string &k) {
+            this->out << ",\"" << k << "\":";
+            return *this;
+        }
+
+        public:
+        Record(const std::string &benchmark) {
+            this->out << "{\"benchmark\":\"" << benchmark << "\"";
+        }
+
+        Record &field(const std::string &k, const std::string &value) {
+            this->key(k).out << "\"" << value << "\"";
+            return *this;
+        }
+
+        Record &field(const std::string &k, const char *value) {
+            return this->field(k, std::string(value));
+        }
+
+        template <class T>
+        Record &field(const std::string &k, T value) {
+            this->key(k).out << value;
+            return *this;
+        }
+
+        // Latency distribution in nanoseconds
+        Record &percentiles(Samples &s) {
+            return this->field("samples", s.size())
+                .field("min_ns", s.min())
+                .field("p50_ns", s.percentile(50))
+                .field("p99_ns", s.percentile(99))
+                .field("p999_ns", s.percentile(99.9))
+                .field("max_ns", s.max())
+                .field("mean_ns", static_cast<uint64_t>(s.mean()));
+        }
+
+        void emit() { std::cout << this->out.str() << "}" << std::endl; }
+    };
+
+    /**
+     * @brief Minimal `--key=value` argument parsing shared by the benchmarks.
+     *
+     */
+    class Options {
+        std::map<std::string, std::string> values;
+
+        public:
+        Options(int argc, char *argv[]) {
+            for (int i = 1; i < argc; i++) {
+                std::string arg(argv[i]);
+                size_t      eq = arg.find('=');
+
+                if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+                    std::cerr << "Ignoring malformed argument " << arg << std::endl;
+                    continue;
+                }
+
+                this->values[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+        }
+
+        size_t get(const std::string &key, size_t fallback) const {
+            auto it = this->values.find(key);
+            return it == this->values.end() ? fallback
+                                            : std::strtoull(it->second.c_str(), nullptr, 10);
+        }
+
+        std::string get(const std::string &key, const std::string &fallback) const {
+            auto it = this->values.find(key);
+            return it == this->values.end() ? fallback : it->second;
+        }
+    };
+} // namespace Bench
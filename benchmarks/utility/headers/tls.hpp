@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// The benchmarks generate a throwaway self-signed certificate at start-up so
+// that they do not depend on the example certificates having been generated.
+// It provides no security whatsoever.
+struct Credentials {
+    EVP_PKEY *key  = nullptr;
+    X509 *    cert = nullptr;
+};
+
+void setup_openssl() {
+    SSL_library_init();
+    SSL_load_error_strings();
+}
+
+void fail_openssl() {
+    ERR_print_errors_fp(stderr);
+    exit(EXIT_FAILURE);
+}
+
+Credentials generate_credentials() {
+    Credentials   out;
+    EVP_PKEY_CTX *pctx = nullptr;
+
+    if ((pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL)) == NULL)
+        fail_openssl();
+
+    if (EVP_PKEY_keygen_init(pctx) <= 0 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_keygen(pctx, &out.key) <= 0)
+        fail_openssl();
+
+    EVP_PKEY_CTX_free(pctx);
+
+    if ((out.cert = X509_new()) == NULL)
+        fail_openssl();
+
+    X509_set_version(out.cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(out.cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(out.cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(out.cert), 24 * 60 * 60);
+    X509_set_pubkey(out.cert, out.key);
+
+    X509_NAME *name = X509_get_subject_name(out.cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"libsock", -1, -1,
+                               0);
+    X509_set_issuer_name(out.cert, name);
+
+    if (X509_sign(out.cert, out.key, EVP_sha256()) == 0)
+        fail_openssl();
+
+    return out;
+}
+
+void free_credentials(Credentials &creds) {
+    X509_free(creds.cert);
+    EVP_PKEY_free(creds.key);
+}
+
+SSL_CTX *setup_server_ctx(Credentials &creds, const SSL_METHOD *method = TLS_server_method()) {
+    SSL_CTX *out = nullptr;
+
+    if ((out = SSL_CTX_new(method)) == NULL)
+        fail_openssl();
+
+    if (SSL_CTX_use_certificate(out, creds.cert) <= 0)
+        fail_openssl();
+
+    if (SSL_CTX_use_PrivateKey(out, creds.key) <= 0)
+        fail_openssl();
+
+    if (!SSL_CTX_check_private_key(out))
+        fail_openssl();
+
+    return out;
+}
+
+SSL_CTX *setup_client_ctx(Credentials &creds, const SSL_METHOD *method = TLS_client_method()) {
+    SSL_CTX *out = nullptr;
+
+    if ((out = SSL_CTX_new(method)) == NULL)
+        fail_openssl();
+
+    // Trust the generated certificate directly so `TLSSocket::connect` can
+    // verify the server
+    if (X509_STORE_add_cert(SSL_CTX_get_cert_store(out), creds.cert) == 0)
+        fail_openssl();
+
+    SSL_CTX_set_verify(out, SSL_VERIFY_PEER, NULL);
+
+    return out;
+}
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "../Socket/socket.hpp"
+#include "../Timer/timerwheel.hpp"
+
+namespace Sockets {
+
+    /**
+     * @brief Reference to a socket in a `SocketArena`. 20 bits of slot index
+     * and 12 bits of generation, so a handle to a socket which has since been
+     * erased is recognised even if its slot was reused. A default
+     * constructed handle never refers to anything.
+     *
+     */
+    class SocketHandle {
+        uint32_t value = 0;
+
+        public:
+        static const uint32_t index_bits      = 20;
+        static const uint32_t generation_bits = 12;
+        static const uint32_t max_index       = (1u << index_bits) - 1;
+        static const uint32_t max_generation  = (1u << generation_bits) - 1;
+
+        SocketHandle() = default;
+        SocketHandle(uint32_t index, uint32_t generation)
+            : value(generation << index_bits | (index & max_index)) { }
+
+        uint32_t index() const { return this->value & max_index; }
+        uint32_t generation() const { return this->value >> index_bits; }
+        uint32_t raw() const { return this->value; }
+
+        explicit operator bool() const { return this->value != 0; }
+
+        bool operator==(const SocketHandle &other) const { return this->value == other.value; }
+        bool operator!=(const SocketHandle &other) const { return this->value != other.value; }
+    };
+
+    /**
+     * @brief Contiguous store for sockets of type `S`. Sockets are
+     * constructed in place in cache line aligned slots, allocated a chunk at
+     * a time, so a million connections are a few large blocks instead of a
+     * million small ones. Sockets are addressed by `SocketHandle` and never
+     * move. Erasing a socket closes it and bumps the generation of its slot.
+     *
+     * Every slot still holds a complete `S`, so the per-socket footprint is
+     * that of the socket class. What the arena saves is the heap block,
+     * control block and reference count of every `shared_ptr`.
+     *
+     * The arena is not thread-safe, it belongs to the thread running the
+     * event loop.
+     *
+     */
+    template <class S>
+    class SocketArena {
+        static_assert(std::is_base_of<Socket, S>::value,
+                      "Templated class needs to inherit from Sockets::Socket");
+
+        static const size_t line       = 64;
+        static const size_t chunk_bits = 12;
+        static const size_t chunk_size = 1 << chunk_bits;
+
+        struct alignas(line) Slot {
+            typename std::aligned_storage<sizeof(S), alignof(S)>::type storage;
+
+            S *      get() { return reinterpret_cast<S *>(&this->storage); }
+        };
+
+        struct Free {
+            void operator()(Slot *p) const { std::free(p); }
+        };
+
+        std::vector<std::unique_ptr<Slot, Free>> chunks;
+
+        // Generation of every slot, 0 while the slot is empty
+        std::vector<uint16_t> generations;
+        // Generation the next socket in a slot gets
+        std::vector<uint16_t> next;
+        std::vector<uint32_t> free;
+
+        size_t capacity;
+        size_t count = 0;
+
+        Slot &slot(uint32_t idx) {
+            return this->chunks[idx >> chunk_bits].get()[idx & (chunk_size - 1)];
+        }
+
+        uint32_t reserve() {
+            if (!this->free.empty()) {
+                uint32_t idx = this->free.back();
+                this->free.pop_back();
+                return idx;
+            }
+
+            uint32_t idx = this->generations.size();
+
+            if (idx >= this->capacity)
+                throw std::runtime_error("Socket arena is full");
+
+            if ((idx & (chunk_size - 1)) == 0) {
+                void *mem = nullptr;
+
+                if (posix_memalign(&mem, line, chunk_size * sizeof(Slot)) != 0)
+                    throw std::bad_alloc();
+
+                this->chunks.emplace_back(static_cast<Slot *>(mem));
+            }
+
+            this->generations.push_back(0);
+            this->next.push_back(1);
+
+            return idx;
+        }
+
+        SocketHandle commit(uint32_t idx) {
+            uint16_t gen = this->next[idx];
+
+            this->generations[idx] = gen;
+            this->count++;
+
+            return SocketHandle(idx, gen);
+        }
+
+        void abandon(uint32_t idx) { this->free.push_back(idx); }
+
+        public:
+        // At most `capacity` sockets at a time, bounded by the handle format
+        explicit SocketArena(size_t capacity = SocketHandle::max_index)
+            : capacity(std::min<size_t>(capacity, SocketHandle::max_index)) { }
+
+        ~SocketArena() {
+            for (uint32_t idx = 0; idx < this->generations.size(); idx++)
+                if (this->generations[idx])
+                    this->slot(idx).get()->~S();
+        }
+
+        SocketArena(const SocketArena &) = delete;
+        SocketArena &operator=(const SocketArena &) = delete;
+
+        // Construct a socket in the arena from any public constructor of `S`
+        template <class... Args>
+        SocketHandle emplace(Args &&... args) {
+            uint32_t idx = this->reserve();
+
+            try {
+                new (&this->slot(idx).storage) S(std::forward<Args>(args)...);
+            } catch (...) {
+                this->abandon(idx);
+                throw;
+            }
+
+            return this->commit(idx);
+        }
+
+        // Counterparts of the `connect` and `service` factories of
+        // `TCPSocket` and `UDPSocket`
+        SocketHandle connect(std::string address, uint16_t port, Domain dom,
+                             Operation op = Operation::Blocking) {
+            auto addr = resolve(address, port, dom, this->type());
+
+            SocketHandle h;
+
+            try {
+                h = this->emplace(*addr, dom, op);
+            } catch (...) {
+                freeaddrinfo(addr);
+                throw;
+            }
+
+            freeaddrinfo(addr);
+
+            S *s = this->get(h);
+
+            // `UDPSocket::connect` leaves the state to its factory, like
+            // `service` below
+            try {
+                s->connect();
+                s->state = State::Connected;
+            } catch (...) {
+                this->erase(h);
+                throw;
+            }
+
+            return h;
+        }
+
+        SocketHandle service(std::string address, uint16_t port, Domain dom,
+                             Operation op = Operation::Blocking, int backlog = 100) {
+            auto addr = resolve(address, port, dom, this->type());
+
+            SocketHandle h;
+
+            try {
+                h = this->emplace(*addr, dom, op);
+            } catch (...) {
+                freeaddrinfo(addr);
+                throw;
+            }
+
+            freeaddrinfo(addr);
+
+            S *s = this->get(h);
+
+            try {
+                s->service(backlog);
+                s->state = State::Open;
+            } catch (...) {
+                this->erase(h);
+                throw;
+            }
+
+            return h;
+        }
+
+        // Drain up to `max` pending connections of `listener` into the arena,
+        // like `TCPSocket::accept_batch`
+        size_t accept(TCPSocket &listener, std::vector<SocketHandle> &out, size_t max,
+                      Operation op = Operation::Blocking, int flag = 0) {
+            static_assert(std::is_same<S, TCPSocket>::value,
+                          "Connections can only be accepted into an arena of TCPSocket");
+
+            size_t n = 0;
+
+            if (listener.state != State::Open)
+                throw std::runtime_error("Cannot accept connection on a socket that is not open");
+
+            flag |= SOCK_CLOEXEC;
+
+            if (op == Operation::Non_blocking)
+                flag |= SOCK_NONBLOCK;
+
+            while (n < max) {
+                int              fd;
+                sockaddr_storage info;
+
+                if ((fd = listener.accept_one(info, flag, n == 0)) == -1)
+                    break;
+
+                uint32_t idx = this->reserve();
+                S *      s   = this->slot(idx).get();
+
+                try {
+                    new (s) S(typename S::Adopt(), fd, info, listener.domain, op);
+                } catch (...) {
+                    ::close(fd);
+                    this->abandon(idx);
+                    throw;
+                }
+
+                s->state = State::Connected;
+                out.push_back(this->commit(idx));
+                n++;
+            }
+
+            return n;
+        }
+
+        // The socket behind `h`, or nullptr if it has been erased
+        S *get(SocketHandle h) {
+            uint32_t idx = h.index();
+
+            if (!h || idx >= this->generations.size() || this->generations[idx] != h.generation())
+                return nullptr;
+
+            return this->slot(idx).get();
+        }
+
+        bool contains(SocketHandle h) { return this->get(h) != nullptr; }
+
+        // Close and destroy the socket behind `h`. Stale handles are ignored.
+        void erase(SocketHandle h) {
+            S *s = this->get(h);
+
+            if (!s)
+                return;
+
+            uint32_t idx = h.index();
+
+            s->~S();
+
+            // Generation 0 marks an empty slot, skip it on wrap around
+            this->generations[idx] = 0;
+            this->next[idx]        = h.generation() == SocketHandle::max_generation
+                                         ? 1
+                                         : h.generation() + 1;
+            this->free.push_back(idx);
+            this->count--;
+        }
+
+        size_t size() const { return this->count; }
+
+        private:
+        static Type type() {
+            return std::is_base_of<TCPSocket, S>::value ? Type::Stream : Type::Datagram;
+        }
+    };
+
+    /**
+     * @brief `Poll` for sockets living in a `SocketArena`. Registrations hold
+     * a handle and the descriptor instead of a `shared_ptr`, so polling
+     * involves no reference counting. Handles whose socket was erased from
+     * the arena are dropped the next time they would be reported.
+     *
+     */
+    template <class S>
+    class ArenaPoll {
+        SocketArena<S> &                     arena;
+        std::vector<struct pollfd>           fds;
+        std::vector<SocketHandle>            handles;
+        std::unordered_map<uint32_t, size_t> index;
+
+        void remove(size_t idx) {
+            size_t last = this->fds.size() - 1;
+
+            this->index.erase(this->handles[idx].raw());
+
+            if (idx != last) {
+                this->fds[idx]                        = this->fds[last];
+                this->handles[idx]                    = this->handles[last];
+                this->index[this->handles[idx].raw()] = idx;
+            }
+
+            this->fds.pop_back();
+            this->handles.pop_back();
+        }
+
+        public:
+        explicit ArenaPoll(SocketArena<S> &arena) : arena(arena) { }
+
+        std::array<std::vector<SocketHandle>, 3> poll(int timeout = -1) {
+            int n = 0;
+
+            std::array<std::vector<SocketHandle>, 3> out;
+
+            if ((n = ::poll(this->fds.data(), this->fds.size(), timeout)) < 0) {
+                perror("ArenaPoll::poll(int)");
+                throw std::runtime_error("Error when polling sockets");
+            }
+
+            for (size_t i = 0; n > 0 && i < this->fds.size();) {
+                short revents = this->fds[i].revents;
+
+                if (!revents) {
+                    i++;
+                    continue;
+                }
+
+                n--;
+
+                // The descriptor may already belong to another socket
+                if (!this->arena.contains(this->handles[i])) {
+                    this->remove(i);
+                    continue;
+                }
+
+                if (revents & (POLLERR | POLLHUP | POLLNVAL))
+                    out[0].push_back(this->handles[i]);
+
+                if (revents & POLLIN)
+                    out[1].push_back(this->handles[i]);
+
+                if (revents & POLLOUT)
+                    out[2].push_back(this->handles[i]);
+
+                i++;
+            }
+
+            return out;
+        }
+
+        std::array<std::vector<SocketHandle>, 3> poll(TimerWheel &timers, int timeout = -1) {
+            auto out = this->poll(timers.timeout(timeout));
+
+            timers.advance();
+
+            return out;
+        }
+
+        void enroll(SocketHandle h, short event = POLLIN | POLLOUT) {
+            S *s = this->arena.get(h);
+
+            if (!s)
+                throw std::runtime_error("Cannot enroll a stale socket handle");
+
+            auto it = this->index.find(h.raw());
+
+            if (it != this->index.end()) {
+                this->fds[it->second].events = event;
+                return;
+            }
+
+            pollfd tmp = {s->fd(), event, 0};
+            this->index[h.raw()] = this->fds.size();
+            this->fds.push_back(tmp);
+            this->handles.push_back(h);
+        }
+
+        void modify(SocketHandle h, short event) {
+            auto it = this->index.find(h.raw());
+
+            if (it != this->index.end())
+                this->fds[it->second].events = event;
+        }
+
+        bool enrolled(SocketHandle h) const {
+            return this->index.find(h.raw()) != this->index.end();
+        }
+
+        size_t size() const { return this->fds.size(); }
+
+        void disenroll(SocketHandle h) {
+            auto it = this->index.find(h.raw());
+
+            if (it != this->index.end())
+                this->remove(it->second);
+        }
+    };
+} // namespace Sockets
+
+namespace std {
+    template <>
+    struct hash<Sockets::SocketHandle> {
+        size_t operator()(const Sockets::SocketHandle &h) const {
+            return hash<uint32_t>()(h.raw());
+        }
+    };
+} // namespace std
@@ -0,0 +1,678 @@
+#pragma once
+
+#if __cplusplus < 202002L
+#error "async.hpp requires C++20 coroutine support"
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../Exceptions/exceptions.hpp"
+#include "../Polling/polling.hpp"
+#include "../Socket/socket.hpp"
+#include "../Timer/timerwheel.hpp"
+
+namespace Sockets {
+
+    /**
+     * @brief Recycles coroutine frames. Frames are rounded up to a size class
+     * and put on a per-thread free list when they finish so that a steady
+     * stream of short lived tasks does not go through the global allocator.
+     * Frames larger than the biggest class are allocated normally.
+     *
+     */
+    class FramePool {
+        static constexpr size_t granularity = 64;
+        static constexpr size_t classes     = 32;
+        static constexpr size_t retained    = 256;
+
+        struct Node {
+            Node *next;
+        };
+
+        struct Lists {
+            Node * head[classes]  = {};
+            size_t count[classes] = {};
+
+            ~Lists() {
+                for (size_t i = 0; i < classes; i++) {
+                    while (this->head[i]) {
+                        Node *n       = this->head[i];
+                        this->head[i] = n->next;
+                        ::operator delete(n);
+                    }
+                }
+            }
+        };
+
+        static Lists &local() {
+            thread_local Lists lists;
+            return lists;
+        }
+
+        static size_t size_class(size_t size) { return (size + granularity - 1) / granularity; }
+
+        public:
+        static void *allocate(size_t size) {
+            size_t cls = size_class(size);
+
+            if (cls == 0 || cls > classes)
+                return ::operator new(size);
+
+            Lists &l = local();
+
+            if (Node *n = l.head[cls - 1]) {
+                l.head[cls - 1] = n->next;
+                l.count[cls - 1]--;
+                return n;
+            }
+
+            return ::operator new(cls * granularity);
+        }
+
+        static void deallocate(void *p, size_t size) {
+            size_t cls = size_class(size);
+            Lists &l   = local();
+
+            if (cls == 0 || cls > classes || l.count[cls - 1] >= retained) {
+                ::operator delete(p);
+                return;
+            }
+
+            Node *n         = static_cast<Node *>(p);
+            n->next         = l.head[cls - 1];
+            l.head[cls - 1] = n;
+            l.count[cls - 1]++;
+        }
+    };
+
+    // Every promise type in this file allocates its frame from `FramePool`
+    struct PooledPromise {
+        static void *operator new(size_t size) { return FramePool::allocate(size); }
+        static void  operator delete(void *p, size_t size) { FramePool::deallocate(p, size); }
+    };
+
+    template <class T = void>
+    class Task;
+
+    /**
+     * @brief State shared by the promise of every `Task`. Tasks start
+     * suspended and hand control straight back to whoever awaited them once
+     * they finish.
+     *
+     */
+    struct TaskPromiseBase : PooledPromise {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr      error;
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+
+            template <class P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+                std::coroutine_handle<> next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept { }
+        };
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter        final_suspend() noexcept { return {}; }
+        void                unhandled_exception() { this->error = std::current_exception(); }
+    };
+
+    template <class T>
+    struct TaskPromise : TaskPromiseBase {
+        std::optional<T> value;
+
+        Task<T> get_return_object();
+
+        template <class U>
+        void return_value(U &&v) {
+            this->value.emplace(std::forward<U>(v));
+        }
+
+        T result() {
+            if (this->error)
+                std::rethrow_exception(this->error);
+
+            return std::move(*this->value);
+        }
+    };
+
+    template <>
+    struct TaskPromise<void> : TaskPromiseBase {
+        Task<void> get_return_object();
+
+        void return_void() { }
+
+        void result() {
+            if (this->error)
+                std::rethrow_exception(this->error);
+        }
+    };
+
+    /**
+     * @brief A lazily started coroutine which produces a `T`. It runs when it
+     * is awaited or handed to `Reactor::spawn`.
+     *
+     */
+    template <class T>
+    class Task {
+        public:
+        using promise_type = TaskPromise<T>;
+
+        private:
+        std::coroutine_handle<promise_type> handle;
+
+        friend promise_type;
+
+        explicit Task(std::coroutine_handle<promise_type> h) : handle(h) { }
+
+        public:
+        Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) { }
+
+        Task &operator=(Task &&other) noexcept {
+            if (this != &other) {
+                if (this->handle)
+                    this->handle.destroy();
+                this->handle = std::exchange(other.handle, {});
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task() {
+            if (this->handle)
+                this->handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return !this->handle || this->handle.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            this->handle.promise().continuation = awaiting;
+            return this->handle;
+        }
+
+        T await_resume() { return this->handle.promise().result(); }
+    };
+
+    template <class T>
+    Task<T> TaskPromise<T>::get_return_object() {
+        return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object() {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    inline bool would_block() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+
+    /**
+     * @brief An operation waiting for a socket to become ready. `perform`
+     * makes a single attempt and returns true once the operation has finished,
+     * whether it succeeded or failed. An armed `deadline` abandons the
+     * operation with a `timeout_error`.
+     *
+     */
+    class IOOperation {
+        public:
+        std::coroutine_handle<> handle;
+        std::exception_ptr      error;
+        Timer                   deadline;
+
+        IOOperation() = default;
+
+        // Operations are only moved before they are parked, so the deadline
+        // is never armed at that point
+        IOOperation(IOOperation &&other) noexcept
+            : handle(other.handle), error(std::move(other.error)) { }
+
+        virtual ~IOOperation() = default;
+
+        virtual bool perform() = 0;
+    };
+
+    /**
+     * @brief Single threaded event loop which resumes coroutines once the
+     * socket they wait on is ready. Readiness comes from `Poll`, every socket
+     * with a pending operation is enrolled for exactly the events its waiters
+     * need and removed again once nothing waits on it.
+     *
+     * All sockets used with the reactor must be non-blocking.
+     *
+     */
+    class Reactor {
+        struct Waiters {
+            std::shared_ptr<Socket> sock;
+            IOOperation *           reader = nullptr;
+            IOOperation *           writer = nullptr;
+        };
+
+        struct Detached {
+            struct promise_type : PooledPromise {
+                Detached            get_return_object() noexcept { return {}; }
+                std::suspend_never  initial_suspend() noexcept { return {}; }
+                std::suspend_never  final_suspend() noexcept { return {}; }
+                void                return_void() noexcept { }
+                void                unhandled_exception() noexcept { std::terminate(); }
+            };
+        };
+
+        Poll<Socket>                        poller;
+        TimerWheel                          wheel;
+        std::unordered_map<int, Waiters>    waiting;
+        std::deque<std::coroutine_handle<>> ready;
+        size_t                              tasks = 0;
+        std::exception_ptr                  failure;
+
+        Detached launch(Task<void> task) {
+            try {
+                co_await task;
+            } catch (...) {
+                if (!this->failure)
+                    this->failure = std::current_exception();
+            }
+
+            this->tasks--;
+        }
+
+        // Bring the registration of `fd` in line with its waiters
+        void update(int fd) {
+            auto it = this->waiting.find(fd);
+
+            if (it == this->waiting.end())
+                return;
+
+            short event = (it->second.reader ? POLLIN : 0) | (it->second.writer ? POLLOUT : 0);
+
+            if (event) {
+                this->poller.enroll(it->second.sock, event);
+            } else {
+                this->poller.disenroll(fd);
+                this->waiting.erase(it);
+            }
+        }
+
+        void complete(int fd, bool readable, bool writable) {
+            auto it = this->waiting.find(fd);
+
+            if (it == this->waiting.end())
+                return;
+
+            Waiters &w = it->second;
+
+            if (readable && w.reader && w.reader->perform()) {
+                w.reader->deadline.cancel();
+                this->ready.push_back(w.reader->handle);
+                w.reader = nullptr;
+            }
+
+            if (writable && w.writer && w.writer->perform()) {
+                w.writer->deadline.cancel();
+                this->ready.push_back(w.writer->handle);
+                w.writer = nullptr;
+            }
+
+            this->update(fd);
+        }
+
+        // Give up on `op` because its deadline passed
+        void expire(int fd, IOOperation &op) {
+            auto it = this->waiting.find(fd);
+
+            if (it != this->waiting.end()) {
+                if (it->second.reader == &op)
+                    it->second.reader = nullptr;
+
+                if (it->second.writer == &op)
+                    it->second.writer = nullptr;
+
+                this->update(fd);
+            }
+
+            op.error = std::make_exception_ptr(timeout_error());
+            this->ready.push_back(op.handle);
+        }
+
+        void resume() {
+            while (!this->ready.empty()) {
+                std::coroutine_handle<> h = this->ready.front();
+                this->ready.pop_front();
+                h.resume();
+            }
+        }
+
+        public:
+        Reactor()                = default;
+        Reactor(const Reactor &) = delete;
+        Reactor &operator=(const Reactor &) = delete;
+
+        // Start a task. It runs until its first suspension before this returns.
+        void spawn(Task<void> task) {
+            this->tasks++;
+            this->launch(std::move(task));
+        }
+
+        // Park `op` until `sock` reports `event`, either POLLIN or POLLOUT
+        void wait(std::shared_ptr<Socket> sock, IOOperation &op, short event) {
+            int      fd = sock->fd();
+            Waiters &w  = this->waiting[fd];
+
+            w.sock = sock;
+
+            if (event & POLLIN) {
+                if (w.reader)
+                    throw std::logic_error("Socket already has a pending read");
+                w.reader = &op;
+            }
+
+            if (event & POLLOUT) {
+                if (w.writer)
+                    throw std::logic_error("Socket already has a pending write");
+                w.writer = &op;
+            }
+
+            this->update(fd);
+        }
+
+        // Like `wait`, but fail the operation with a `timeout_error` if the
+        // socket is not ready within `timeout`
+        void wait(std::shared_ptr<Socket> sock, IOOperation &op, short event,
+                  std::chrono::milliseconds timeout) {
+            int fd = sock->fd();
+
+            this->wait(std::move(sock), op, event);
+
+            op.deadline.callback = [this, fd, &op]() { this->expire(fd, op); };
+            this->wheel.schedule(op.deadline, timeout);
+        }
+
+        // Timers driven by the loop, for idle timeouts and the like. Their
+        // callbacks run on the loop thread.
+        TimerWheel &timers() { return this->wheel; }
+
+        // Queue a suspended coroutine to be resumed by the loop
+        void post(std::coroutine_handle<> h) { this->ready.push_back(h); }
+
+        // Number of spawned tasks which have not finished yet
+        size_t pending() const { return this->tasks; }
+
+        // Wait for readiness once and resume whatever became runnable. Returns
+        // false when there was nothing left to wait for.
+        bool run_once(int timeout = -1) {
+            this->resume();
+
+            if (this->waiting.empty() && !this->wheel.size())
+                return false;
+
+            auto activity = this->poller.poll(this->wheel.timeout(timeout));
+
+            for (auto &it : activity[0])
+                this->complete(it->fd(), true, true);
+
+            for (auto &it : activity[1])
+                this->complete(it->fd(), true, false);
+
+            for (auto &it : activity[2])
+                this->complete(it->fd(), false, true);
+
+            // Readiness wins over a deadline which passed during the same poll
+            this->wheel.advance();
+
+            this->resume();
+
+            if (this->failure)
+                std::rethrow_exception(std::exchange(this->failure, nullptr));
+
+            return true;
+        }
+
+        // Run until every spawned task has finished
+        void run() {
+            while (this->tasks && this->run_once()) { }
+
+            if (this->failure)
+                std::rethrow_exception(std::exchange(this->failure, nullptr));
+        }
+    };
+
+    /**
+     * @brief Awaiter which tries an operation straight away and only parks it
+     * on the reactor if the socket is not ready.
+     *
+     */
+    template <class Op>
+    class IOAwaitable {
+        Reactor &                                reactor;
+        std::shared_ptr<Socket>                  sock;
+        short                                    event;
+        Op                                       op;
+        std::optional<std::chrono::milliseconds> timeout;
+
+        public:
+        IOAwaitable(Reactor &reactor, std::shared_ptr<Socket> sock, short event, Op op)
+            : reactor(reactor), sock(std::move(sock)), event(event), op(std::move(op)) { }
+
+        // Fail with a `timeout_error` unless the operation finishes in time
+        IOAwaitable &&within(std::chrono::milliseconds timeout) && {
+            this->timeout = timeout;
+            return std::move(*this);
+        }
+
+        bool await_ready() { return this->op.perform(); }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            this->op.handle = h;
+
+            if (this->timeout)
+                this->reactor.wait(this->sock, this->op, this->event, *this->timeout);
+            else
+                this->reactor.wait(this->sock, this->op, this->event);
+        }
+
+        auto await_resume() {
+            if (this->op.error)
+                std::rethrow_exception(this->op.error);
+
+            return this->op.result();
+        }
+    };
+
+    template <class S>
+    class RecvOperation : public IOOperation {
+        std::shared_ptr<S> sock;
+        char *             buf;
+        size_t             buflen;
+        size_t             n = 0;
+
+        public:
+        RecvOperation(std::shared_ptr<S> sock, char *buf, size_t buflen)
+            : sock(std::move(sock)), buf(buf), buflen(buflen) { }
+
+        bool perform() override {
+            try {
+                errno   = 0;
+                this->n = this->sock->recv(this->buf, this->buflen);
+
+                return this->n > 0 || !would_block();
+            } catch (...) {
+                if (would_block())
+                    return false;
+
+                this->error = std::current_exception();
+                return true;
+            }
+        }
+
+        size_t result() { return this->n; }
+    };
+
+    template <class S>
+    class SendOperation : public IOOperation {
+        std::shared_ptr<S> sock;
+        const char *       buf;
+        size_t             buflen;
+        size_t             sent = 0;
+
+        public:
+        SendOperation(std::shared_ptr<S> sock, const char *buf, size_t buflen)
+            : sock(std::move(sock)), buf(buf), buflen(buflen) { }
+
+        bool perform() override {
+            try {
+                while (this->sent < this->buflen) {
+                    errno    = 0;
+                    size_t n = this->sock->send(this->buf + this->sent, this->buflen - this->sent);
+
+                    if (n == 0) {
+                        if (would_block())
+                            return false;
+
+                        throw std::runtime_error("Connection closed while sending");
+                    }
+
+                    this->sent += n;
+                }
+            } catch (...) {
+                if (would_block())
+                    return false;
+
+                this->error = std::current_exception();
+            }
+
+            return true;
+        }
+
+        size_t result() { return this->sent; }
+    };
+
+    class AcceptOperation : public IOOperation {
+        std::shared_ptr<TCPSocket>              listener;
+        std::vector<std::shared_ptr<TCPSocket>> conn;
+
+        public:
+        AcceptOperation(std::shared_ptr<TCPSocket> listener) : listener(std::move(listener)) { }
+
+        bool perform() override {
+            try {
+                return this->listener->accept_batch(this->conn, 1, Operation::Non_blocking) != 0;
+            } catch (...) {
+                this->error = std::current_exception();
+                return true;
+            }
+        }
+
+        std::shared_ptr<TCPSocket> result() { return std::move(this->conn.front()); }
+    };
+
+    class ConnectOperation : public IOOperation {
+        std::shared_ptr<TCPSocket> sock;
+        bool                       armed = false;
+
+        public:
+        ConnectOperation(std::shared_ptr<TCPSocket> sock) : sock(std::move(sock)) { }
+
+        bool perform() override {
+            int       err = 0;
+            socklen_t len = sizeof(err);
+
+            // The outcome of a non-blocking connect is only known once the
+            // socket turns writable
+            if (!this->armed) {
+                this->armed = true;
+                return false;
+            }
+
+            if (getsockopt(this->sock->fd(), SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+                err = errno;
+
+            if (err)
+                this->error = std::make_exception_ptr(std::runtime_error(
+                    std::string("Error when trying to connect to destination: ") +
+                    std::strerror(err)));
+
+            return true;
+        }
+
+        std::shared_ptr<TCPSocket> result() { return this->sock; }
+    };
+
+    /**
+     * @brief Awaiter which resumes the coroutine once a delay has passed.
+     *
+     */
+    class SleepAwaitable {
+        Reactor &                 reactor;
+        std::chrono::milliseconds delay;
+        Timer                     timer;
+
+        public:
+        SleepAwaitable(Reactor &reactor, std::chrono::milliseconds delay)
+            : reactor(reactor), delay(delay) { }
+
+        bool await_ready() const noexcept { return this->delay.count() <= 0; }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            this->timer.callback = [this, h]() { this->reactor.post(h); };
+            this->reactor.timers().schedule(this->timer, this->delay);
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    inline SleepAwaitable async_sleep(Reactor &reactor, std::chrono::milliseconds delay) {
+        return SleepAwaitable(reactor, delay);
+    }
+
+    // Receive whatever is available, at most `buflen` bytes. Returns 0 once
+    // the peer has closed the connection.
+    template <class S>
+    IOAwaitable<RecvOperation<S>> async_recv(Reactor &reactor, std::shared_ptr<S> sock, char *buf,
+                                             size_t buflen) {
+        return IOAwaitable<RecvOperation<S>>(reactor, sock, POLLIN,
+                                             RecvOperation<S>(sock, buf, buflen));
+    }
+
+    // Send all `buflen` bytes
+    template <class S>
+    IOAwaitable<SendOperation<S>> async_send(Reactor &reactor, std::shared_ptr<S> sock,
+                                             const char *buf, size_t buflen) {
+        return IOAwaitable<SendOperation<S>>(reactor, sock, POLLOUT,
+                                             SendOperation<S>(sock, buf, buflen));
+    }
+
+    // Accept the next connection on a non-blocking listener. The accepted
+    // socket is non-blocking as well.
+    inline IOAwaitable<AcceptOperation> async_accept(Reactor &                  reactor,
+                                                     std::shared_ptr<TCPSocket> listener) {
+        return IOAwaitable<AcceptOperation>(reactor, listener, POLLIN, AcceptOperation(listener));
+    }
+
+    inline Task<std::shared_ptr<TCPSocket>> async_connect(Reactor &reactor, std::string address,
+                                                          uint16_t port, Domain dom) {
+        auto sock = TCPSocket::connect(address, port, dom, Operation::Non_blocking);
+
+        co_return co_await IOAwaitable<ConnectOperation>(reactor, sock, POLLOUT,
+                                                         ConnectOperation(sock));
+    }
+} // namespace Sockets
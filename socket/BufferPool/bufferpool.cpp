@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <sys/mman.h>
+
+#include "bufferpool.hpp"
+
+namespace Sockets {
+
+    namespace {
+        // Pools are looked up by id rather than address so that a cache
+        // entry of a destroyed pool can never match a new one
+        std::mutex &registry_mutex() {
+            static std::mutex mtx;
+            return mtx;
+        }
+
+        std::unordered_map<uint64_t, BufferPool *> &registry() {
+            static std::unordered_map<uint64_t, BufferPool *> pools;
+            return pools;
+        }
+
+        uint64_t next_id() {
+            static std::atomic<uint64_t> id(0);
+            return ++id;
+        }
+
+        // Bumped whenever a pool goes away, so that the caches of other
+        // threads know to look for entries of pools which no longer exist
+        std::atomic<uint64_t> &destroyed() {
+            static std::atomic<uint64_t> count(0);
+            return count;
+        }
+    } // namespace
+
+    /**
+     * @brief Free buffers kept by one thread, per pool. Whatever is left
+     * when the thread exits goes back to the pools which still exist.
+     *
+     */
+    struct BufferCache {
+        struct Entry {
+            uint64_t            id;
+            std::vector<char *> bufs;
+        };
+
+        std::vector<Entry> entries;
+
+        // Value of `destroyed` when the entries were last checked
+        uint64_t seen = 0;
+
+        // Forget the buffers of destroyed pools. They point into slabs which
+        // are unmapped, but were never touched again as ids are not reused.
+        void prune() {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+
+            this->entries.erase(std::remove_if(this->entries.begin(), this->entries.end(),
+                                               [](const Entry &e) {
+                                                   return !registry().count(e.id);
+                                               }),
+                                this->entries.end());
+        }
+
+        std::vector<char *> &get(uint64_t id) {
+            uint64_t gone = destroyed().load(std::memory_order_relaxed);
+
+            if (gone != this->seen) {
+                this->seen = gone;
+                this->prune();
+            }
+
+            for (auto &it : this->entries)
+                if (it.id == id)
+                    return it.bufs;
+
+            this->entries.push_back(Entry{id, {}});
+            this->entries.back().bufs.reserve(BufferPool::cache_size);
+            return this->entries.back().bufs;
+        }
+
+        void drop(uint64_t id) {
+            for (auto it = this->entries.begin(); it != this->entries.end(); it++)
+                if (it->id == id) {
+                    this->entries.erase(it);
+                    return;
+                }
+        }
+
+        ~BufferCache() {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+
+            for (auto &it : this->entries) {
+                auto pool = registry().find(it.id);
+
+                if (pool != registry().end())
+                    pool->second->give(it.bufs.data(), it.bufs.size());
+            }
+        }
+    };
+
+    namespace {
+        thread_local BufferCache cache;
+    }
+
+    Lease::Lease(Lease &&other) noexcept : pool(other.pool), buf(other.buf), len(other.len) {
+        other.pool = nullptr;
+        other.buf  = nullptr;
+        other.len  = 0;
+    }
+
+    Lease &Lease::operator=(Lease &&other) noexcept {
+        if (this != &other) {
+            this->release();
+            std::swap(this->pool, other.pool);
+            std::swap(this->buf, other.buf);
+            std::swap(this->len, other.len);
+        }
+        return *this;
+    }
+
+    size_t Lease::capacity() const { return this->pool ? this->pool->buffer() : 0; }
+
+    void Lease::release() {
+        if (this->buf)
+            this->pool->put(this->buf);
+
+        this->pool = nullptr;
+        this->buf  = nullptr;
+        this->len  = 0;
+    }
+
+    BufferPool::BufferPool(size_t buffer_size, size_t slab_size, bool huge, size_t max_slabs)
+        : id(next_id()), buffer_size(std::max<size_t>(buffer_size, 64)),
+          slab_size(std::max(slab_size, buffer_size)), max_slabs(max_slabs), huge(huge),
+          hugetlb(false), leased(0) {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        registry()[this->id] = this;
+    }
+
+    BufferPool::~BufferPool() {
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            registry().erase(this->id);
+        }
+
+        // The cache of the destroying thread is cleaned up right away, other
+        // threads drop their entries the next time they use any pool
+        cache.drop(this->id);
+        destroyed().fetch_add(1, std::memory_order_relaxed);
+
+        for (auto it : this->slabs)
+            munmap(it, this->slab_size);
+    }
+
+    void BufferPool::grow() {
+        if (this->max_slabs && this->slabs.size() >= this->max_slabs)
+            throw std::runtime_error("Buffer pool is exhausted");
+
+        void *slab = MAP_FAILED;
+
+        if (this->huge)
+            slab = mmap(nullptr, this->slab_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        // Only true while every slab got huge pages
+        this->hugetlb = slab != MAP_FAILED && (this->slabs.empty() || this->hugetlb);
+
+        if (slab == MAP_FAILED) {
+            slab = mmap(nullptr, this->slab_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (slab == MAP_FAILED) {
+                perror("BufferPool::grow()");
+                throw std::runtime_error("Error when mapping buffer slab");
+            }
+
+            // Without reserved huge pages still ask for transparent ones
+            if (this->huge)
+                madvise(slab, this->slab_size, MADV_HUGEPAGE);
+        }
+
+        this->slabs.push_back(slab);
+
+        char *base = static_cast<char *>(slab);
+
+        // Hand out the start of the slab first so that untouched pages stay
+        // unbacked for as long as possible
+        for (size_t off = this->slab_size / this->buffer_size; off-- > 0;)
+            this->free.push_back(base + off * this->buffer_size);
+    }
+
+    void BufferPool::take(std::vector<char *> &out, size_t n) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        if (this->free.empty())
+            this->grow();
+
+        n = std::min(n, this->free.size());
+
+        out.insert(out.end(), this->free.end() - n, this->free.end());
+        this->free.resize(this->free.size() - n);
+    }
+
+    void BufferPool::give(char *const *bufs, size_t n) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        this->free.insert(this->free.end(), bufs, bufs + n);
+    }
+
+    Lease BufferPool::lease() {
+        std::vector<char *> &local = cache.get(this->id);
+
+        if (local.empty())
+            this->take(local, batch);
+
+        char *buf = local.back();
+        local.pop_back();
+
+        this->leased.fetch_add(1, std::memory_order_relaxed);
+
+        return Lease(this, buf);
+    }
+
+    void BufferPool::put(char *buf) {
+        std::vector<char *> &local = cache.get(this->id);
+
+        this->leased.fetch_sub(1, std::memory_order_relaxed);
+
+        // Keep the most recently used buffers, they are the ones likely to
+        // still be in the CPU caches
+        if (local.size() == cache_size) {
+            this->give(local.data(), batch);
+            local.erase(local.begin(), local.begin() + batch);
+        }
+
+        local.push_back(buf);
+    }
+
+    size_t BufferPool::reserved() {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        return this->slabs.size() * this->slab_size;
+    }
+} // namespace Sockets
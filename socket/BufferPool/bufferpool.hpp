@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Sockets {
+    class BufferPool;
+
+    /**
+     * @brief A buffer borrowed from a `BufferPool`. The buffer goes back to
+     * the pool when the lease is destroyed or released. Leases are move-only
+     * and must not outlive their pool.
+     *
+     */
+    class Lease {
+        BufferPool *pool = nullptr;
+        char *      buf  = nullptr;
+        size_t      len  = 0;
+
+        friend class BufferPool;
+
+        Lease(BufferPool *pool, char *buf) : pool(pool), buf(buf) { }
+
+        public:
+        Lease() = default;
+        Lease(Lease &&other) noexcept;
+        Lease &operator=(Lease &&other) noexcept;
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        ~Lease() { this->release(); }
+
+        char *      data() { return this->buf; }
+        const char *data() const { return this->buf; }
+
+        // Bytes of the buffer holding data, set by whoever filled it
+        size_t size() const { return this->len; }
+        void   resize(size_t len) { this->len = len; }
+
+        size_t capacity() const;
+
+        explicit operator bool() const { return this->buf != nullptr; }
+
+        void release();
+    };
+
+    /**
+     * @brief Pool of fixed size I/O buffers carved out of large slabs.
+     *
+     * Slabs are mapped with `MAP_HUGETLB` when `huge` is set and the system
+     * has huge pages reserved, otherwise they are mapped normally and marked
+     * for transparent huge pages. Every thread keeps a small cache of free
+     * buffers so that leasing and returning usually does not touch the shared
+     * free list or its lock. A thread's cached buffers of a destroyed pool
+     * are dropped the next time that thread uses a pool, or when it exits.
+     *
+     * Slabs are only unmapped when the pool is destroyed, resident memory
+     * follows the peak number of buffers in use.
+     *
+     */
+    class BufferPool {
+        static const size_t cache_size = 64;
+        static const size_t batch      = cache_size / 2;
+
+        const uint64_t id;
+        const size_t   buffer_size;
+        const size_t   slab_size;
+        const size_t   max_slabs;
+        const bool     huge;
+
+        std::mutex          mtx;
+        std::vector<void *> slabs;
+        std::vector<char *> free;
+
+        // Written under `mtx`, read without it by `huge_pages`
+        std::atomic<bool>   hugetlb;
+        std::atomic<size_t> leased;
+
+        // Map another slab and put its buffers on the free list, `mtx` must
+        // be held
+        void grow();
+
+        // Move up to `n` free buffers to `out`
+        void take(std::vector<char *> &out, size_t n);
+        // Put buffers back on the free list
+        void give(char *const *bufs, size_t n);
+
+        friend class Lease;
+        friend struct BufferCache;
+
+        void put(char *buf);
+
+        public:
+        // `max_slabs` of 0 lets the pool grow without limit
+        BufferPool(size_t buffer_size = 16 * 1024, size_t slab_size = 2 * 1024 * 1024,
+                   bool huge = false, size_t max_slabs = 0);
+        ~BufferPool();
+
+        BufferPool(const BufferPool &) = delete;
+        BufferPool &operator=(const BufferPool &) = delete;
+
+        Lease lease();
+
+        size_t buffer() const { return this->buffer_size; }
+
+        // Buffers currently leased out
+        size_t in_use() const { return this->leased.load(std::memory_order_relaxed); }
+
+        // Memory mapped for buffers
+        size_t reserved();
+
+        // Whether all the slabs really are on explicit huge pages
+        bool huge_pages() const { return this->hugetlb; }
+    };
+} // namespace Sockets
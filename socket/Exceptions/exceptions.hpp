@@ -72,7 +72,17 @@ namespace Sockets {
         const char *what() const throw() { return "Fatal SSL error"; }
     };
 
-    void throw_ssl_error(int err) {
+    class timeout_error : public std::runtime_error {
+        public:
+        timeout_error() : std::runtime_error("Operation timed out") { }
+    };
+
+    class frame_error : public std::runtime_error {
+        public:
+        explicit frame_error(const char *what) : std::runtime_error(what) { }
+    };
+
+    inline void throw_ssl_error(int err) {
         switch (err) {
         case SSL_ERROR_NONE:
             throw ssl_error_none();
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <endian.h>
+#include <sys/uio.h>
+
+#include "framing.hpp"
+#include "scan.hpp"
+
+namespace Sockets {
+
+    FrameCodec::FrameCodec(Prefix prefix, size_t max_frame) : prefix(prefix), max_frame(max_frame) {
+        if (prefix == Prefix::Fixed16 && max_frame > UINT16_MAX)
+            this->max_frame = UINT16_MAX;
+
+        if (prefix == Prefix::Fixed32 && max_frame > UINT32_MAX)
+            this->max_frame = UINT32_MAX;
+    }
+
+    size_t FrameCodec::encode(size_t len, char *out) const {
+        if (len > this->max_frame)
+            throw frame_error("Frame exceeds the maximum frame size");
+
+        switch (this->prefix) {
+        case Prefix::Fixed16: {
+            uint16_t be = htobe16(static_cast<uint16_t>(len));
+            memcpy(out, &be, sizeof(be));
+            return sizeof(be);
+        }
+        case Prefix::Fixed32: {
+            uint32_t be = htobe32(static_cast<uint32_t>(len));
+            memcpy(out, &be, sizeof(be));
+            return sizeof(be);
+        }
+        default: {
+            size_t n = 0;
+
+            do {
+                uint8_t byte = len & 0x7f;
+                len >>= 7;
+                out[n++] = static_cast<char>(len ? byte | 0x80 : byte);
+            } while (len);
+
+            return n;
+        }
+        }
+    }
+
+    size_t FrameCodec::decode(const char *buf, size_t avail, size_t &len) const {
+        size_t n = 0;
+
+        switch (this->prefix) {
+        case Prefix::Fixed16: {
+            uint16_t be;
+
+            if (avail < sizeof(be))
+                return 0;
+
+            memcpy(&be, buf, sizeof(be));
+            len = be16toh(be);
+            n   = sizeof(be);
+            break;
+        }
+        case Prefix::Fixed32: {
+            uint32_t be;
+
+            if (avail < sizeof(be))
+                return 0;
+
+            memcpy(&be, buf, sizeof(be));
+            len = be32toh(be);
+            n   = sizeof(be);
+            break;
+        }
+        default: {
+            uint64_t value = 0;
+
+            for (;;) {
+                if (n == avail)
+                    return 0;
+
+                if (n == max_header)
+                    throw frame_error("Malformed varint frame header");
+
+                uint8_t byte = buf[n];
+                value |= static_cast<uint64_t>(byte & 0x7f) << (7 * n);
+                n++;
+
+                if (!(byte & 0x80))
+                    break;
+            }
+
+            len = value;
+            break;
+        }
+        }
+
+        if (len > this->max_frame)
+            throw frame_error("Frame exceeds the maximum frame size");
+
+        return n;
+    }
+
+    size_t FrameCodec::missing(size_t avail) const {
+        switch (this->prefix) {
+        case Prefix::Fixed16:
+            return avail < 2 ? 2 - avail : 0;
+        case Prefix::Fixed32:
+            return avail < 4 ? 4 - avail : 0;
+        default:
+            // The length of a varint is only known once its last byte arrived
+            return 1;
+        }
+    }
+
+    FrameReader::FrameReader(std::shared_ptr<TCPSocket> sock, FrameCodec codec, size_t capacity)
+        : sock(std::move(sock)), codec(codec), buffer(capacity ? capacity : 1) { }
+
+    void FrameReader::reserve(size_t need) {
+        if (this->end + need <= this->buffer.size())
+            return;
+
+        // Move the unfinished frame to the front, that is the only data which
+        // is ever copied
+        if (this->begin) {
+            memmove(this->buffer.data(), this->buffer.data() + this->begin,
+                    this->end - this->begin);
+            this->end -= this->begin;
+            this->begin = 0;
+        }
+
+        if (this->end + need > this->buffer.size())
+            this->buffer.resize(std::max(this->end + need, 2 * this->buffer.size()));
+    }
+
+    bool FrameReader::next(Frame &frame) {
+        // Release the frame returned by the previous call
+        this->begin += this->consumed;
+        this->consumed = 0;
+
+        if (this->begin == this->end)
+            this->begin = this->end = 0;
+
+        for (;;) {
+            size_t avail = this->end - this->begin;
+            size_t len   = 0;
+            size_t hdr   = this->codec.decode(this->buffer.data() + this->begin, avail, len);
+            size_t need  = hdr ? hdr + len - std::min(avail, hdr + len)
+                               : this->codec.missing(avail);
+
+            if (hdr && !need) {
+                frame.data     = this->buffer.data() + this->begin + hdr;
+                frame.size     = len;
+                this->consumed = hdr + len;
+                return true;
+            }
+
+            if (this->eof)
+                return false;
+
+            this->reserve(need);
+
+            bool   blocking = this->sock->blocking();
+            size_t want     = blocking ? need : this->buffer.size() - this->end;
+
+            errno    = 0;
+            size_t n = this->sock->recv(this->buffer.data() + this->end, want);
+
+            if (n == 0) {
+                if (!blocking && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return false;
+
+                this->eof = true;
+                return false;
+            }
+
+            this->end += n;
+        }
+    }
+
+    LineReader::LineReader(std::shared_ptr<TCPSocket> sock, LineEnding ending, size_t max_line,
+                           size_t capacity)
+        : sock(std::move(sock)), ending(ending), max_line(max_line),
+          buffer(capacity ? capacity : 1) { }
+
+    void LineReader::reserve(size_t need) {
+        if (this->end + need <= this->buffer.size())
+            return;
+
+        // Only the unfinished line is ever moved
+        if (this->begin) {
+            memmove(this->buffer.data(), this->buffer.data() + this->begin,
+                    this->end - this->begin);
+            this->end -= this->begin;
+            this->begin = 0;
+        }
+
+        if (this->end + need > this->buffer.size())
+            this->buffer.resize(std::max(this->end + need, 2 * this->buffer.size()));
+    }
+
+    bool LineReader::next(Frame &line) {
+        // Release the line returned by the previous call
+        this->begin += this->consumed;
+        this->consumed = 0;
+
+        if (this->begin == this->end)
+            this->begin = this->end = 0;
+
+        for (;;) {
+            const char *start = this->buffer.data() + this->begin;
+            size_t      avail = this->end - this->begin;
+
+            while (this->scanned < avail) {
+                const char *nl = find_byte(start + this->scanned, avail - this->scanned, '\n');
+
+                if (!nl) {
+                    this->scanned = avail;
+                    break;
+                }
+
+                size_t len   = nl - start;
+                bool   cr    = len && start[len - 1] == '\r';
+                this->scanned = len + 1;
+
+                if (this->ending == LineEnding::CRLF && !cr)
+                    continue;
+
+                if (len - cr > this->max_line)
+                    throw frame_error("Line exceeds the maximum line length");
+
+                line.data      = start;
+                line.size      = len - cr;
+                this->consumed = len + 1;
+                this->scanned  = 0;
+                return true;
+            }
+
+            // The delimiter may still be on its way, but not beyond the limit
+            if (avail > this->max_line + 1)
+                throw frame_error("Line exceeds the maximum line length");
+
+            if (this->eof)
+                return false;
+
+            // Keep a quarter of the buffer free for every read, which only
+            // grows the buffer while a single line fills most of it
+            this->reserve(this->buffer.size() / 4 + 1);
+
+            Socket &sock = *this->sock;
+
+            errno    = 0;
+            size_t n = sock.recv_some(this->buffer.data() + this->end,
+                                      this->buffer.size() - this->end);
+
+            if (n == 0) {
+                if (!this->sock->blocking() && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return false;
+
+                this->eof = true;
+                return false;
+            }
+
+            this->end += n;
+        }
+    }
+
+    FrameWriter::FrameWriter(std::shared_ptr<TCPSocket> sock, FrameCodec codec)
+        : sock(std::move(sock)), codec(codec) { }
+
+    size_t FrameWriter::write(const char *buf, size_t buflen) {
+        char         header[FrameCodec::max_header];
+        struct iovec iov[2];
+
+        iov[0].iov_base = header;
+        iov[0].iov_len  = this->codec.encode(buflen, header);
+        iov[1].iov_base = const_cast<char *>(buf);
+        iov[1].iov_len  = buflen;
+
+        return this->sock->sendv(iov, buflen ? 2 : 1);
+    }
+} // namespace Sockets
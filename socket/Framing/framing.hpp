@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Exceptions/exceptions.hpp"
+#include "../Socket/socket.hpp"
+
+namespace Sockets {
+
+    // How the length of a frame is encoded in front of its payload
+    enum class Prefix {
+        Varint,  // LEB128, 1 to 10 bytes
+        Fixed16, // 16 bit big-endian
+        Fixed32, // 32 bit big-endian
+    };
+
+    /**
+     * @brief Encodes and decodes frame headers. Frames longer than
+     * `max_frame` are refused in both directions with a `frame_error`.
+     *
+     */
+    class FrameCodec {
+        Prefix prefix;
+        size_t max_frame;
+
+        public:
+        static const size_t max_header = 10;
+
+        FrameCodec(Prefix prefix = Prefix::Varint, size_t max_frame = 16 * 1024 * 1024);
+
+        // Write the header for a `len` byte payload to `out`, which must hold
+        // at least `max_header` bytes. Returns the size of the header.
+        size_t encode(size_t len, char *out) const;
+
+        // Parse a header from the first `avail` bytes of `buf`. Returns the
+        // size of the header and stores the payload length in `len`, or
+        // returns 0 if `buf` does not hold a complete header yet.
+        size_t decode(const char *buf, size_t avail, size_t &len) const;
+
+        // Fewest bytes still needed before a header of which `avail` bytes
+        // have been seen can be decoded
+        size_t missing(size_t avail) const;
+
+        size_t limit() const { return this->max_frame; }
+    };
+
+    /**
+     * @brief A frame handed out by a `FrameReader` or a `LineReader`. It
+     * points into the receive buffer of the reader and stays valid until the
+     * next call to `next`.
+     *
+     */
+    struct Frame {
+        const char *data = nullptr;
+        size_t      size = 0;
+
+        std::string str() const { return std::string(this->data, this->size); }
+    };
+
+    /**
+     * @brief Splits the byte stream of a socket into frames without copying
+     * the payloads out of its buffer.
+     *
+     * Blocking sockets are only ever asked for the bytes the current frame is
+     * still missing because their `recv` waits for the whole request.
+     * Non-blocking sockets are drained into the free space of the buffer so
+     * that many small frames come out of a single system call.
+     *
+     */
+    class FrameReader {
+        std::shared_ptr<TCPSocket> sock;
+        FrameCodec                 codec;
+        std::vector<char>          buffer;
+
+        size_t begin    = 0;
+        size_t end      = 0;
+        size_t consumed = 0;
+        bool   eof      = false;
+
+        // Make room for `need` more bytes behind `end`
+        void reserve(size_t need);
+
+        public:
+        FrameReader(std::shared_ptr<TCPSocket> sock, FrameCodec codec = FrameCodec(),
+                    size_t capacity = 64 * 1024);
+
+        // Fetch the next frame. Returns false if a non-blocking socket has no
+        // complete frame yet, or if the connection is closed.
+        bool next(Frame &frame);
+
+        // The peer closed the connection. Frames which were received
+        // completely before that have all been returned by `next`.
+        bool closed() const { return this->eof; }
+
+        // Bytes received which do not belong to a returned frame yet
+        size_t buffered() const { return this->end - this->begin - this->consumed; }
+    };
+
+    // What terminates a line for a `LineReader`
+    enum class LineEnding {
+        LF,   // "\n", a "\r" in front of it is dropped as well
+        CRLF, // "\r\n" only, a bare "\n" is part of the line
+    };
+
+    /**
+     * @brief Splits the byte stream of a socket into lines for text based
+     * protocols. Delimiters are searched with `find_byte`, which uses the
+     * widest SIMD instructions the CPU offers, and lines are handed out
+     * without their delimiter and without being copied. A line split across
+     * reads is only scanned once. Lines longer than `max_line` are refused
+     * with a `frame_error`.
+     *
+     * Every read takes whatever the socket has up to the free space in the
+     * buffer, so blocking sockets wait for data but not for a full buffer.
+     *
+     */
+    class LineReader {
+        std::shared_ptr<TCPSocket> sock;
+        LineEnding                 ending;
+        size_t                     max_line;
+        std::vector<char>          buffer;
+
+        size_t begin    = 0;
+        size_t end      = 0;
+        size_t consumed = 0;
+        size_t scanned  = 0;
+        bool   eof      = false;
+
+        // Make room for at least `need` more bytes behind `end`
+        void reserve(size_t need);
+
+        public:
+        LineReader(std::shared_ptr<TCPSocket> sock, LineEnding ending = LineEnding::LF,
+                   size_t max_line = 64 * 1024, size_t capacity = 64 * 1024);
+
+        // Fetch the next line. Returns false if a non-blocking socket has no
+        // complete line yet, or if the connection is closed.
+        bool next(Frame &line);
+
+        // The peer closed the connection. An unterminated last line is not
+        // returned, `buffered` tells its length.
+        bool closed() const { return this->eof; }
+
+        // Bytes received which do not belong to a returned line yet
+        size_t buffered() const { return this->end - this->begin - this->consumed; }
+    };
+
+    /**
+     * @brief Writes frames with the header and the payload in a single system
+     * call.
+     *
+     */
+    class FrameWriter {
+        std::shared_ptr<TCPSocket> sock;
+        FrameCodec                 codec;
+
+        public:
+        FrameWriter(std::shared_ptr<TCPSocket> sock, FrameCodec codec = FrameCodec());
+
+        // Returns the number of bytes written including the header. On a
+        // non-blocking socket this can fall short of the full frame, in which
+        // case the caller has to send the remainder itself.
+        size_t write(const char *buf, size_t buflen);
+        size_t write(const std::string &s) { return this->write(s.data(), s.size()); }
+    };
+} // namespace Sockets
@@ -0,0 +1,167 @@
+#include <atomic>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SOCKETS_SCAN_X86
+#endif
+
+#include "scan.hpp"
+
+namespace Sockets {
+    namespace {
+        typedef const char *(*Finder)(const char *, size_t, char);
+
+        const char *find_scalar(const char *buf, size_t len, char c) {
+            for (size_t i = 0; i < len; i++)
+                if (buf[i] == c)
+                    return buf + i;
+
+            return nullptr;
+        }
+
+#ifdef SOCKETS_SCAN_X86
+        // The kernels are compiled for their instruction set on their own, so
+        // the rest of the library keeps running on any x86 CPU. Inputs of at
+        // least one vector finish with a load which ends at the last byte and
+        // overlaps what was already scanned instead of a scalar tail.
+        __attribute__((target("sse2"))) const char *find_sse2(const char *buf, size_t len,
+                                                               char c) {
+            const __m128i needle = _mm_set1_epi8(c);
+            size_t        i      = 0;
+
+            if (len < 16)
+                return find_scalar(buf, len, c);
+
+            for (; i + 16 <= len; i += 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + i));
+                int     mask  = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+                if (mask)
+                    return buf + i + __builtin_ctz(mask);
+            }
+
+            if (i == len)
+                return nullptr;
+
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + len - 16));
+            int     mask  = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+            return mask ? buf + len - 16 + __builtin_ctz(mask) : nullptr;
+        }
+
+        __attribute__((target("avx2"))) const char *find_avx2(const char *buf, size_t len,
+                                                               char c) {
+            const __m256i needle = _mm256_set1_epi8(c);
+            size_t        i      = 0;
+
+            if (len < 32)
+                return find_sse2(buf, len, c);
+
+            // Short lines end in the first vector, so it is checked on its
+            // own before the unrolled loop
+            __m256i  first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf));
+            uint32_t found = _mm256_movemask_epi8(_mm256_cmpeq_epi8(first, needle));
+
+            if (found)
+                return buf + __builtin_ctz(found);
+
+            // Two vectors per iteration keep both load ports busy on long
+            // lines
+            for (i = 32; i + 64 <= len; i += 64) {
+                __m256i  a  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf + i));
+                __m256i  b  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf + i + 32));
+                uint32_t ma = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, needle));
+                uint32_t mb = _mm256_movemask_epi8(_mm256_cmpeq_epi8(b, needle));
+
+                if (ma | mb) {
+                    uint64_t mask = static_cast<uint64_t>(mb) << 32 | ma;
+                    return buf + i + __builtin_ctzll(mask);
+                }
+            }
+
+            for (; i + 32 <= len; i += 32) {
+                __m256i  chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf + i));
+                uint32_t mask  = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+
+                if (mask)
+                    return buf + i + __builtin_ctz(mask);
+            }
+
+            if (i == len)
+                return nullptr;
+
+            __m256i  chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf + len - 32));
+            uint32_t mask  = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+
+            return mask ? buf + len - 32 + __builtin_ctz(mask) : nullptr;
+        }
+#endif
+
+        bool supported(ScanKernel kernel) {
+            switch (kernel) {
+#ifdef SOCKETS_SCAN_X86
+            case ScanKernel::SSE2:
+                return __builtin_cpu_supports("sse2");
+            case ScanKernel::AVX2:
+                return __builtin_cpu_supports("avx2");
+#endif
+            case ScanKernel::Scalar:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        Finder finder(ScanKernel kernel) {
+            switch (kernel) {
+#ifdef SOCKETS_SCAN_X86
+            case ScanKernel::SSE2:
+                return find_sse2;
+            case ScanKernel::AVX2:
+                return find_avx2;
+#endif
+            default:
+                return find_scalar;
+            }
+        }
+
+        ScanKernel widest() {
+            if (supported(ScanKernel::AVX2))
+                return ScanKernel::AVX2;
+
+            if (supported(ScanKernel::SSE2))
+                return ScanKernel::SSE2;
+
+            return ScanKernel::Scalar;
+        }
+
+        // Detected on first use rather than during static initialisation, so
+        // other static initialisers can already scan
+        std::atomic<ScanKernel> &current() {
+            static std::atomic<ScanKernel> kernel(widest());
+            return kernel;
+        }
+
+        std::atomic<Finder> &active() {
+            static std::atomic<Finder> fn(finder(current().load()));
+            return fn;
+        }
+    } // namespace
+
+    const char *find_byte(const char *buf, size_t len, char c) {
+        return active().load(std::memory_order_relaxed)(buf, len, c);
+    }
+
+    ScanKernel scan_kernel() { return current().load(); }
+
+    ScanKernel use_scan_kernel(ScanKernel kernel) {
+        if (!supported(kernel))
+            kernel = widest();
+
+        current().store(kernel);
+        active().store(finder(kernel));
+
+        return kernel;
+    }
+} // namespace Sockets
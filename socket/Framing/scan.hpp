@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Sockets {
+
+    // Instruction sets the byte scan can be run with
+    enum class ScanKernel {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    // Position of the first `c` among the `len` bytes at `buf`, or nullptr.
+    // Runs the widest kernel the CPU supports, which is detected on first use.
+    const char *find_byte(const char *buf, size_t len, char c);
+
+    // The kernel `find_byte` currently runs
+    ScanKernel scan_kernel();
+
+    // Pin `find_byte` to `kernel`, mostly for comparing kernels. A kernel the
+    // CPU lacks is refused in favour of the widest one it supports. Returns
+    // the kernel in use afterwards.
+    ScanKernel use_scan_kernel(ScanKernel kernel);
+} // namespace Sockets
@@ -0,0 +1,125 @@
+#include <cstdio>
+#include <stdexcept>
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "handshake.hpp"
+
+namespace Sockets {
+
+    HandshakePool::HandshakePool(ThreadPool &pool, SSL_CTX *ctx, Operation op,
+                                 std::chrono::milliseconds timeout)
+        : pool(pool), ctx(ctx), operation(op), timeout(timeout.count()), completed(0),
+          failed(0) {
+        if ((this->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+            perror("HandshakePool::HandshakePool(ThreadPool &, SSL_CTX *, Operation, "
+                   "std::chrono::milliseconds)");
+            throw std::runtime_error("Error when creating eventfd");
+        }
+    }
+
+    HandshakePool::~HandshakePool() {
+        std::unique_lock<std::mutex> lock(this->mtx);
+
+        // Workers still reference the pool until their handshake is done
+        this->idle.wait(lock, [this]() { return this->in_flight == this->done.size(); });
+
+        ::close(this->efd);
+    }
+
+    void HandshakePool::handshake(std::shared_ptr<TCPSocket> conn) {
+        std::shared_ptr<TLSSocket> out;
+
+        // Bound how long a silent client can hold on to a worker. A timed out
+        // read surfaces as a failed handshake.
+        struct timeval tv = {this->timeout / 1000, (this->timeout % 1000) * 1000};
+        struct timeval no = {0, 0};
+
+        setsockopt(conn->fd(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(conn->fd(), SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        try {
+            out = TLSSocket::upgrade(*conn, this->ctx, this->operation);
+
+            setsockopt(out->fd(), SOL_SOCKET, SO_RCVTIMEO, &no, sizeof(no));
+            setsockopt(out->fd(), SOL_SOCKET, SO_SNDTIMEO, &no, sizeof(no));
+        } catch (const std::exception &e) {
+            out.reset();
+        }
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        if (out) {
+            this->done.push_back(std::move(out));
+            this->completed.fetch_add(1, std::memory_order_relaxed);
+
+            uint64_t one = 1;
+
+            if (write(this->efd, &one, sizeof(one)) < 0)
+                perror("HandshakePool::handshake(std::shared_ptr<TCPSocket>)");
+        } else {
+            this->in_flight--;
+            this->failed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        this->idle.notify_all();
+    }
+
+    void HandshakePool::submit(std::shared_ptr<TCPSocket> conn) {
+        {
+            std::lock_guard<std::mutex> lock(this->mtx);
+            this->in_flight++;
+        }
+
+        try {
+            this->pool.schedule(&HandshakePool::handshake, this, std::move(conn));
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(this->mtx);
+            this->in_flight--;
+            throw;
+        }
+    }
+
+    size_t HandshakePool::accept(TCPSocket &listener, size_t max) {
+        std::vector<std::shared_ptr<TCPSocket>> conns;
+
+        size_t n = listener.accept_batch(conns, max);
+
+        for (auto &conn : conns)
+            this->submit(std::move(conn));
+
+        return n;
+    }
+
+    size_t HandshakePool::collect(std::vector<std::shared_ptr<TLSSocket>> &out) {
+        uint64_t count;
+
+        // Reset the eventfd first, anything finishing afterwards signals again
+        if (read(this->efd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            perror("HandshakePool::collect(std::vector<std::shared_ptr<TLSSocket>> &)");
+            throw std::runtime_error("Error when reading eventfd");
+        }
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        size_t n = this->done.size();
+
+        for (auto &sock : this->done)
+            out.push_back(std::move(sock));
+
+        this->done.clear();
+        this->in_flight -= n;
+
+        return n;
+    }
+
+    size_t HandshakePool::pending() {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        return this->in_flight;
+    }
+} // namespace Sockets
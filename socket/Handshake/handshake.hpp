@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../Socket/socket.hpp"
+#include "../ThreadPool/threadpool.hpp"
+
+namespace Sockets {
+
+    /**
+     * @brief Runs the server side of TLS handshakes on the workers of a
+     * `ThreadPool` so that the key exchange does not stall the thread doing
+     * I/O. Accepted connections go in through `submit` or `accept`, finished
+     * `TLSSocket`s come back out of `collect` on the event loop, and `fd()`
+     * becomes readable whenever there is something to collect.
+     *
+     * Contexts with `SSL_MODE_ASYNC` set may pause handshakes in an
+     * asynchronous engine; the worker waits for the engine to finish the job.
+     *
+     */
+    class HandshakePool {
+        ThreadPool &pool;
+        SSL_CTX *   ctx;
+        Operation   operation;
+        int         timeout;
+
+        std::mutex                              mtx;
+        std::condition_variable                 idle;
+        std::vector<std::shared_ptr<TLSSocket>> done;
+        size_t                                  in_flight = 0;
+
+        std::atomic<uint64_t> completed;
+        std::atomic<uint64_t> failed;
+
+        // eventfd counting handshakes waiting to be collected
+        int efd;
+
+        void handshake(std::shared_ptr<TCPSocket> conn);
+
+        public:
+        // Handshaken sockets are handed out with operation `op`. A client has
+        // `timeout` to complete its handshake before it is dropped.
+        HandshakePool(ThreadPool &pool, SSL_CTX *ctx, Operation op = Operation::Non_blocking,
+                      std::chrono::milliseconds timeout = std::chrono::seconds(10));
+
+        // Waits for the handshakes which are still running
+        ~HandshakePool();
+
+        HandshakePool(const HandshakePool &) = delete;
+        HandshakePool &operator=(const HandshakePool &) = delete;
+
+        // Hand an accepted connection over to the workers
+        void submit(std::shared_ptr<TCPSocket> conn);
+
+        // Accept up to `max` pending connections of `listener` and submit
+        // them. Returns how many were accepted.
+        size_t accept(TCPSocket &listener, size_t max = 64);
+
+        // Move the sockets which finished their handshake to `out`. Returns
+        // how many were added.
+        size_t collect(std::vector<std::shared_ptr<TLSSocket>> &out);
+
+        // Readable while `collect` has sockets to hand out
+        int fd() const { return this->efd; }
+
+        // Handshakes submitted but not collected yet
+        size_t pending();
+
+        uint64_t succeeded() const { return this->completed.load(std::memory_order_relaxed); }
+        uint64_t failures() const { return this->failed.load(std::memory_order_relaxed); }
+    };
+} // namespace Sockets
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "pacer.hpp"
+
+namespace Sockets {
+
+    const uint64_t Pacer::spin_ns;
+
+    Pacer::Pacer(uint64_t bytes_per_second, size_t burst, Pacer *parent)
+        : bps(bytes_per_second), burst(burst), parent(parent), late(0) { }
+
+    void Pacer::rate(uint64_t bytes_per_second) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        this->bps = bytes_per_second;
+    }
+
+    uint64_t Pacer::rate() const {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        return this->bps;
+    }
+
+    uint64_t Pacer::book(size_t size, uint64_t now) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        if (!this->first)
+            this->first = now;
+
+        this->bytes += size;
+        this->sends++;
+
+        if (!this->bps) {
+            this->last = now;
+            return now;
+        }
+
+        // Virtual scheduling: a send may leave once what was booked before
+        // it is within `burst` of having drained
+        uint64_t tau = this->burst * 1000000000ULL / this->bps;
+        uint64_t due = this->tat > now + tau ? this->tat - tau : now;
+
+        this->tat  = std::max(this->tat, now) + size * 1000000000ULL / this->bps;
+        this->last = std::max(this->last, due);
+
+        return due;
+    }
+
+    uint64_t Pacer::reserve(size_t size) {
+        uint64_t now = now_ns();
+        uint64_t due = this->book(size, now);
+
+        if (this->parent)
+            due = std::max(due, this->parent->reserve(size));
+
+        if (due > now)
+            this->late++;
+
+        this->delays.record(due - now);
+
+        return due;
+    }
+
+    uint64_t Pacer::wait(size_t size) {
+        uint64_t due = this->reserve(size);
+        uint64_t now = now_ns();
+
+        if (due > now + spin_ns)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - spin_ns));
+
+        while (now_ns() < due)
+            ;
+
+        return due;
+    }
+
+    PacerStatistics Pacer::statistics() const {
+        PacerStatistics out;
+
+        {
+            std::lock_guard<std::mutex> lock(this->mtx);
+
+            out.bytes   = this->bytes;
+            out.sends   = this->sends;
+            out.delayed = this->late;
+
+            // Sends booked ahead count once they are due
+            uint64_t elapsed = this->first ? std::max(now_ns(), this->last) - this->first : 0;
+
+            if (elapsed)
+                out.achieved = (uint64_t)(this->bytes * 1e9 / elapsed);
+        }
+
+        out.delay = this->delays.snapshot();
+
+        return out;
+    }
+} // namespace Sockets
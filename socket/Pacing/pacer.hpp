@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "../Statistics/histogram.hpp"
+
+namespace Sockets {
+
+    /**
+     * @brief Point in time copy of what a `Pacer` let through. `delay` holds
+     * how long every send was held back, in nanoseconds.
+     *
+     */
+    struct PacerStatistics {
+        uint64_t bytes   = 0;
+        uint64_t sends   = 0;
+        uint64_t delayed = 0;
+
+        // Bytes per second since the first send
+        uint64_t achieved = 0;
+
+        HistogramSnapshot delay;
+    };
+
+    /**
+     * @brief Token bucket which spaces sends out to a target rate. Up to
+     * `burst` bytes go out back to back, beyond that every send is scheduled
+     * for when the bucket has refilled enough to take it.
+     *
+     * `reserve` only books the departure time, which suits `UDPSocket::send_at`
+     * where the qdisc holds the packet back. `wait` sleeps until the
+     * departure time instead, finishing with a short spin so that sends keep
+     * to the schedule at well below a millisecond.
+     *
+     * A pacer may be shared between sockets and threads to limit a group of
+     * them together. With a `parent` every send has to fit both, which gives
+     * per socket rates inside a group rate.
+     *
+     */
+    class Pacer {
+        // Sleeps shorter than this are spun instead, the scheduler wakes
+        // threads up too late for them
+        static const uint64_t spin_ns = 50000;
+
+        mutable std::mutex mtx;
+        uint64_t           bps;
+        size_t             burst;
+        Pacer *            parent;
+
+        // Time at which everything booked so far has drained at the target
+        // rate
+        uint64_t tat = 0;
+
+        // Instrumentation, `late` and `delays` are updated without `mtx`
+        uint64_t              first = 0;
+        uint64_t              last  = 0;
+        uint64_t              bytes = 0;
+        uint64_t              sends = 0;
+        std::atomic<uint64_t> late;
+        Histogram             delays;
+
+        uint64_t book(size_t size, uint64_t now);
+
+        public:
+        // `bytes_per_second` of 0 lets everything through
+        Pacer(uint64_t bytes_per_second, size_t burst = 16 * 1024, Pacer *parent = nullptr);
+
+        Pacer(const Pacer &) = delete;
+        Pacer &operator=(const Pacer &) = delete;
+
+        void     rate(uint64_t bytes_per_second);
+        uint64_t rate() const;
+
+        // Book `size` bytes and return when they may go out, a `now_ns`
+        // timestamp
+        uint64_t reserve(size_t size);
+
+        // Book `size` bytes and sleep until they may go out. Returns the
+        // departure time it waited for.
+        uint64_t wait(size_t size);
+
+        // Pace a send on any socket
+        template <class S>
+        size_t send(S &sock, const char *buf, size_t buflen) {
+            this->wait(buflen);
+            return sock.send(buf, buflen);
+        }
+
+        PacerStatistics statistics() const;
+    };
+} // namespace Sockets
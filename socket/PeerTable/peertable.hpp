@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../Socket/socket.hpp"
+
+namespace Sockets {
+
+    /**
+     * @brief Maps the peers of an unconnected `UDPSocket` to per-peer session
+     * state. Open addressing with linear probing over a flat array, and
+     * inserting only allocates when the table grows. Every slot holds a full
+     * `Peer`, so it spans a few cache lines, but probing compares the cached
+     * hash at the start of the slot and only reads the address on a match.
+     * Erasing shifts the following entries back instead of leaving
+     * tombstones.
+     *
+     * Pointers returned by `find` and `emplace` stay valid until the next
+     * insertion or erasure.
+     *
+     */
+    template <class T>
+    class PeerTable {
+        // The fields probing looks at come first
+        struct Slot {
+            uint32_t hash = 0;
+            bool     used = false;
+            Peer     peer;
+            T        value;
+        };
+
+        std::vector<Slot> slots;
+        size_t            count = 0;
+
+        size_t mask() const { return this->slots.size() - 1; }
+
+        // Position of `peer`, or of the empty slot it would go into
+        size_t probe(const Peer &peer, uint32_t hash) const {
+            size_t idx = hash & this->mask();
+
+            while (this->slots[idx].used &&
+                   (this->slots[idx].hash != hash || this->slots[idx].peer != peer))
+                idx = (idx + 1) & this->mask();
+
+            return idx;
+        }
+
+        void grow() {
+            std::vector<Slot> old(this->slots.empty() ? 16 : this->slots.size() * 2);
+
+            std::swap(old, this->slots);
+
+            for (auto &slot : old) {
+                if (!slot.used)
+                    continue;
+
+                size_t idx = this->probe(slot.peer, slot.hash);
+
+                this->slots[idx] = std::move(slot);
+            }
+        }
+
+        public:
+        explicit PeerTable(size_t expected = 0) {
+            // Keep the load factor at or below 3/4
+            size_t n = 16;
+
+            while (n * 3 < expected * 4)
+                n *= 2;
+
+            this->slots.resize(n);
+        }
+
+        // The session of `peer`, nullptr if there is none
+        T *find(const Peer &peer) {
+            size_t idx = this->probe(peer, peer.hash());
+
+            return this->slots[idx].used ? &this->slots[idx].value : nullptr;
+        }
+
+        // The session of `peer`, created from `args` if there is none yet.
+        // The flag tells whether it was created.
+        template <class... Args>
+        std::pair<T *, bool> emplace(const Peer &peer, Args &&... args) {
+            uint32_t hash = peer.hash();
+            size_t   idx  = this->probe(peer, hash);
+
+            if (this->slots[idx].used)
+                return std::make_pair(&this->slots[idx].value, false);
+
+            if ((this->count + 1) * 4 > this->slots.size() * 3) {
+                this->grow();
+                idx = this->probe(peer, hash);
+            }
+
+            Slot &slot = this->slots[idx];
+
+            slot.peer  = peer;
+            slot.value = T(std::forward<Args>(args)...);
+            slot.hash  = hash;
+            slot.used  = true;
+            this->count++;
+
+            return std::make_pair(&slot.value, true);
+        }
+
+        bool erase(const Peer &peer) {
+            size_t idx = this->probe(peer, peer.hash());
+
+            if (!this->slots[idx].used)
+                return false;
+
+            // Move later members of the probe sequence into the hole unless
+            // that would put them in front of their home slot
+            size_t hole = idx;
+            size_t next = (hole + 1) & this->mask();
+
+            while (this->slots[next].used) {
+                size_t home = this->slots[next].hash & this->mask();
+
+                if (((next - home) & this->mask()) >= ((next - hole) & this->mask())) {
+                    this->slots[hole] = std::move(this->slots[next]);
+                    hole              = next;
+                }
+
+                next = (next + 1) & this->mask();
+            }
+
+            this->slots[hole].used  = false;
+            this->slots[hole].value = T();
+            this->count--;
+
+            return true;
+        }
+
+        // Call `fn(const Peer &, T &)` for every session, for instance to
+        // expire idle ones. The table must not be modified meanwhile.
+        template <class F>
+        void for_each(F fn) {
+            for (auto &slot : this->slots)
+                if (slot.used)
+                    fn(slot.peer, slot.value);
+        }
+
+        size_t size() const { return this->count; }
+        bool   empty() const { return this->count == 0; }
+    };
+} // namespace Sockets
@@ -1,20 +1,109 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <functional>
 #include <memory>
+#include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 #include <poll.h>
 
+#include "../Timer/timerwheel.hpp"
+
 namespace Sockets {
     class Socket;
 
+    /**
+     * @brief What spinning cost and bought a `Poll`. Every call which may wait
+     * either finds activity while spinning or falls back to sleeping in the
+     * kernel, times are in nanoseconds.
+     *
+     */
+    struct SpinStatistics {
+        uint64_t polls   = 0;
+        uint64_t hits    = 0;
+        uint64_t misses  = 0;
+        uint64_t spin_ns = 0;
+        uint64_t wait_ns = 0;
+
+        // Fraction of the waits which were cut short by spinning
+        double hit_rate() const { return polls ? (double)hits / polls : 0; }
+    };
+
     // S has to be a derivative of Sockets::Socket for the program to compile
     template <class S>
     class Poll {
         std::vector<struct pollfd>      fds;
         std::vector<std::shared_ptr<S>> devs;
 
+        // Position of every registered descriptor in `fds` and `devs`
+        std::unordered_map<int, size_t> index;
+
+        // Spinning is off while the budget is 0
+        uint64_t       budget = 0;
+        bool           kernel = false;
+        SpinStatistics spun;
+
+        // Best effort, a descriptor the kernel will not busy poll is still
+        // spun on by `poll`
+        void tune(const std::shared_ptr<S> &s, std::chrono::microseconds budget) {
+            try {
+                s->busy_poll(budget);
+            } catch (const std::runtime_error &) {
+            }
+        }
+
+        int wait(int timeout) {
+            int n = 0;
+
+            if ((n = ::poll(this->fds.data(), this->fds.size(), timeout)) < 0) {
+                perror("Poll::poll(int)");
+                throw std::runtime_error("Error when polling sockets");
+            }
+
+            return n;
+        }
+
+        // Check for activity without sleeping until it shows up, the budget
+        // runs out or `timeout` passes, then sleep for what is left of it
+        int busy_wait(int timeout) {
+            uint64_t start = now_ns();
+            uint64_t limit = this->budget;
+            uint64_t now   = start;
+            int      n     = 0;
+
+            if (timeout > 0)
+                limit = std::min<uint64_t>(limit, timeout * 1000000ULL);
+
+            this->spun.polls++;
+
+            do {
+                if ((n = this->wait(0)) > 0) {
+                    this->spun.hits++;
+                    this->spun.spin_ns += now_ns() - start;
+                    return n;
+                }
+
+                now = now_ns();
+            } while (now - start < limit);
+
+            this->spun.misses++;
+            this->spun.spin_ns += now - start;
+
+            if (timeout > 0)
+                timeout = std::max<int64_t>(0, timeout - (int64_t)(now - start) / 1000000);
+
+            n = this->wait(timeout);
+            this->spun.wait_ns += now_ns() - now;
+
+            return n;
+        }
+
         public:
         Poll() {
             static_assert(std::is_base_of<Socket, S>::value,
@@ -24,32 +113,28 @@ namespace Sockets {
         ~Poll() { }
 
         std::array<std::vector<std::shared_ptr<S>>, 3> poll(int timeout = -1) {
-            int n = 0;
+            int n = this->budget && timeout != 0 ? this->busy_wait(timeout) : this->wait(timeout);
             int i = 0;
 
             std::array<std::vector<std::shared_ptr<S>>, 3> out;
 
-            if ((n = ::poll(this->fds.data(), this->fds.size(), timeout)) < 0) {
-                perror("Poll::poll(int)");
-                throw std::runtime_error("Error when polling sockets");
-            }
-
             auto it_fd  = this->fds.begin();
             auto it_dev = this->devs.begin();
 
             while (i < n && it_fd != this->fds.end() && it_dev != this->devs.end()) {
-                if ((*it_fd).revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                    out[0].emplace_back(*it_dev);
-                    i++;
-                }
+                // `n` counts descriptors, not the lists they end up on
+                if ((*it_fd).revents) {
+                    short revents = (*it_dev)->readiness((*it_fd).revents);
 
-                if ((*it_fd).revents & POLLIN) {
-                    out[1].emplace_back(*it_dev);
-                    i++;
-                }
+                    if (revents & (POLLERR | POLLHUP | POLLNVAL))
+                        out[0].emplace_back(*it_dev);
+
+                    if (revents & POLLIN)
+                        out[1].emplace_back(*it_dev);
+
+                    if (revents & POLLOUT)
+                        out[2].emplace_back(*it_dev);
 
-                if ((*it_fd).revents & POLLOUT) {
-                    out[2].emplace_back(*it_dev);
                     i++;
                 }
 
@@ -60,45 +145,103 @@ namespace Sockets {
             return out;
         }
 
+        // Poll for no longer than the next timer on `timers` allows and fire
+        // the timers which expired in the meantime
+        std::array<std::vector<std::shared_ptr<S>>, 3> poll(TimerWheel &timers, int timeout = -1) {
+            auto out = this->poll(timers.timeout(timeout));
+
+            timers.advance();
+
+            return out;
+        }
+
         void enroll(std::shared_ptr<S> s, short event = POLLIN | POLLOUT) {
+            auto it = this->index.find(s->fd());
 
-            pollfd tmp = {s->fd(), event, 0};
+            // Enrolling a descriptor twice only updates what it is polled for
+            if (it != this->index.end()) {
+                this->fds[it->second].events = s->interest(event);
+                this->devs[it->second]       = s;
+                return;
+            }
+
+            if (this->kernel)
+                this->tune(s, std::chrono::microseconds(this->budget / 1000));
+
+            pollfd tmp = {s->fd(), s->interest(event), 0};
+            this->index[s->fd()] = this->fds.size();
             this->fds.push_back(tmp);
             this->devs.push_back(s);
         }
 
+        // Change the events a registered socket is polled for
+        void modify(std::shared_ptr<S> s, short event) {
+            auto it = this->index.find(s->fd());
+
+            if (it != this->index.end())
+                this->fds[it->second].events = this->devs[it->second]->interest(event);
+        }
+
+        bool enrolled(std::shared_ptr<S> s) const {
+            return this->index.find(s->fd()) != this->index.end();
+        }
+
+        size_t size() const { return this->fds.size(); }
+
+        // Trade a core for latency. Waiting calls to `poll` first spin on
+        // non-blocking checks for up to `budget` and only then sleep in the
+        // kernel, which saves the wakeup whenever activity arrives within the
+        // budget. With `kernel` the enrolled sockets also get `SO_BUSY_POLL`
+        // where the kernel allows it, which only makes `poll` busy poll the
+        // device queues when `net.core.busy_poll` is set. A budget of 0
+        // turns spinning off.
+        void spin(std::chrono::microseconds budget, bool kernel = true) {
+            this->budget = std::max<int64_t>(0, budget.count()) * 1000;
+            this->kernel = kernel && this->budget;
+
+            // Sockets the kernel refuses to busy poll are still spun on here
+            if (kernel)
+                for (auto &it : this->devs)
+                    this->tune(it, budget);
+        }
+
+        const SpinStatistics &spinning() const { return this->spun; }
+
         void disenroll(std::shared_ptr<S> s) {
-            auto it_fd  = this->fds.begin();
-            auto it_dev = this->devs.begin();
+            auto it = this->index.find(s->fd());
 
-            // Locate the index which fits the description
-            while (it_fd != this->fds.end() && it_dev != this->devs.end()) {
-                if ((*it_dev) == s) {
-                    this->fds.erase(it_fd);
-                    this->devs.erase(it_dev);
-                    break;
-                }
+            if (it != this->index.end() && this->devs[it->second] == s)
+                return this->disenroll(s->fd());
 
-                it_fd++;
-                it_dev++;
-            }
+            // A closed socket no longer knows its descriptor, look for the
+            // socket itself instead
+            auto dev = std::find(this->devs.begin(), this->devs.end(), s);
+
+            if (dev != this->devs.end())
+                this->disenroll(this->fds[dev - this->devs.begin()].fd);
         }
 
         void disenroll(int fd) {
-            auto it_fd  = this->fds.begin();
-            auto it_dev = this->devs.begin();
+            auto it = this->index.find(fd);
 
-            // Locate the index which fits the description
-            while (it_fd != this->fds.end() && it_dev != this->devs.end()) {
-                if ((*it_fd).fd == fd) {
-                    this->fds.erase(it_fd);
-                    this->devs.erase(it_dev);
-                    break;
-                }
+            if (it == this->index.end())
+                return;
 
-                it_fd++;
-                it_dev++;
+            // Move the last registration into the hole so that removal does
+            // not have to shift the remaining entries
+            size_t idx  = it->second;
+            size_t last = this->fds.size() - 1;
+
+            this->index.erase(it);
+
+            if (idx != last) {
+                this->fds[idx]                 = this->fds[last];
+                this->devs[idx]                = std::move(this->devs[last]);
+                this->index[this->fds[idx].fd] = idx;
             }
+
+            this->fds.pop_back();
+            this->devs.pop_back();
         }
     };
 
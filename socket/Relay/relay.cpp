@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "relay.hpp"
+
+namespace Sockets {
+
+    Relay::Relay(std::shared_ptr<TCPSocket> client, std::shared_ptr<TCPSocket> upstream,
+                 size_t pipe_size)
+        : capacity(pipe_size) {
+        if (dynamic_cast<TLSSocket *>(client.get()) || dynamic_cast<TLSSocket *>(upstream.get()))
+            throw std::runtime_error("Cannot relay TLS sockets");
+
+        this->up.from   = client;
+        this->up.to     = upstream;
+        this->down.from = std::move(upstream);
+        this->down.to   = std::move(client);
+
+        for (Direction *d : {&this->up, &this->down}) {
+            if (pipe2(d->pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+                perror("Relay::Relay(std::shared_ptr<TCPSocket>, std::shared_ptr<TCPSocket>, "
+                       "size_t)");
+                this->close();
+                throw std::runtime_error("Error when creating relay pipe");
+            }
+
+            // Growing a pipe past `pipe-max-size` takes CAP_SYS_RESOURCE, the
+            // default size will do as well
+            if (fcntl(d->pipe[1], F_SETPIPE_SZ, static_cast<int>(pipe_size)) == -1 &&
+                errno != EPERM)
+                perror("Non-fatal error Relay::Relay(std::shared_ptr<TCPSocket>, "
+                       "std::shared_ptr<TCPSocket>, size_t)");
+
+            int size = fcntl(d->pipe[1], F_GETPIPE_SZ);
+
+            if (size > 0)
+                this->capacity = std::min(this->capacity, static_cast<size_t>(size));
+        }
+    }
+
+    Relay::~Relay() { this->close(); }
+
+    void Relay::close() {
+        for (Direction *d : {&this->up, &this->down})
+            for (int &fd : d->pipe)
+                if (fd != -1) {
+                    ::close(fd);
+                    fd = -1;
+                }
+    }
+
+    bool Relay::fill(Direction &d, bool once) {
+        bool progress = false;
+
+        while (!d.eof && d.buffered < this->capacity) {
+            ssize_t n = splice(d.from->fd(), nullptr, d.pipe[1], nullptr,
+                               this->capacity - d.buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+
+                perror("Relay::pump()");
+                throw std::runtime_error("Error when splicing from socket");
+            }
+
+            progress = true;
+
+            if (n == 0)
+                d.eof = true;
+            else
+                d.buffered += n;
+
+            if (once)
+                break;
+        }
+
+        return progress;
+    }
+
+    bool Relay::drain(Direction &d, bool once) {
+        bool progress = false;
+
+        while (d.buffered) {
+            ssize_t n = splice(d.pipe[0], nullptr, d.to->fd(), nullptr, d.buffered,
+                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+
+                perror("Relay::pump()");
+                throw std::runtime_error("Error when splicing to socket");
+            }
+
+            progress = true;
+            d.buffered -= n;
+            d.bytes += n;
+
+            if (once)
+                break;
+        }
+
+        return progress;
+    }
+
+    void Relay::move(Direction &d, bool readable, bool writable) {
+        // Blocking sockets get one splice per readiness report, a second one
+        // could wait
+        bool rounds = !d.from->blocking() && !d.to->blocking();
+
+        for (;;) {
+            bool progress = false;
+
+            if (readable)
+                progress |= this->fill(d, d.from->blocking());
+
+            if (writable)
+                progress |= this->drain(d, d.to->blocking());
+
+            if (!progress || !rounds)
+                break;
+        }
+
+        // Pass the end of the stream on once everything before it is out
+        if (d.eof && !d.buffered && !d.shut) {
+            if (::shutdown(d.to->fd(), SHUT_WR) == -1 && errno != ENOTCONN)
+                perror("Non-fatal error Relay::pump()");
+
+            d.shut = true;
+        }
+    }
+
+    bool Relay::pump() {
+        const std::shared_ptr<TCPSocket> &client   = this->up.from;
+        const std::shared_ptr<TCPSocket> &upstream = this->down.from;
+
+        // Non-blocking sockets find out for themselves, blocking ones are
+        // only touched once they are ready
+        short cr = POLLIN | POLLOUT;
+        short ur = POLLIN | POLLOUT;
+
+        if (client->blocking() || upstream->blocking()) {
+            struct pollfd fds[2] = {{client->fd(), this->events(client), 0},
+                                    {upstream->fd(), this->events(upstream), 0}};
+
+            if (::poll(fds, 2, 0) < 0) {
+                perror("Relay::pump()");
+                throw std::runtime_error("Error when polling relayed sockets");
+            }
+
+            // Errors and hang ups surface through the splice itself
+            if (client->blocking())
+                cr = fds[0].revents & (POLLERR | POLLHUP) ? POLLIN | POLLOUT : fds[0].revents;
+
+            if (upstream->blocking())
+                ur = fds[1].revents & (POLLERR | POLLHUP) ? POLLIN | POLLOUT : fds[1].revents;
+        }
+
+        this->move(this->up, cr & POLLIN, ur & POLLOUT);
+        this->move(this->down, ur & POLLIN, cr & POLLOUT);
+
+        if (this->update)
+            this->update();
+
+        return !this->done();
+    }
+
+    void Relay::run() {
+        Poll<TCPSocket> poll;
+
+        while (this->pump()) {
+            poll.enroll(this->up.from, this->events(this->up.from));
+            poll.enroll(this->down.from, this->events(this->down.from));
+            poll.poll();
+        }
+    }
+
+    short Relay::events(const std::shared_ptr<TCPSocket> &s) const {
+        if (s != this->up.from && s != this->down.from)
+            return 0;
+
+        // The direction `s` reads into and the one it is written from
+        const Direction &in  = s == this->up.from ? this->up : this->down;
+        const Direction &out = s == this->up.from ? this->down : this->up;
+
+        short ev = 0;
+
+        if (!in.eof && in.buffered < this->capacity)
+            ev |= POLLIN;
+
+        if (out.buffered)
+            ev |= POLLOUT;
+
+        return ev;
+    }
+} // namespace Sockets
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <poll.h>
+
+#include "../Polling/polling.hpp"
+#include "../Socket/socket.hpp"
+
+namespace Sockets {
+
+    /**
+     * @brief Shovels bytes between two connected `TCPSocket`s in both
+     * directions, as an L4 proxy does. Data moves socket to pipe to socket
+     * with `splice(2)` and never passes through user space.
+     *
+     * Non-blocking sockets are spliced until the kernel pushes back, blocking
+     * ones only as far as they are ready so that `pump` never waits. A
+     * direction which reads the end of its stream shuts down writing on the
+     * other socket once its pipe is drained, the other direction carries on
+     * until it is done as well.
+     *
+     * The relay takes over the I/O of both sockets, nothing else should read
+     * from or write to them. TLS sockets cannot be relayed since splicing
+     * bypasses the record layer.
+     *
+     */
+    class Relay {
+        struct Direction {
+            std::shared_ptr<TCPSocket> from;
+            std::shared_ptr<TCPSocket> to;
+
+            int    pipe[2]  = {-1, -1};
+            size_t buffered = 0;
+            bool   eof      = false;
+            bool   shut     = false;
+
+            uint64_t bytes = 0;
+        };
+
+        // From the client to the upstream and back
+        Direction up;
+        Direction down;
+        size_t    capacity;
+
+        std::function<void()> update;
+
+        void close();
+        bool fill(Direction &d, bool once);
+        bool drain(Direction &d, bool once);
+        void move(Direction &d, bool readable, bool writable);
+
+        public:
+        // Each direction buffers up to `pipe_size` bytes in its pipe, as far
+        // as `/proc/sys/fs/pipe-max-size` allows
+        Relay(std::shared_ptr<TCPSocket> client, std::shared_ptr<TCPSocket> upstream,
+              size_t pipe_size = 64 * 1024);
+
+        ~Relay();
+
+        Relay(const Relay &) = delete;
+        Relay &operator=(const Relay &) = delete;
+
+        // Move whatever both sides have to offer without waiting. Call this
+        // whenever either socket is reported ready. Returns false once both
+        // directions are shut down.
+        bool pump();
+
+        // Relay until both directions are shut down
+        void run();
+
+        // What `s`, one of the two relayed sockets, needs to be polled for.
+        // `POLLIN` while its pipe has room and `POLLOUT` while data for it
+        // is waiting in the other pipe.
+        short events(const std::shared_ptr<TCPSocket> &s) const;
+
+        // Keep the registration of both sockets on `poll` in line with
+        // `events` after every `pump`
+        template <class S>
+        void watch(Poll<S> &poll) {
+            auto client   = std::static_pointer_cast<S>(this->up.from);
+            auto upstream = std::static_pointer_cast<S>(this->down.from);
+
+            this->update = [this, &poll, client, upstream]() {
+                poll.enroll(client, this->events(this->up.from));
+                poll.enroll(upstream, this->events(this->down.from));
+            };
+
+            this->update();
+        }
+
+        bool done() const { return this->up.shut && this->down.shut; }
+
+        // Bytes delivered from the client to the upstream and back
+        uint64_t upstream_bytes() const { return this->up.bytes; }
+        uint64_t downstream_bytes() const { return this->down.bytes; }
+
+        // Bytes read but not yet delivered, sitting in the pipes
+        size_t buffered() const { return this->up.buffered + this->down.buffered; }
+    };
+} // namespace Sockets
@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include "../Exceptions/exceptions.hpp"
+#include "socket.hpp"
+
+namespace Sockets {
+
+    namespace {
+        unsigned char  cookie_secret[32];
+        bool           cookie_ready = false;
+        std::once_flag cookie_once;
+
+        // HMAC of the peer address, so a cookie proves that the peer can
+        // receive at the address it claims without the server keeping state
+        bool cookie(SSL *ssl, unsigned char *out, unsigned int *len) {
+            sockaddr_storage peer;
+
+            std::call_once(cookie_once, []() {
+                cookie_ready = RAND_bytes(cookie_secret, sizeof(cookie_secret)) == 1;
+            });
+
+            if (!cookie_ready)
+                return false;
+
+            std::memset(&peer, 0, sizeof(peer));
+            BIO_dgram_get_peer(SSL_get_rbio(ssl), &peer);
+
+            size_t size = peer.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+
+            return HMAC(EVP_sha256(), cookie_secret, sizeof(cookie_secret),
+                        reinterpret_cast<unsigned char *>(&peer), size, out, len) != NULL;
+        }
+
+        int generate_cookie(SSL *ssl, unsigned char *out, unsigned int *len) {
+            return cookie(ssl, out, len) ? 1 : 0;
+        }
+
+        int verify_cookie(SSL *ssl, const unsigned char *in, unsigned int len) {
+            unsigned char expected[EVP_MAX_MD_SIZE];
+            unsigned int  n = 0;
+
+            return cookie(ssl, expected, &n) && n == len && CRYPTO_memcmp(expected, in, n) == 0;
+        }
+
+        // Set the don't fragment bit so that the kernel tracks the path MTU,
+        // which OpenSSL queries to size its records
+        void discover_mtu(int fd, Domain dom) {
+            int pmtu = IP_PMTUDISC_DO;
+
+            if (dom == Domain::IPv6)
+                setsockopt(fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+            else
+                setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+        }
+
+        sockaddr_storage to_sockaddr(const BIO_ADDR *in, socklen_t &len) {
+            sockaddr_storage out;
+            size_t           n = 0;
+
+            std::memset(&out, 0, sizeof(out));
+
+            if (BIO_ADDR_family(in) == AF_INET6) {
+                sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6 *>(&out);
+
+                sin6->sin6_family = AF_INET6;
+                sin6->sin6_port   = BIO_ADDR_rawport(in);
+                BIO_ADDR_rawaddress(in, &sin6->sin6_addr, &n);
+                len = sizeof(sockaddr_in6);
+            } else {
+                sockaddr_in *sin = reinterpret_cast<sockaddr_in *>(&out);
+
+                sin->sin_family = AF_INET;
+                sin->sin_port   = BIO_ADDR_rawport(in);
+                BIO_ADDR_rawaddress(in, &sin->sin_addr, &n);
+                len = sizeof(sockaddr_in);
+            }
+
+            return out;
+        }
+
+        // Payload which fits into one record and one datagram. On links with
+        // a large MTU, such as loopback, the record size is the limit.
+        size_t data_mtu(SSL *ssl) {
+            size_t mtu = DTLS_get_data_mtu(ssl);
+
+            return mtu ? std::min<size_t>(mtu, SSL3_RT_MAX_PLAIN_LENGTH) : 0;
+        }
+
+        void set_blocking(int fd, Operation op) {
+            int flags = fcntl(fd, F_GETFL, 0);
+
+            flags = op == Operation::Non_blocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+
+            if (fcntl(fd, F_SETFL, flags) == -1) {
+                perror("DTLSSocket");
+                throw std::runtime_error("Error when changing blocking mode of socket");
+            }
+        }
+    } // namespace
+
+    DTLSSocket::DTLSSocket(UDPSocket &udp, SSL_CTX *ctx) : UDPSocket(udp) {
+        if ((this->ssl = SSL_new(ctx)) == NULL) {
+            throw std::runtime_error("Error when creating SSL state");
+        }
+
+        BIO *bio = BIO_new_dgram(this->_fd, BIO_NOCLOSE);
+
+        if (bio == NULL) {
+            throw std::runtime_error("Error when creating datagram BIO");
+        }
+
+        SSL_set_bio(this->ssl, bio, bio);
+    }
+
+    DTLSSocket::DTLSSocket(UDPSocket &udp, SSL *ssl) : UDPSocket(udp) {
+        this->ssl = ssl;
+
+        if (this->ssl)
+            BIO_set_fd(SSL_get_rbio(this->ssl), this->_fd, BIO_NOCLOSE);
+    }
+
+    DTLSSocket::~DTLSSocket() { SSL_free(this->ssl); }
+
+    void DTLSSocket::enable_cookies(SSL_CTX *ctx) {
+        SSL_CTX_set_cookie_generate_cb(ctx, generate_cookie);
+        SSL_CTX_set_cookie_verify_cb(ctx, verify_cookie);
+    }
+
+    void DTLSSocket::connected() {
+        if (!this->ssl)
+            throw std::runtime_error("Cannot transfer data on a DTLS listener");
+    }
+
+    void DTLSSocket::connect() {
+        int m;
+
+        if (this->state != State::Instantiated)
+            throw std::runtime_error("Cannot connect with a busy socket");
+
+        UDPSocket::connect();
+
+        BIO_ctrl(SSL_get_rbio(this->ssl), BIO_CTRL_DGRAM_SET_CONNECTED, 0, &this->addr);
+        discover_mtu(this->_fd, this->domain);
+
+        // The handshake is done blocking, the requested mode applies after
+        set_blocking(this->_fd, Operation::Blocking);
+
+        if ((m = SSL_connect(this->ssl)) != 1)
+            throw_ssl_error(SSL_get_error(this->ssl, m));
+
+        X509 *cert = SSL_get_peer_certificate(this->ssl);
+
+        if (!cert)
+            throw std::runtime_error("No X509 certificate received from server");
+
+        X509_free(cert);
+
+        if (SSL_get_verify_result(this->ssl) != X509_V_OK)
+            throw std::runtime_error("Failed to verify received certificate");
+
+        set_blocking(this->_fd, this->operation);
+
+        this->state = State::Connected;
+    }
+
+    void DTLSSocket::service(int backlog) {
+        int reuse = 1;
+
+        // Every accepted peer gets a socket bound to the same address
+        if (setsockopt(this->_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0) {
+            perror("DTLSSocket::service(int)");
+            throw std::runtime_error("Error when setting SO_REUSEADDR");
+        }
+
+        UDPSocket::service(backlog);
+
+        this->state = State::Open;
+    }
+
+    std::shared_ptr<DTLSSocket> DTLSSocket::connect(std::string address, uint16_t port,
+                                                    Domain dom, SSL_CTX *ctx, Operation op) {
+        auto      addr = resolve(address, port, dom, Type::Datagram);
+        UDPSocket udp(*addr, dom, op);
+
+        freeaddrinfo(addr);
+
+        std::shared_ptr<DTLSSocket> out(new DTLSSocket(udp, ctx));
+
+        out->connect();
+
+        return out;
+    }
+
+    std::shared_ptr<DTLSSocket> DTLSSocket::service(std::string address, uint16_t port,
+                                                    Domain dom, Operation op, SSL_CTX *ctx) {
+        auto      addr = resolve(address, port, dom, Type::Datagram);
+        UDPSocket udp(*addr, dom, op);
+
+        freeaddrinfo(addr);
+
+        // The listener only ever runs the cookie exchange, which uses a
+        // fresh SSL state per attempt
+        std::shared_ptr<DTLSSocket> out(new DTLSSocket(udp, static_cast<SSL *>(nullptr)));
+
+        out->service(0);
+
+        if (ctx) {
+            enable_cookies(ctx);
+            out->cookies = ctx;
+        }
+
+        return out;
+    }
+
+    std::shared_ptr<DTLSSocket> DTLSSocket::accept(SSL_CTX *ctx, Operation op) {
+        int              fd;
+        int              reuse    = 1;
+        socklen_t        peer_len = 0;
+        sockaddr_storage peer;
+
+        if (this->state != State::Open)
+            throw std::runtime_error("Cannot accept connection on a socket that is not open");
+
+        if (ctx != this->cookies) {
+            enable_cookies(ctx);
+            this->cookies = ctx;
+        }
+
+        SSL *ssl = SSL_new(ctx);
+        BIO *bio = BIO_new_dgram(this->_fd, BIO_NOCLOSE);
+
+        if (ssl == NULL || bio == NULL) {
+            SSL_free(ssl);
+            BIO_free(bio);
+            throw std::runtime_error("Error when creating SSL state");
+        }
+
+        SSL_set_bio(ssl, bio, bio);
+        SSL_set_options(ssl, SSL_OP_COOKIE_EXCHANGE);
+
+        BIO_ADDR *client = BIO_ADDR_new();
+
+        // Answer ClientHellos without a valid cookie until one comes back
+        // with it. Nothing is allocated per peer before that.
+        for (;;) {
+            if (this->operation == Operation::Non_blocking) {
+                pollfd pending = {this->_fd, POLLIN, 0};
+
+                if (::poll(&pending, 1, 0) <= 0) {
+                    BIO_ADDR_free(client);
+                    SSL_free(ssl);
+                    return nullptr;
+                }
+            }
+
+            int m = DTLSv1_listen(ssl, client);
+
+            if (m > 0)
+                break;
+
+            if (m < 0) {
+                BIO_ADDR_free(client);
+                SSL_free(ssl);
+                throw std::runtime_error("Error when listening for DTLS connections");
+            }
+        }
+
+        peer = to_sockaddr(client, peer_len);
+        BIO_ADDR_free(client);
+
+        // A socket connected to the peer takes over, the kernel prefers it
+        // over the listener for datagrams from that peer
+        if ((fd = ::socket(peer.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+            bind(fd, (struct sockaddr *)&this->addr, sizeof(this->addr)) < 0 ||
+            ::connect(fd, (struct sockaddr *)&peer, peer_len) < 0) {
+            perror("DTLSSocket::accept(SSL_CTX *, Operation)");
+
+            if (fd >= 0)
+                ::close(fd);
+
+            SSL_free(ssl);
+            throw std::runtime_error("Error when creating socket for DTLS peer");
+        }
+
+        std::shared_ptr<DTLSSocket> out;
+
+        try {
+            UDPSocket udp(fd, peer, this->domain, op);
+            out.reset(new DTLSSocket(udp, ssl));
+        } catch (...) {
+            ::close(fd);
+            SSL_free(ssl);
+            throw;
+        }
+
+        ::close(fd);
+
+        BIO_ctrl(SSL_get_rbio(out->ssl), BIO_CTRL_DGRAM_SET_CONNECTED, 0, &peer);
+        discover_mtu(out->_fd, this->domain);
+
+        // The new socket is still blocking, so the handshake runs to its end
+        // here whatever `op` and the listener say
+        int m = SSL_accept(out->ssl);
+
+        if (m <= 0)
+            throw_ssl_error(SSL_get_error(out->ssl, m));
+
+        set_blocking(out->_fd, op);
+
+        out->state = State::Connected;
+
+        return out;
+    }
+
+    size_t DTLSSocket::mtu() {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        this->connected();
+
+        return data_mtu(this->ssl);
+    }
+
+    void DTLSSocket::mtu(size_t link_mtu) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        this->connected();
+
+        SSL_set_options(this->ssl, SSL_OP_NO_QUERY_MTU);
+
+        // The link MTU only takes effect on the next write, set the derived
+        // datagram size right away as well
+        size_t overhead = BIO_dgram_get_mtu_overhead(SSL_get_wbio(this->ssl));
+
+        if (link_mtu <= overhead || !DTLS_set_link_mtu(this->ssl, link_mtu) ||
+            !SSL_set_mtu(this->ssl, link_mtu - overhead))
+            throw std::runtime_error("MTU is too small for DTLS");
+    }
+
+    void DTLSSocket::close() {
+        if (this->ssl && this->state == State::Connected) {
+            // Best effort, a lost close_notify is harmless over datagrams
+            set_blocking(this->_fd, Operation::Non_blocking);
+            SSL_shutdown(this->ssl);
+        }
+
+        UDPSocket::close();
+    }
+
+    size_t DTLSSocket::send(const char *buf, size_t buflen) {
+        ssize_t m = 0;
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        this->connected();
+
+        // OpenSSL has no notion of an empty record
+        if (!buflen)
+            return 0;
+
+        size_t limit = data_mtu(this->ssl);
+
+        if (limit && buflen > limit)
+            throw std::runtime_error("Message does not fit into a single DTLS record");
+
+        stats_timestamp(start);
+        m = SSL_write(this->ssl, buf, buflen);
+
+        if (m <= 0) {
+            int  err     = SSL_get_error(this->ssl, m);
+            bool blocked = err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE;
+
+            stats_record(this->stats.sent, -1, buflen, start, blocked);
+
+            if (blocked && this->operation == Operation::Non_blocking) {
+                errno = EAGAIN;
+                return 0;
+            }
+
+            throw_ssl_error(err);
+        }
+
+        stats_record(this->stats.sent, m, buflen, start, false);
+
+        return m;
+    }
+
+    size_t DTLSSocket::recv_some(char *buf, size_t buflen) {
+        ssize_t m = 0;
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        this->connected();
+
+        stats_timestamp(start);
+        m = SSL_read(this->ssl, buf, buflen);
+
+        if (m <= 0) {
+            int  err     = SSL_get_error(this->ssl, m);
+            bool blocked = err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE;
+
+            stats_record(this->stats.received, -1, buflen, start, blocked);
+
+            if (blocked && this->operation == Operation::Non_blocking) {
+                errno = EAGAIN;
+                return 0;
+            }
+
+            throw_ssl_error(err);
+        }
+
+        stats_record(this->stats.received, m, buflen, start, false);
+
+        return m;
+    }
+
+    size_t DTLSSocket::recv(char *buf, size_t buflen) { return this->recv_some(buf, buflen); }
+} // namespace Sockets
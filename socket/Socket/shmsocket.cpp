@@ -0,0 +1,803 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "socket.hpp"
+
+// The rings are shared with another process, which only works with atomics
+// that do not fall back to a lock
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "ShmSocket needs lock-free 32 and 64 bit atomics");
+
+namespace Sockets {
+
+    /**
+     * @brief Control block of one direction, at the start of the mapping.
+     * `head` and `tail` count bytes written and read since the start and
+     * sit on cache lines of their own so that the two ends do not contend.
+     *
+     */
+    struct ShmSocket::Ring {
+        // Written by the producer only
+        alignas(64) std::atomic<uint64_t> head;
+
+        // Written by the consumer only
+        alignas(64) std::atomic<uint64_t> tail;
+
+        // Raised by the consumer before it sleeps on an empty ring and by
+        // the producer before it sleeps on a full one
+        alignas(64) std::atomic<uint32_t> reader_waiting;
+        std::atomic<uint32_t> writer_waiting;
+
+        // The producer closed, nothing follows what is in the ring, or the
+        // consumer closed and nothing will be read any more
+        std::atomic<uint32_t> eof;
+        std::atomic<uint32_t> gone;
+    };
+
+    namespace {
+        const uint32_t shm_magic   = 0x53484d52;
+        const uint32_t shm_version = 1;
+
+        // Sent by the listener together with the memfd and the eventfds
+        struct Hello {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t capacity;
+        };
+
+        // The memfd, then the data and space eventfds of the server and of
+        // the client
+        const int shm_fds = 5;
+
+        // Both ring headers share the first page, the data of both
+        // directions follows
+        const size_t shm_header = 4096;
+
+        void notify(int efd) {
+            uint64_t one = 1;
+
+            // A full counter already wakes the peer up
+            if (write(efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+                perror("Non-fatal error when signalling peer");
+        }
+
+        void drain(int efd) {
+            uint64_t count;
+
+            if (read(efd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                perror("Non-fatal error when draining eventfd");
+        }
+
+        void close_fd(int &fd) {
+            if (fd < 0)
+                return;
+
+            if (::close(fd) != 0)
+                perror("Non-fatal error when closing file descriptor");
+
+            fd = -1;
+        }
+
+        // Whether a listener accepts connections at `addr`. A full backlog
+        // counts as listening, only a refused connection does not.
+        bool listening(const sockaddr_storage &addr) {
+            int  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            bool up = true;
+
+            if (fd < 0)
+                return true;
+
+            if (::connect(fd, (const struct sockaddr *)&addr, sizeof(sockaddr_un)) < 0)
+                up = errno != ECONNREFUSED;
+
+            close_fd(fd);
+            return up;
+        }
+
+        struct addrinfo unix_address(const std::string &path, sockaddr_un &sun) {
+            struct addrinfo info;
+
+            if (path.size() >= sizeof(sun.sun_path))
+                throw std::runtime_error("UNIX socket path is too long");
+
+            std::memset(&sun, 0, sizeof(sun));
+            sun.sun_family = AF_UNIX;
+            std::memcpy(sun.sun_path, path.c_str(), path.size());
+
+            std::memset(&info, 0, sizeof(info));
+            info.ai_family   = AF_UNIX;
+            info.ai_socktype = SOCK_STREAM;
+            info.ai_addr     = (struct sockaddr *)&sun;
+            info.ai_addrlen  = sizeof(sun);
+
+            return info;
+        }
+    } // namespace
+
+    ShmSocket::ShmSocket(struct addrinfo &info, Operation op)
+        : Socket(info, Domain::UNIX, Type::Stream, op) { }
+
+    ShmSocket::ShmSocket(int fd, sockaddr_storage &info, Operation op)
+        : Socket(fd, info, Domain::UNIX, Type::Stream, op) { }
+
+    ShmSocket::~ShmSocket() { this->close(); }
+
+    void ShmSocket::connect() {
+        if (this->state != State::Instantiated)
+            throw std::runtime_error("Cannot connect with a busy socket");
+
+        if (::connect(this->_fd, (struct sockaddr *)&this->addr, sizeof(sockaddr_un)) < 0) {
+            perror("ShmSocket::connect()");
+            throw std::runtime_error("Error when trying to connect to destination");
+        }
+
+        Hello        hello;
+        struct iovec iov = {&hello, sizeof(hello)};
+        union {
+            char           buf[CMSG_SPACE(sizeof(int) * shm_fds)];
+            struct cmsghdr align;
+        } control;
+        struct msghdr msg;
+
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ssize_t n;
+
+        while ((n = recvmsg(this->_fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL)) < 0 && errno == EINTR)
+            ;
+
+        if (n < 0) {
+            perror("ShmSocket::connect()");
+            throw std::runtime_error("Error when receiving the shared rings");
+        }
+
+        int             fds[shm_fds];
+        int             received = 0;
+        struct cmsghdr *c        = CMSG_FIRSTHDR(&msg);
+
+        if (c && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            received = std::min<int>((c->cmsg_len - CMSG_LEN(0)) / sizeof(int), shm_fds);
+            std::memcpy(fds, CMSG_DATA(c), sizeof(int) * received);
+        }
+
+        if (n != sizeof(hello) || received != shm_fds || hello.magic != shm_magic ||
+            hello.version != shm_version || !hello.capacity ||
+            (hello.capacity & (hello.capacity - 1))) {
+            for (int i = 0; i < received; i++)
+                close_fd(fds[i]);
+
+            throw std::runtime_error("Peer is not a ShmSocket listener");
+        }
+
+        try {
+            this->attach(fds[0], fds + 1, hello.capacity, false);
+        } catch (...) {
+            close_fd(fds[0]);
+            throw;
+        }
+
+        close_fd(fds[0]);
+    }
+
+    void ShmSocket::service(int backlog) {
+        if (this->state != State::Instantiated)
+            throw std::runtime_error("Cannot service with a busy socket");
+
+        const char *path = ((sockaddr_un *)&this->addr)->sun_path;
+        struct stat st;
+
+        // Take over the path from a listener that died without cleaning up,
+        // which nothing answers on any more. Live listeners and anything
+        // which is not a socket are left alone.
+        if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode) && !listening(this->addr))
+            unlink(path);
+
+        if (bind(this->_fd, (struct sockaddr *)&this->addr, sizeof(sockaddr_un)) < 0) {
+            perror("ShmSocket::service(int)");
+            throw std::runtime_error("Error when binding socket to address");
+        }
+
+        if (stat(path, &st) == 0)
+            this->node = st.st_ino;
+
+        if (listen(this->_fd, backlog)) {
+            perror("ShmSocket::service(int)");
+            throw std::runtime_error("Error when trying to listen on socket");
+        }
+
+        this->state = State::Open;
+    }
+
+    std::shared_ptr<ShmSocket> ShmSocket::connect(std::string path, Operation op) {
+        sockaddr_un     sun;
+        struct addrinfo info = unix_address(path, sun);
+
+        // The rings are set up in blocking mode, `op` applies to them only
+        std::shared_ptr<ShmSocket> sock(new ShmSocket(info, Operation::Blocking));
+
+        sock->connect();
+        sock->operation = op;
+        return sock;
+    }
+
+    std::shared_ptr<ShmSocket> ShmSocket::service(std::string path, Operation op, int backlog,
+                                                  size_t capacity) {
+        sockaddr_un     sun;
+        struct addrinfo info = unix_address(path, sun);
+
+        std::shared_ptr<ShmSocket> sock(new ShmSocket(info, op));
+
+        sock->capacity = 4096;
+
+        while (sock->capacity < capacity)
+            sock->capacity <<= 1;
+
+        sock->service(backlog);
+        return sock;
+    }
+
+    std::shared_ptr<ShmSocket> ShmSocket::accept(Operation op) {
+        int              fd;
+        sockaddr_storage info;
+        socklen_t        len = sizeof(info);
+
+        if (this->state != State::Open)
+            throw std::runtime_error("Cannot accept connection on a socket that is not open");
+
+        if ((fd = ::accept4(this->fd(), (struct sockaddr *)&info, &len, SOCK_CLOEXEC)) == -1) {
+            perror("ShmSocket::accept(Operation)");
+            throw std::runtime_error("Error when accepting connection");
+        }
+
+        std::shared_ptr<ShmSocket> out;
+
+        try {
+            out = std::shared_ptr<ShmSocket>(new ShmSocket(fd, info, op));
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+
+        if (::close(fd) != 0)
+            perror("Non-fatal error when closing file descriptor");
+
+        int fds[shm_fds] = {-1, -1, -1, -1, -1};
+        int i            = 0;
+
+        fds[0] = memfd_create("ShmSocket", MFD_CLOEXEC);
+
+        if (fds[0] >= 0 && ftruncate(fds[0], shm_header + 2 * this->capacity) == 0)
+            for (i = 1; i < shm_fds; i++)
+                if ((fds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+                    break;
+
+        if (i != shm_fds) {
+            perror("ShmSocket::accept(Operation)");
+
+            for (i = 0; i < shm_fds; i++)
+                close_fd(fds[i]);
+
+            throw std::runtime_error("Error when creating the shared rings");
+        }
+
+        // The rings have to be constructed before the peer gets to see them
+        try {
+            out->attach(fds[0], fds + 1, this->capacity, true);
+        } catch (...) {
+            close_fd(fds[0]);
+            throw;
+        }
+
+        Hello        hello = {shm_magic, shm_version, this->capacity};
+        struct iovec iov   = {&hello, sizeof(hello)};
+        union {
+            char           buf[CMSG_SPACE(sizeof(int) * shm_fds)];
+            struct cmsghdr align;
+        } control;
+        struct msghdr msg;
+
+        std::memset(&control, 0, sizeof(control));
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type  = SCM_RIGHTS;
+        c->cmsg_len   = CMSG_LEN(sizeof(int) * shm_fds);
+        std::memcpy(CMSG_DATA(c), fds, sizeof(int) * shm_fds);
+
+        ssize_t sent = sendmsg(out->ctl, &msg, MSG_NOSIGNAL);
+
+        if (sent != sizeof(hello))
+            perror("ShmSocket::accept(Operation)");
+
+        // The eventfds belong to `out` by now
+        close_fd(fds[0]);
+
+        if (sent != sizeof(hello))
+            throw std::runtime_error("Error when sending the shared rings");
+
+        return out;
+    }
+
+    void ShmSocket::attach(int memfd, int fds[4], size_t capacity, bool server) {
+        static_assert(2 * sizeof(Ring) <= shm_header, "Ring headers do not fit their page");
+
+        // The server sends on the first ring and sleeps on the first pair of
+        // eventfds, the client the other way around
+        this->data       = fds[server ? 0 : 2];
+        this->space      = fds[server ? 1 : 3];
+        this->peer_data  = fds[server ? 2 : 0];
+        this->peer_space = fds[server ? 3 : 1];
+        this->ctl        = this->_fd;
+        this->_fd        = -1;
+        this->capacity   = capacity;
+        this->map_size   = shm_header + 2 * capacity;
+        this->map = mmap(nullptr, this->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+        if (this->map == MAP_FAILED) {
+            perror("ShmSocket::attach(int, int *, size_t, bool)");
+            this->map = nullptr;
+            this->release();
+            throw std::runtime_error("Error when mapping the shared rings");
+        }
+
+        // The server constructs both rings in the fresh mapping, the client
+        // only ever sees them constructed
+        Ring *rings = static_cast<Ring *>(this->map);
+        char *base  = static_cast<char *>(this->map) + shm_header;
+
+        if (server) {
+            new (&rings[0]) Ring();
+            new (&rings[1]) Ring();
+
+            // Both ends start out waiting for data, so that a socket which is
+            // polled before its first receive still wakes up
+            rings[0].reader_waiting.store(1);
+            rings[1].reader_waiting.store(1);
+        }
+
+        this->rx_armed = true;
+
+        this->tx      = &rings[server ? 0 : 1];
+        this->rx      = &rings[server ? 1 : 0];
+        this->tx_data = base + (server ? 0 : capacity);
+        this->rx_data = base + (server ? capacity : 0);
+
+        // What the user polls is an epoll instance over both eventfds and
+        // the UNIX connection, which reports the peer hanging up
+        struct epoll_event ev;
+
+        std::memset(&ev, 0, sizeof(ev));
+
+        if ((this->_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            perror("ShmSocket::attach(int, int *, size_t, bool)");
+            this->release();
+            throw std::runtime_error("Error when creating the pollable descriptor");
+        }
+
+        int      watched[3] = {this->data, this->space, this->ctl};
+        uint32_t events[3]  = {EPOLLIN, EPOLLIN, EPOLLIN | EPOLLRDHUP};
+
+        for (int i = 0; i < 3; i++) {
+            ev.events  = events[i];
+            ev.data.fd = watched[i];
+
+            if (epoll_ctl(this->_fd, EPOLL_CTL_ADD, watched[i], &ev) < 0) {
+                perror("ShmSocket::attach(int, int *, size_t, bool)");
+                this->release();
+                throw std::runtime_error("Error when creating the pollable descriptor");
+            }
+        }
+
+        this->state = State::Connected;
+    }
+
+    void ShmSocket::release() {
+        if (this->map) {
+            // Wake up a peer sleeping on either ring so it sees the end
+            this->tx->eof.store(1);
+            this->rx->gone.store(1);
+
+            notify(this->peer_data);
+            notify(this->peer_space);
+
+            if (munmap(this->map, this->map_size) != 0)
+                perror("Non-fatal error when unmapping shared rings");
+
+            this->map = nullptr;
+            this->rx  = nullptr;
+            this->tx  = nullptr;
+        }
+
+        if (this->ctl >= 0 && shutdown(this->ctl, SHUT_RDWR) == -1 && errno != ENOTCONN)
+            perror("Non-fatal error when shutting down socket");
+
+        close_fd(this->ctl);
+        close_fd(this->data);
+        close_fd(this->space);
+        close_fd(this->peer_data);
+        close_fd(this->peer_space);
+    }
+
+    void ShmSocket::close() {
+        if (this->state == State::Closed)
+            return;
+
+        const char *path = ((sockaddr_un *)&this->addr)->sun_path;
+        struct stat st;
+
+        // A listener removes its path, unless another one took it over
+        if (this->state == State::Open && stat(path, &st) == 0 && st.st_ino == this->node)
+            unlink(path);
+
+        this->release();
+
+        if (this->_fd >= 0 && ::close(this->_fd) != 0)
+            perror("Non-fatal error when closing socket");
+
+        this->_fd   = -1;
+        this->state = State::Closed;
+    }
+
+    void ShmSocket::spin(std::chrono::microseconds budget) {
+        this->budget = std::chrono::duration_cast<std::chrono::nanoseconds>(budget).count();
+    }
+
+    bool ShmSocket::busy_poll(std::chrono::microseconds budget, bool) {
+        this->spin(budget);
+        return true;
+    }
+
+    short ShmSocket::interest(short events) {
+        if (this->state != State::Connected)
+            return events;
+
+        // Only the eventfds asked for stay in the epoll set, so that data
+        // nobody reads does not keep waking a poller which waits for room
+        int   efds[2]  = {this->data, this->space};
+        short kinds[2] = {POLLIN, POLLOUT};
+
+        for (int i = 0; i < 2; i++) {
+            bool on = events & kinds[i];
+
+            if (on == bool(this->polled & kinds[i]))
+                continue;
+
+            struct epoll_event ev;
+
+            std::memset(&ev, 0, sizeof(ev));
+            ev.events  = EPOLLIN;
+            ev.data.fd = efds[i];
+
+            if (epoll_ctl(this->_fd, on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, efds[i], &ev) < 0) {
+                perror("ShmSocket::interest(short)");
+                throw std::runtime_error("Error when changing what the descriptor reports");
+            }
+        }
+
+        this->polled = events & (POLLIN | POLLOUT);
+
+        // poll(2) only hands on the events asked for, and an epoll instance
+        // is never anything but readable
+        return events | POLLIN;
+    }
+
+    short ShmSocket::readiness(short revents) {
+        // A listener's descriptor is the UNIX socket it accepts on
+        if (this->state != State::Connected || !(revents & POLLIN))
+            return revents;
+
+        short out  = revents & ~POLLIN;
+        bool  data = this->rx->head.load(std::memory_order_acquire) !=
+                    this->rx->tail.load(std::memory_order_relaxed);
+        bool  room = this->tx->head.load(std::memory_order_relaxed) -
+                        this->tx->tail.load(std::memory_order_acquire) <
+                    this->capacity;
+
+        if (data)
+            out |= this->polled & POLLIN;
+
+        if (room)
+            out |= this->polled & POLLOUT;
+
+        if (!data && (this->rx->eof.load() || this->hung_up()))
+            out |= POLLHUP | (this->polled & POLLIN);
+
+        return out;
+    }
+
+    size_t ShmSocket::pull(char *buf, size_t buflen) {
+        uint64_t tail = this->rx->tail.load(std::memory_order_relaxed);
+
+        if (this->rx_head - tail < buflen)
+            this->rx_head = this->rx->head.load(std::memory_order_acquire);
+
+        // The positions live in memory the peer can write to. More than a
+        // full ring between them cannot happen with a well behaved peer and
+        // would make the copies below run past the ring.
+        if (this->rx_head - tail > this->capacity) {
+            this->close();
+            errno = EPROTO;
+            perror("ShmSocket::recv(char *, size_t)");
+            throw std::runtime_error("Peer corrupted the shared ring");
+        }
+
+        size_t n = std::min<uint64_t>(buflen, this->rx_head - tail);
+
+        if (!n)
+            return 0;
+
+        size_t at    = tail & (this->capacity - 1);
+        size_t first = std::min(n, this->capacity - at);
+
+        std::memcpy(buf, this->rx_data + at, first);
+        std::memcpy(buf + first, this->rx_data, n - first);
+
+        this->rx->tail.store(tail + n, std::memory_order_release);
+
+        // Pairs with the fence in `send`, either the producer sees the space
+        // or it is signalled
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (this->rx->writer_waiting.load(std::memory_order_relaxed) &&
+            this->rx->writer_waiting.exchange(0))
+            notify(this->peer_space);
+
+        return n;
+    }
+
+    size_t ShmSocket::push(const char *buf, size_t buflen) {
+        uint64_t head = this->tx->head.load(std::memory_order_relaxed);
+
+        if (this->capacity - (head - this->tx_tail) < buflen)
+            this->tx_tail = this->tx->tail.load(std::memory_order_acquire);
+
+        // Likewise a tail ahead of the head or lagging more than a full ring
+        if (head - this->tx_tail > this->capacity) {
+            this->close();
+            errno = EPROTO;
+            perror("ShmSocket::send(const char *, size_t)");
+            throw std::runtime_error("Peer corrupted the shared ring");
+        }
+
+        size_t n = std::min<uint64_t>(buflen, this->capacity - (head - this->tx_tail));
+
+        if (!n)
+            return 0;
+
+        size_t at    = head & (this->capacity - 1);
+        size_t first = std::min(n, this->capacity - at);
+
+        std::memcpy(this->tx_data + at, buf, first);
+        std::memcpy(this->tx_data, buf + first, n - first);
+
+        this->tx->head.store(head + n, std::memory_order_release);
+
+        // Pairs with the fence in `recv_some`, either the consumer sees the
+        // data or it is signalled
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (this->tx->reader_waiting.load(std::memory_order_relaxed) &&
+            this->tx->reader_waiting.exchange(0))
+            notify(this->peer_data);
+
+        return n;
+    }
+
+    bool ShmSocket::hung_up() {
+        char c;
+
+        // The peer never writes to the connection, reading its end means it
+        // closed or died
+        return ::recv(this->ctl, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0;
+    }
+
+    void ShmSocket::sleep(int efd) {
+        struct pollfd fds[2] = {{efd, POLLIN, 0}, {this->ctl, POLLIN | POLLRDHUP, 0}};
+
+        if (::poll(fds, 2, -1) < 0 && errno != EINTR) {
+            perror("ShmSocket::sleep(int)");
+            throw std::runtime_error("Error when waiting for peer");
+        }
+    }
+
+    template <class F>
+    bool ShmSocket::spin_until(F ready) {
+        if (!this->budget)
+            return false;
+
+        uint64_t end = now_ns() + this->budget;
+
+        do {
+            if (ready())
+                return true;
+        } while (now_ns() < end);
+
+        return false;
+    }
+
+    size_t ShmSocket::recv_some(char *buf, size_t buflen) {
+        auto readable = [this]() {
+            return this->rx->head.load(std::memory_order_acquire) !=
+                   this->rx->tail.load(std::memory_order_relaxed);
+        };
+
+        if (this->state != State::Connected)
+            throw std::runtime_error("Cannot receive on a socket that is not connected");
+
+        stats_timestamp(start);
+        errno = 0;
+
+        while (true) {
+            size_t n = this->pull(buf, buflen);
+
+            if (n || !buflen) {
+                // `fd()` stays readable while data is left in the ring, the
+                // wakeup is only consumed once the read emptied it. A
+                // non-blocking socket, the kind that gets polled, raises the
+                // flag again right away so that the next data signals it.
+                if (n && readable()) {
+                    if (!this->rx_armed) {
+                        this->rx_armed = true;
+                        notify(this->data);
+                    }
+                } else if (n && this->rx_armed) {
+                    drain(this->data);
+
+                    if (this->blocking()) {
+                        this->rx_armed = false;
+                        this->rx->reader_waiting.store(0, std::memory_order_relaxed);
+                    } else {
+                        this->rx->reader_waiting.store(1);
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                        if (readable())
+                            notify(this->data);
+                    }
+                }
+
+                stats_record(this->stats.received, n, buflen, start);
+                return n;
+            }
+
+            if (this->blocking() && this->spin_until(readable))
+                continue;
+
+            // Drain before raising the flag so that a signal sent after it
+            // is not lost
+            if (this->rx_armed)
+                drain(this->data);
+
+            this->rx_armed = true;
+            this->rx->reader_waiting.store(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (readable())
+                continue;
+
+            // Whatever was written before the end is still delivered
+            if (this->rx->eof.load() || this->hung_up()) {
+                if (readable())
+                    continue;
+
+                stats_record(this->stats.received, 0, buflen, start);
+                return 0;
+            }
+
+            if (!this->blocking()) {
+                errno = EAGAIN;
+                stats_record(this->stats.received, -1, buflen, start);
+                return 0;
+            }
+
+            this->sleep(this->data);
+        }
+    }
+
+    size_t ShmSocket::recv(char *buf, size_t buflen) {
+        if (!this->blocking())
+            return this->recv_some(buf, buflen);
+
+        size_t n = 0;
+
+        while (n < buflen) {
+            size_t m = this->recv_some(buf + n, buflen - n);
+
+            if (!m)
+                break;
+
+            n += m;
+        }
+
+        return n;
+    }
+
+    size_t ShmSocket::send(const char *buf, size_t buflen) {
+        auto writable = [this]() {
+            return this->tx->head.load(std::memory_order_relaxed) -
+                       this->tx->tail.load(std::memory_order_acquire) <
+                   this->capacity;
+        };
+
+        if (this->state != State::Connected)
+            throw std::runtime_error("Cannot send on a socket that is not connected");
+
+        stats_timestamp(start);
+        size_t n = 0;
+
+        errno = 0;
+
+        while (n < buflen) {
+            if (this->tx->gone.load(std::memory_order_relaxed)) {
+                errno = EPIPE;
+                perror("ShmSocket::send(const char *, size_t)");
+                throw std::runtime_error("Error when sending data");
+            }
+
+            size_t m = this->push(buf + n, buflen - n);
+
+            if (m) {
+                if (this->tx_armed) {
+                    this->tx_armed = false;
+                    this->tx->writer_waiting.store(0, std::memory_order_relaxed);
+                    drain(this->space);
+                }
+
+                n += m;
+                continue;
+            }
+
+            if (this->blocking() && this->spin_until(writable))
+                continue;
+
+            if (this->tx_armed)
+                drain(this->space);
+
+            this->tx_armed = true;
+            this->tx->writer_waiting.store(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (writable())
+                continue;
+
+            if (this->hung_up()) {
+                errno = EPIPE;
+                perror("ShmSocket::send(const char *, size_t)");
+                throw std::runtime_error("Error when sending data");
+            }
+
+            if (!this->blocking()) {
+                errno = EAGAIN;
+                break;
+            }
+
+            this->sleep(this->space);
+        }
+
+        stats_record(this->stats.sent, n ? (ssize_t)n : -1, buflen, start);
+        return n;
+    }
+} // namespace Sockets
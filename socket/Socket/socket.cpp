@@ -1,8 +1,13 @@
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 #include <errno.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <netinet/in.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "socket.hpp"
@@ -61,6 +66,9 @@ namespace Sockets {
         this->operation = op;
     }
 
+    Socket::Socket(Adopt, int fd, const sockaddr_storage &info, Domain dom, Type ty, Operation op)
+        : _fd(fd), addr(info), domain(dom), type(ty), operation(op) { }
+
     Socket::Socket(struct addrinfo &info, Domain dom, Type ty, Operation op) {
 
         if ((this->_fd = socket(info.ai_family, info.ai_socktype, info.ai_protocol)) < 0) {
@@ -73,13 +81,16 @@ namespace Sockets {
 
         switch (dom) {
         case Domain::IPv4:
-            std::memcpy(&this->addr, (sockaddr_storage *)info.ai_addr, sizeof(sockaddr_storage));
+            std::memcpy(&this->addr, info.ai_addr, info.ai_addrlen);
             break;
         case Domain::IPv6:
-            std::memcpy(&this->addr, (sockaddr_storage *)info.ai_addr, sizeof(sockaddr_storage));
+            std::memcpy(&this->addr, info.ai_addr, info.ai_addrlen);
+            break;
+        case Domain::UNIX:
+            std::memcpy(&this->addr, info.ai_addr, info.ai_addrlen);
             break;
         default:
-            // TODO: Handle unix and undefined domains
+            // TODO: Handle undefined domains
             break;
         }
 
@@ -145,6 +156,17 @@ namespace Sockets {
         }
     }
 
+    Lease Socket::recv(BufferPool &pool) {
+        Lease lease = pool.lease();
+
+        lease.resize(this->recv_some(lease.data(), lease.capacity()));
+
+        if (!lease.size())
+            lease.release();
+
+        return lease;
+    }
+
     void Socket::close() {
         if (this->state == State::Closed)
             return;
@@ -155,7 +177,181 @@ namespace Sockets {
         if (::close(this->fd()) != 0 && errno != ENOTCONN)
             perror("Non-fatal error when closing socket");
 
+        // Forget the descriptor so the destructor cannot close a reused number
+        this->_fd   = -1;
         this->state = State::Closed;
     }
 
-} // namespace Sockets
\ No newline at end of file
+    void Socket::read_timestamp(struct msghdr &msg, Timestamp &ts) {
+        // A read without a timestamp must not report the previous one
+        ts = Timestamp();
+
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SO_TIMESTAMPING)
+                continue;
+
+            struct scm_timestamping stamps;
+
+            std::memcpy(&stamps, CMSG_DATA(c), sizeof(stamps));
+
+            // The second entry is unused, the third is the raw hardware clock
+            ts.software = stamps.ts[0].tv_sec * 1000000000ULL + stamps.ts[0].tv_nsec;
+            ts.hardware = stamps.ts[2].tv_sec * 1000000000ULL + stamps.ts[2].tv_nsec;
+        }
+    }
+
+    void Socket::timestamping(bool enable, bool hardware) {
+        int flags = 0;
+
+        if (enable) {
+            flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                    SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID |
+                    SOF_TIMESTAMPING_OPT_TSONLY;
+
+            // Streams are also told when the peer acknowledged the data
+            if (this->type == Type::Stream)
+                flags |= SOF_TIMESTAMPING_TX_ACK;
+
+            if (hardware)
+                flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE |
+                         SOF_TIMESTAMPING_RAW_HARDWARE;
+        }
+
+        int       old = 0;
+        socklen_t len = sizeof(old);
+
+        if (getsockopt(this->_fd, SOL_SOCKET, SO_TIMESTAMPING, &old, &len) < 0 ||
+            setsockopt(this->_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+            perror("Socket::timestamping(bool, bool)");
+            throw std::runtime_error("Error when configuring timestamping");
+        }
+
+        // The kernel only starts counting ids afresh when the ids are turned
+        // on, enabling again keeps the count going
+        if ((flags & SOF_TIMESTAMPING_OPT_ID) && !(old & SOF_TIMESTAMPING_OPT_ID))
+            this->tx_count = 0;
+    }
+
+    bool Socket::busy_poll(std::chrono::microseconds budget, bool prefer) {
+        int usec = budget.count() > INT32_MAX ? INT32_MAX : std::max<int>(0, budget.count());
+        int on   = prefer && usec > 0;
+
+        if (setsockopt(this->_fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0) {
+            if (errno == EPERM || errno == ENOTSOCK || errno == ENOPROTOOPT)
+                return false;
+
+            perror("Socket::busy_poll(std::chrono::microseconds, bool)");
+            throw std::runtime_error("Error when configuring busy polling");
+        }
+
+#ifdef SO_PREFER_BUSY_POLL
+        // Older kernels lack the preference, plain busy polling still applies
+        if (setsockopt(this->_fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on)) < 0 &&
+            errno != ENOPROTOOPT) {
+            if (errno == EPERM)
+                return false;
+
+            perror("Socket::busy_poll(std::chrono::microseconds, bool)");
+            throw std::runtime_error("Error when configuring busy polling");
+        }
+#else
+        (void)on;
+#endif
+
+        return true;
+    }
+
+    void Socket::pacing_rate(uint64_t bytes_per_second) {
+        // A rate of 0 would hold every packet back, the largest one is
+        // unlimited
+        unsigned long rate = bytes_per_second ? bytes_per_second : ~0UL;
+
+        if (setsockopt(this->_fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) < 0) {
+            perror("Socket::pacing_rate(uint64_t)");
+            throw std::runtime_error("Error when setting the pacing rate");
+        }
+    }
+
+    bool Socket::txtime(clockid_t clock) {
+#ifdef SO_TXTIME
+        struct sock_txtime cfg = {clock, 0};
+
+        if (setsockopt(this->_fd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) < 0) {
+            if (errno == ENOPROTOOPT || errno == EOPNOTSUPP)
+                return false;
+
+            perror("Socket::txtime(clockid_t)");
+            throw std::runtime_error("Error when enabling SO_TXTIME");
+        }
+
+        this->tx_clock = clock;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    size_t Socket::tx_timestamps(std::vector<TxTimestamp> &out) {
+        size_t n = 0;
+
+        union {
+            char           buf[512];
+            struct cmsghdr align;
+        } control;
+
+        while (true) {
+            struct msghdr msg = {};
+
+            msg.msg_control    = control.buf;
+            msg.msg_controllen = sizeof(control.buf);
+
+            // With `OPT_TSONLY` the queued packets carry no payload
+            if (::recvmsg(this->_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+
+                perror("Socket::tx_timestamps(std::vector<TxTimestamp> &)");
+                throw std::runtime_error("Error when reading error queue");
+            }
+
+            TxTimestamp tx;
+            bool        found = false;
+
+            for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+                if (!((c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) ||
+                      (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR)))
+                    continue;
+
+                struct sock_extended_err err;
+
+                std::memcpy(&err, CMSG_DATA(c), sizeof(err));
+
+                if (err.ee_errno != ENOMSG || err.ee_origin != SO_EE_ORIGIN_TIMESTAMPING)
+                    continue;
+
+                switch (err.ee_info) {
+                case SCM_TSTAMP_SCHED:
+                    tx.kind = TxTimestamp::Kind::Scheduled;
+                    break;
+                case SCM_TSTAMP_ACK:
+                    tx.kind = TxTimestamp::Kind::Acknowledged;
+                    break;
+                default:
+                    tx.kind = TxTimestamp::Kind::Sent;
+                }
+
+                tx.id = err.ee_data;
+                found = true;
+            }
+
+            if (!found)
+                continue;
+
+            read_timestamp(msg, tx.time);
+            out.push_back(tx);
+            n++;
+        }
+
+        return n;
+    }
+} // namespace Sockets
@@ -1,18 +1,27 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include <endian.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
+#include "../BufferPool/bufferpool.hpp"
+#include "../Statistics/statistics.hpp"
+
 #define valid_fd(fd) (fcntl(fd, F_GETFD) != -1 || errno != EBADF)
 
 namespace Sockets {
@@ -40,6 +49,48 @@ namespace Sockets {
     struct addrinfo *resolve(std::string &address, uint16_t port, Domain dom = Domain::Undefined,
                              Type ty = Type::Undefined, int flags = 0);
 
+    /**
+     * @brief Address of the other end of a datagram on an unconnected
+     * `UDPSocket`. Filled in by `UDPSocket::recv_from` and used as is by
+     * `UDPSocket::send_to`, so replying involves no conversion.
+     *
+     */
+    struct Peer {
+        sockaddr_storage addr;
+        socklen_t        len = 0;
+
+        // Compares family, port and address, bytes beyond them are ignored
+        bool operator==(const Peer &other) const;
+        bool operator!=(const Peer &other) const { return !(*this == other); }
+
+        size_t hash() const;
+    };
+
+    /**
+     * @brief Kernel timestamps of a packet in nanoseconds since the epoch. A
+     * kind of timestamp which is not available is 0.
+     *
+     */
+    struct Timestamp {
+        uint64_t software = 0;
+        uint64_t hardware = 0;
+    };
+
+    /**
+     * @brief Timestamp of a sent packet, taken from the error queue. `id`
+     * equals `Socket::tx_id()` right after the send it belongs to.
+     *
+     */
+    struct TxTimestamp {
+        enum class Kind { Scheduled, Sent, Acknowledged };
+
+        Kind      kind = Kind::Sent;
+        uint32_t  id   = 0;
+        Timestamp time;
+    };
+
+    class LineReader;
+
     /**
      * @brief The base socket class. Should not be instantiated by itself, but
      * rather through one of it's derived classes. Essentially acts as a
@@ -49,6 +100,9 @@ namespace Sockets {
         virtual void connect()            = 0;
         virtual void service(int backlog) = 0;
 
+        // Reads whatever has arrived through `recv_some`
+        friend class LineReader;
+
         protected:
         std::mutex       mtx;
         int              _fd;
@@ -59,10 +113,33 @@ namespace Sockets {
         State     state     = State::Instantiated;
         Operation operation = Operation::Blocking;
 
+#ifdef SOCKETS_STATISTICS
+        IOStatistics stats;
+#endif
+
+        // Counts what the kernel counts for `SOF_TIMESTAMPING_OPT_ID`, bytes
+        // on a stream and datagrams otherwise
+        uint32_t tx_count = 0;
+
+        // Clock the qdisc reads `SO_TXTIME` departure times on
+        clockid_t tx_clock = CLOCK_MONOTONIC;
+
+        static void read_timestamp(struct msghdr &msg, Timestamp &ts);
+
         Socket(int fd, sockaddr_storage &info, Domain dom, Type ty,
                Operation op = Operation::Blocking);
         Socket(struct addrinfo &info, Domain dom, Type ty, Operation op = Operation::Blocking);
 
+        // Take over `fd` itself instead of a duplicate, for descriptors fresh
+        // from `accept4` which nothing else refers to
+        struct Adopt { };
+        Socket(Adopt, int fd, const sockaddr_storage &info, Domain dom, Type ty, Operation op);
+
+        // Receive with a single call, whatever is available up to `buflen`.
+        // Returns 0 without data, `errno` tells a non-blocking socket with
+        // nothing to read apart from a closed connection.
+        virtual size_t recv_some(char *buf, size_t buflen) = 0;
+
         public:
         Socket(Socket &other);
         Socket(Socket &&other);
@@ -70,24 +147,96 @@ namespace Sockets {
 
         ~Socket();
 
-        void           close();
+        virtual void   close();
         virtual size_t send(const char *buf, size_t buflen) = 0;
         virtual size_t recv(char *buf, size_t buflen)       = 0;
 
+        // Receive into a buffer leased from `pool`. The buffer is handed back
+        // straight away if nothing was read, so idle connections hold none.
+        // Meant for sockets which are reported readable.
+        Lease recv(BufferPool &pool);
+
         const int &fd() { return this->_fd; }
+
+        // What `Poll<S>` has poll(2) watch `fd()` for to learn about
+        // `events`, and what the `revents` it reported mean for this socket.
+        // Both are asked through `S`, so a socket whose descriptor is not a
+        // plain socket can hide them.
+        short interest(short events) { return events; }
+        short readiness(short revents) { return revents; }
+
+        bool blocking() const { return this->operation == Operation::Blocking; }
+
+        // Have the kernel timestamp received and sent packets, in software
+        // and with `hardware` also on the network card. Hardware timestamps
+        // additionally need the card set up with `SIOCSHWTSTAMP`. Enable it
+        // before sending anything so that `tx_id` lines up with the kernel.
+        void timestamping(bool enable, bool hardware = false);
+
+        // Id which the TX timestamps of the most recent send will carry.
+        // Not kept for `TLSSocket`, the kernel counts the bytes of the TLS
+        // records there, which a send cannot be matched up with.
+        uint32_t tx_id() const { return this->tx_count - 1; }
+
+        // Collect the TX timestamps the kernel queued so far without
+        // blocking. Queued timestamps make the socket poll with `POLLERR`.
+        size_t tx_timestamps(std::vector<TxTimestamp> &out);
+
+        // Let blocking receives on this socket spin on the device queue for
+        // up to `budget` before sleeping. `prefer` sets `SO_PREFER_BUSY_POLL`,
+        // which only matters to epoll based busy polling, not to `poll(2)`.
+        // Returns false when going beyond `net.core.busy_read` is not
+        // permitted or the descriptor cannot busy poll at all.
+        bool busy_poll(std::chrono::microseconds budget, bool prefer = true);
+
+        // Cap the rate the kernel sends this socket's packets at, in bytes
+        // per second. TCP paces on its own, other sockets need the `fq`
+        // qdisc on the outgoing interface. 0 lifts the cap.
+        void pacing_rate(uint64_t bytes_per_second);
+
+        // Let sends carry the time the packet is to leave at, which the
+        // `fq` and `etf` qdiscs hold the packet back until. `clock` has to
+        // be the one the qdisc runs on: `fq` uses `CLOCK_MONOTONIC`, `etf`
+        // the clock it was configured with, normally `CLOCK_TAI`. Cannot be
+        // turned off again. Returns false when the kernel does not support
+        // it.
+        bool txtime(clockid_t clock = CLOCK_MONOTONIC);
+
+#ifdef SOCKETS_STATISTICS
+        // Counters and latency histograms for the I/O done on this socket
+        IOSnapshot statistics() const { return this->stats.snapshot(); }
+#endif
     };
 
+    template <class S>
+    class SocketArena;
+
     /**
      * @brief A class which handles basic TCP socket. All the data is streamed
      * to the other end with all the standard TCP guarantees.
      *
      */
     class TCPSocket : public Socket {
+        template <class S>
+        friend class SocketArena;
+
         protected:
-        void connect() override;
-        void service(int backlog) override;
+        void   connect() override;
+        void   service(int backlog) override;
+        size_t recv_some(char *buf, size_t buflen) override;
+
+        // Accept a single pending connection, -1 when there is none. Only the
+        // `first` accept of a batch may wait on a blocking listener or fail
+        // for lack of descriptors.
+        int accept_one(sockaddr_storage &info, int flag, bool first);
 
         TCPSocket(int fd, sockaddr_storage &info, Domain dom, Operation op = Operation::Blocking);
+        TCPSocket(Adopt, int fd, const sockaddr_storage &info, Domain dom, Operation op);
+
+        // TCP Fast Open for the connect of a client, or for a listener with
+        // room for `queue` connections whose handshake is not complete yet
+        void fast_open_connect();
+        void fast_open_listen(int queue);
 
         public:
         TCPSocket(struct addrinfo &info, Domain dom, Operation op = Operation::Blocking);
@@ -97,17 +246,49 @@ namespace Sockets {
 
         ~TCPSocket();
 
+        // With `fast_open` a server whose cookie the kernel holds is only
+        // contacted by the first send, which carries its data in the SYN and
+        // saves a round trip. Without a cookie, or without kernel support,
+        // the regular handshake is used. Errors of a deferred connect such as
+        // a refused connection surface on the first send instead.
         static std::shared_ptr<TCPSocket> connect(std::string address, uint16_t port, Domain dom,
-                                                  Operation op = Operation::Blocking);
+                                                  Operation op        = Operation::Blocking,
+                                                  bool      fast_open = false);
+
+        // A `fast_open` queue above 0 lets clients send data with their SYN,
+        // which is readable as soon as the connection is accepted. The kernel
+        // also needs `net.ipv4.tcp_fastopen` to allow it for servers.
         static std::shared_ptr<TCPSocket> service(std::string address, uint16_t port, Domain dom,
-                                                  Operation op      = Operation::Blocking,
-                                                  int       backlog = 100);
+                                                  Operation op        = Operation::Blocking,
+                                                  int       backlog   = 100,
+                                                  int       fast_open = 0);
 
         std::shared_ptr<TCPSocket> accept(Operation op = Operation::Blocking, int flag = 0);
 
-        void   close();
+        // Accept up to `max` pending connections into `out` and return how
+        // many were added. Stops without throwing once the backlog is empty.
+        // Accepted descriptors are close-on-exec. A blocking listener only
+        // waits for the first connection.
+        size_t accept_batch(std::vector<std::shared_ptr<TCPSocket>> &out, size_t max,
+                            Operation op = Operation::Blocking, int flag = 0);
+
+        void   close() override;
         size_t send(const char *buf, size_t buflen) override;
         size_t recv(char *buf, size_t buflen) override;
+        using Socket::recv;
+
+        // Receive whatever is available up to `buflen` with a single call and
+        // report when the kernel received it, see `timestamping`
+        size_t recv(char *buf, size_t buflen, Timestamp &ts);
+
+        // Gathering send which writes all the buffers with a single system
+        // call where possible. Blocking sockets send everything, non-blocking
+        // ones return how much was accepted.
+        virtual size_t sendv(const struct iovec *iov, int iovcnt);
+
+        // Whether the data sent or received with the SYN was accepted, which
+        // is how a Fast Open connection tells it saved the round trip
+        bool fast_opened();
     };
 
     /**
@@ -117,9 +298,28 @@ namespace Sockets {
      *
      */
     class UDPSocket : public Socket {
+        friend class DTLSSocket;
+
+        template <class S>
+        friend class SocketArena;
+
+        // Kernel count of datagrams dropped for lack of buffer space, updated
+        // by `recv_from` once `count_drops` is enabled
+        bool     overflow = false;
+        uint32_t drops    = 0;
+
+        // Datagrams `recv_from` had to cut short
+        uint64_t truncations = 0;
+
+        size_t receive(char *buf, size_t buflen, Peer &peer, Timestamp *ts);
+
+        void membership(int option, const std::string &group, const std::string &source,
+                        const std::string &interface);
+
         protected:
-        void connect() override;
-        void service(int backlog) override;
+        void   connect() override;
+        void   service(int backlog) override;
+        size_t recv_some(char *buf, size_t buflen) override;
 
         UDPSocket(int fd, sockaddr_storage &info, Domain dom, Operation op = Operation::Blocking);
 
@@ -137,9 +337,66 @@ namespace Sockets {
                                                   Operation op      = Operation::Blocking,
                                                   int       backlog = 100);
 
-        void   close();
+        void   close() override;
         size_t send(const char *buf, size_t buflen) override;
         size_t recv(char *buf, size_t buflen) override;
+        using Socket::recv;
+
+        // Receive exactly one datagram and where it came from. A datagram
+        // longer than `buflen` is cut short, which sets `errno` to
+        // `EMSGSIZE` and is counted by `truncated`. A non-blocking socket
+        // returns 0 with `errno` set to `EAGAIN` when nothing is pending.
+        size_t recv_from(char *buf, size_t buflen, Peer &peer);
+
+        // As above, also reporting when the kernel received the datagram, see
+        // `timestamping`
+        size_t recv_from(char *buf, size_t buflen, Peer &peer, Timestamp &ts);
+
+        // Send one datagram to `peer`, typically filled in by `recv_from`
+        size_t send_to(const char *buf, size_t buflen, const Peer &peer);
+
+        // Send one datagram which is to leave the host no earlier than `at`,
+        // a `now_ns` timestamp which is moved onto the clock given to
+        // `txtime`. Needs `txtime`, without a qdisc honouring the time the
+        // datagram leaves straight away.
+        size_t send_at(const char *buf, size_t buflen, uint64_t at);
+
+        // Receive traffic for the multicast `group` on `port`. The socket is
+        // bound to the group with `SO_REUSEPORT` so that several sockets and
+        // processes can subscribe to the same group. `interface` names the
+        // network interface to join on, the routing table decides if empty.
+        static std::shared_ptr<UDPSocket> subscribe(std::string group, uint16_t port, Domain dom,
+                                                    Operation   op        = Operation::Blocking,
+                                                    std::string interface = "");
+
+        // Group membership, any source or source specific. Works for IPv4
+        // and IPv6 alike.
+        void join(const std::string &group, const std::string &interface = "");
+        void leave(const std::string &group, const std::string &interface = "");
+        void join(const std::string &group, const std::string &source,
+                  const std::string &interface);
+        void leave(const std::string &group, const std::string &source,
+                   const std::string &interface);
+
+        // Options for sending to a group: whether this host receives its own
+        // datagrams, how many hops they travel and the outgoing interface
+        void multicast_loop(bool enable);
+        void multicast_ttl(int hops);
+        void multicast_interface(const std::string &interface);
+
+        // Grow the receive buffer to absorb bursts. Goes beyond
+        // `net.core.rmem_max` when the process has `CAP_NET_ADMIN`. Returns
+        // the size the kernel settled on.
+        size_t receive_buffer(size_t bytes);
+
+        // Have the kernel report datagrams it dropped because the receive
+        // buffer was full (`SO_RXQ_OVFL`). The count is cumulative and
+        // refreshed by every `recv_from`.
+        void     count_drops(bool enable);
+        uint32_t dropped() const { return this->drops; }
+
+        // Datagrams received by `recv_from` which did not fit the buffer
+        uint64_t truncated() const { return this->truncations; }
     };
 
     /**
@@ -156,11 +413,25 @@ namespace Sockets {
     class TLSSocket : public TCPSocket {
         SSL *ssl = nullptr;
 
+        // Output layer used while coalescing. `out` holds plaintext which has
+        // not been written as a record yet, `retry` the length of a record
+        // which has to be written again after it would have blocked.
+        bool              coalescing = false;
+        std::vector<char> out;
+        size_t            retry      = 0;
+        uint64_t          streamed   = 0;
+        uint64_t          last_write = 0;
+
+        size_t record_size();
+        size_t write_record(const char *buf, size_t len);
+        void   drain(bool all);
+
         protected:
         TLSSocket(TCPSocket &tcp, SSL_CTX *ctx);
 
-        void connect();
-        void service(int backlog);
+        void   connect();
+        void   service(int backlog);
+        size_t recv_some(char *buf, size_t buflen);
 
         public:
         TLSSocket(struct addrinfo &info, Domain dom, SSL_CTX *ctx,
@@ -170,18 +441,53 @@ namespace Sockets {
 
         ~TLSSocket();
 
+        // Fast Open behaves as for `TCPSocket`, with the ClientHello going
+        // out with the SYN
         static std::shared_ptr<TLSSocket> connect(std::string address, uint16_t port, Domain dom,
-                                                  SSL_CTX *ctx, Operation op = Operation::Blocking);
+                                                  SSL_CTX *ctx, Operation op = Operation::Blocking,
+                                                  bool fast_open = false);
         static std::shared_ptr<TLSSocket> service(std::string address, uint16_t port, Domain dom,
                                                   SSL_CTX *ctx, Operation op = Operation::Blocking,
-                                                  int backlog = 100);
+                                                  int backlog = 100, int fast_open = 0);
 
         std::shared_ptr<TLSSocket> accept(SSL_CTX *ctx, Operation op = Operation::Blocking,
                                           int flag = 0);
 
-        void   close();
+        // Run the server side of the handshake on an accepted connection.
+        // Blocks until the handshake is done, so that it can be moved off the
+        // event loop, see `HandshakePool`.
+        static std::shared_ptr<TLSSocket> upgrade(TCPSocket &conn, SSL_CTX *ctx,
+                                                  Operation op = Operation::Blocking);
+
+        // Descriptors an engine signals on once a job paused with
+        // `ssl_error_want_async` can be resumed. Only used with
+        // `SSL_MODE_ASYNC` on non-blocking sockets, blocking ones wait for
+        // the engine themselves.
+        std::vector<int> async_fds();
+
+        void   close() override;
         size_t send(const char *buf, size_t buflen);
         size_t recv(char *buf, size_t buflen);
+        using Socket::recv;
+
+        // TLS has no gathering write, the buffers are copied into one
+        // `SSL_write` so that they share as few records as possible
+        size_t sendv(const struct iovec *iov, int iovcnt);
+
+        // Coalesce sends into full records instead of writing a record per
+        // call. Records start out small enough for a single segment, so the
+        // first bytes of a connection or of a burst after an idle period can
+        // be decrypted as soon as they arrive, and grow to 16KB once data
+        // streams. Buffered data goes out once a record fills up or on
+        // `flush`. Turning coalescing off flushes what is buffered.
+        void coalesce(bool enable);
+
+        // Write whatever is buffered, including a partial record. Returns the
+        // number of bytes still buffered, which is only ever non-zero for a
+        // non-blocking socket which would block.
+        size_t flush();
+
+        size_t buffered() const { return this->out.size(); }
     };
 
     /**
@@ -194,6 +500,204 @@ namespace Sockets {
      * this will not take responsibility for that and the cleanup which comes
      * from it.
      *
+     * Every `send` is one DTLS record in one datagram and every `recv`
+     * returns one record, so message boundaries survive. Messages must fit
+     * into `mtu()`. A server verifies peers with a stateless cookie exchange
+     * before it allocates anything for them and then moves each peer onto a
+     * socket of its own connected to that peer.
+     *
+     */
+    class DTLSSocket : public UDPSocket {
+        SSL *ssl = nullptr;
+
+        // Context a listener installed the cookie callbacks on
+        SSL_CTX *cookies = nullptr;
+
+        // Listeners have no DTLS state of their own, only accepted and
+        // connected sockets carry data
+        void connected();
+
+        protected:
+        DTLSSocket(UDPSocket &udp, SSL_CTX *ctx);
+        DTLSSocket(UDPSocket &udp, SSL *ssl);
+
+        void   connect();
+        void   service(int backlog);
+        size_t recv_some(char *buf, size_t buflen);
+
+        public:
+        // The DTLS state is bound to the descriptor of this socket, copies
+        // would have to share it
+        DTLSSocket(DTLSSocket &other)  = delete;
+        DTLSSocket(DTLSSocket &&other) = delete;
+
+        ~DTLSSocket();
+
+        static std::shared_ptr<DTLSSocket> connect(std::string address, uint16_t port, Domain dom,
+                                                   SSL_CTX *ctx,
+                                                   Operation op = Operation::Blocking);
+        // Installs the cookie callbacks on `ctx` up front when given one
+        static std::shared_ptr<DTLSSocket> service(std::string address, uint16_t port, Domain dom,
+                                                   Operation op  = Operation::Blocking,
+                                                   SSL_CTX * ctx = nullptr);
+
+        // Wait for a peer which passes the cookie exchange and complete the
+        // handshake with it. A non-blocking listener returns nullptr once no
+        // datagrams are pending, but a peer past the cookie exchange is
+        // always handshaken on the calling thread, blocking until it
+        // finishes or fails, and the socket only turns non-blocking after.
+        // Installs the cookie callbacks on `ctx` unless the listener already
+        // did.
+        std::shared_ptr<DTLSSocket> accept(SSL_CTX *ctx, Operation op = Operation::Blocking);
+
+        // Stateless cookies derived from the peer address and a per-process
+        // secret, for contexts used with `DTLSv1_listen`
+        static void enable_cookies(SSL_CTX *ctx);
+
+        // Largest message a single `send` can carry. It follows the path MTU
+        // the kernel discovers unless it was pinned with `mtu(size_t)`.
+        size_t mtu();
+        void   mtu(size_t link_mtu);
+
+        void   close() override;
+        size_t send(const char *buf, size_t buflen);
+        size_t recv(char *buf, size_t buflen);
+        using Socket::recv;
+    };
+
+    /**
+     * @brief A stream between two processes on the same host which bypasses
+     * the kernel. Each direction is a lock-free single producer, single
+     * consumer ring in a shared `memfd` mapping, so a `send` and the `recv`
+     * on the other end cost one copy each and no syscall.
+     *
+     * A side which finds the ring empty (or full) raises a flag before going
+     * to sleep on an eventfd, and the peer only signals the eventfd while
+     * the flag is up. With `spin` a blocking socket first spins on the ring
+     * for a while, which keeps both sides off the eventfds altogether while
+     * messages keep flowing.
+     *
+     * The rings are set up over a UNIX socket at `path`: the listener
+     * creates the mapping and the eventfds and passes them on with
+     * `SCM_RIGHTS`. That connection stays open to notice a peer that died.
+     * `fd()` is an epoll instance and becomes readable when data arrived,
+     * ring space was freed or the peer went away. poll(2) never reports it
+     * writable, so polled by hand it only ever shows `POLLIN`. `Poll<S>`
+     * sorts that out through `interest` and `readiness`, which report room
+     * in the ring as `POLLOUT`. Freed space only wakes the descriptor up
+     * after a send came up short, which is when `WriteDispatch` asks for
+     * `POLLOUT`.
+     *
+     * One thread may send while another receives, but neither direction
+     * may be used by two threads at once.
+     *
      */
-    class DTLSSocket : public UDPSocket { };
-} // namespace Sockets
\ No newline at end of file
+    class ShmSocket : public Socket {
+        struct Ring;
+
+        // UNIX connection the rings were set up over
+        int ctl = -1;
+
+        // Eventfds this side sleeps on, for data and for space in the ring,
+        // and the peer's counterparts
+        int data       = -1;
+        int space      = -1;
+        int peer_data  = -1;
+        int peer_space = -1;
+
+        // Size of each ring, on a listener the size accepted connections get
+        size_t capacity = 0;
+
+        // Inode of the path a listener is bound to, which it removes again
+        ino_t node = 0;
+
+        void * map      = nullptr;
+        size_t map_size = 0;
+
+        Ring *rx      = nullptr;
+        Ring *tx      = nullptr;
+        char *rx_data = nullptr;
+        char *tx_data = nullptr;
+
+        // Last positions seen of the other end of each ring, refreshed only
+        // when the ring looks empty or full
+        uint64_t rx_head = 0;
+        uint64_t tx_tail = 0;
+
+        // Whether the flags were raised since the eventfds were last drained
+        bool rx_armed = false;
+        bool tx_armed = false;
+
+        // Events the epoll instance watches the eventfds for, see `interest`
+        short polled = POLLIN | POLLOUT;
+
+        uint64_t budget = 0;
+
+        // Map the rings and take over the eventfds, `memfd` stays with the
+        // caller
+        void   attach(int memfd, int fds[4], size_t capacity, bool server);
+        void   release();
+        size_t pull(char *buf, size_t buflen);
+        size_t push(const char *buf, size_t buflen);
+        bool   hung_up();
+        void   sleep(int efd);
+
+        template <class F>
+        bool spin_until(F ready);
+
+        protected:
+        void   connect() override;
+        void   service(int backlog) override;
+        size_t recv_some(char *buf, size_t buflen) override;
+
+        ShmSocket(struct addrinfo &info, Operation op);
+        ShmSocket(int fd, sockaddr_storage &info, Operation op);
+
+        public:
+        // The mapping and the eventfds belong to this socket alone
+        ShmSocket(ShmSocket &other)  = delete;
+        ShmSocket(ShmSocket &&other) = delete;
+
+        ~ShmSocket();
+
+        static std::shared_ptr<ShmSocket> connect(std::string path,
+                                                  Operation   op = Operation::Blocking);
+
+        // Every accepted connection gets rings of `capacity` bytes per
+        // direction, rounded up to a power of two
+        static std::shared_ptr<ShmSocket> service(std::string path,
+                                                  Operation   op       = Operation::Blocking,
+                                                  int         backlog  = 100,
+                                                  size_t      capacity = 1024 * 1024);
+
+        std::shared_ptr<ShmSocket> accept(Operation op = Operation::Blocking);
+
+        // Spin on the ring for up to `budget` before a blocking call sleeps
+        void spin(std::chrono::microseconds budget);
+
+        // The same as `spin`, there is no device queue to poll. Always
+        // succeeds, so `Poll::spin` covers shared memory sockets as well.
+        bool busy_poll(std::chrono::microseconds budget, bool prefer = true);
+
+        // Watch only the eventfds of the events asked for, and split the
+        // `POLLIN` of the epoll instance into data or an end to read,
+        // `POLLIN`, and room to write, `POLLOUT`. The end is reported as
+        // `POLLHUP` as well.
+        short interest(short events);
+        short readiness(short revents);
+
+        // The data never passes through the network stack, there is nothing
+        // the kernel could timestamp or pace. `fd()` is an epoll instance,
+        // not a socket.
+        void     timestamping(bool enable, bool hardware = false) = delete;
+        uint32_t tx_id() const                                    = delete;
+        size_t   tx_timestamps(std::vector<TxTimestamp> &out)     = delete;
+        void     pacing_rate(uint64_t bytes_per_second)           = delete;
+        bool     txtime(clockid_t clock = CLOCK_MONOTONIC)        = delete;
+
+        void   close() override;
+        size_t send(const char *buf, size_t buflen) override;
+        size_t recv(char *buf, size_t buflen) override;
+        using Socket::recv;
+    };
+} // namespace Sockets
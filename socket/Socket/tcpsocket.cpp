@@ -1,10 +1,14 @@
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <linux/errqueue.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -15,6 +19,9 @@ namespace Sockets {
     TCPSocket::TCPSocket(int fd, sockaddr_storage &info, Domain dom, Operation op)
         : Socket(fd, info, dom, Type::Stream, op) { }
 
+    TCPSocket::TCPSocket(Adopt, int fd, const sockaddr_storage &info, Domain dom, Operation op)
+        : Socket(Adopt(), fd, info, dom, Type::Stream, op) { }
+
     TCPSocket::TCPSocket(struct addrinfo &info, Domain dom, Operation op)
         : Socket(info, dom, Type::Stream, op) { }
 
@@ -30,7 +37,10 @@ namespace Sockets {
         if (this->state != State::Instantiated)
             throw std::runtime_error("Cannot connect with a busy socket");
 
-        if (::connect(this->_fd, (struct sockaddr *)&this->addr, sizeof(this->addr)) < 0) {
+        // A non-blocking socket finishes connecting in the background and
+        // reports the outcome once it becomes writable
+        if (::connect(this->_fd, (struct sockaddr *)&this->addr, sizeof(this->addr)) < 0 &&
+            (this->operation == Operation::Blocking || errno != EINPROGRESS)) {
             perror("TCPSocket::connect()");
             throw std::runtime_error("Error when trying to connect to destination");
         }
@@ -55,26 +65,50 @@ namespace Sockets {
         this->state = State::Open;
     }
 
+    void TCPSocket::fast_open_connect() {
+        int on = 1;
+
+        // Kernels without client support simply connect the regular way
+        if (setsockopt(this->_fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &on, sizeof(on)) < 0 &&
+            errno != ENOPROTOOPT && errno != EOPNOTSUPP) {
+            perror("TCPSocket::fast_open_connect()");
+            throw std::runtime_error("Error when enabling fast open");
+        }
+    }
+
+    void TCPSocket::fast_open_listen(int queue) {
+        if (setsockopt(this->_fd, IPPROTO_TCP, TCP_FASTOPEN, &queue, sizeof(queue)) < 0) {
+            perror("TCPSocket::fast_open_listen(int)");
+            throw std::runtime_error("Error when enabling fast open");
+        }
+    }
+
     std::shared_ptr<TCPSocket> TCPSocket::connect(std::string address, uint16_t port, Domain dom,
-                                                  Operation op) {
+                                                  Operation op, bool fast_open) {
         auto addr = resolve(address, port, dom, Type::Stream);
 
         std::shared_ptr<TCPSocket> sock = std::make_shared<TCPSocket>(TCPSocket(*addr, dom, op));
 
         freeaddrinfo(addr);
 
+        if (fast_open)
+            sock->fast_open_connect();
+
         sock->connect();
         return sock;
     }
 
     std::shared_ptr<TCPSocket> TCPSocket::service(std::string address, uint16_t port, Domain dom,
-                                                  Operation op, int backlog) {
+                                                  Operation op, int backlog, int fast_open) {
         auto addr = resolve(address, port, dom, Type::Stream);
 
         std::shared_ptr<TCPSocket> sock = std::make_shared<TCPSocket>(TCPSocket(*addr, dom, op));
 
         freeaddrinfo(addr);
 
+        if (fast_open > 0)
+            sock->fast_open_listen(fast_open);
+
         sock->service(backlog);
         return sock;
     }
@@ -82,7 +116,7 @@ namespace Sockets {
     std::shared_ptr<TCPSocket> TCPSocket::accept(Operation op, int flag) {
         int              fd;
         sockaddr_storage info;
-        socklen_t        len = sizeof(struct sockaddr_in);
+        socklen_t        len = sizeof(info);
 
         if (this->state != State::Open)
             throw std::runtime_error("Cannot accept connection on a socket that is not open");
@@ -95,20 +129,89 @@ namespace Sockets {
             throw std::runtime_error("Error on accepting connection");
         }
 
-        std::shared_ptr<TCPSocket> out =
-            std::make_shared<TCPSocket>(TCPSocket(fd, addr, this->domain, op));
+        std::shared_ptr<TCPSocket> out;
 
-        out->state = State::Connected;
+        try {
+            out.reset(new TCPSocket(Adopt(), fd, info, this->domain, op));
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
 
-        // Close the accepted file descriptor if it has been duplicated in the
-        // constructor
-        if (fd != out->fd())
-            if (::close(fd) != 0 && errno != ENOTCONN)
-                perror("Non-fatal error when closing file descriptor");
+        out->state = State::Connected;
 
         return out;
     }
 
+    int TCPSocket::accept_one(sockaddr_storage &info, int flag, bool first) {
+        int       fd;
+        socklen_t len = sizeof(info);
+
+        // Only the first accept on a blocking listener may wait
+        if (!first && this->operation == Operation::Blocking) {
+            pollfd pending = {this->_fd, POLLIN, 0};
+
+            if (::poll(&pending, 1, 0) <= 0)
+                return -1;
+        }
+
+        while ((fd = ::accept4(this->_fd, (struct sockaddr *)&info, &len, flag)) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return -1;
+
+            // The peer gave up while the connection was queued
+            if (errno == ECONNABORTED || errno == EINTR) {
+                len = sizeof(info);
+                continue;
+            }
+
+            // Out of descriptors, the caller keeps what it accepted so far
+            if (!first && (errno == EMFILE || errno == ENFILE))
+                return -1;
+
+            perror("TCPSocket::accept_one(sockaddr_storage &, int, bool)");
+            throw std::runtime_error("Error on accepting connection");
+        }
+
+        return fd;
+    }
+
+    size_t TCPSocket::accept_batch(std::vector<std::shared_ptr<TCPSocket>> &out, size_t max,
+                                   Operation op, int flag) {
+        size_t n = 0;
+
+        if (this->state != State::Open)
+            throw std::runtime_error("Cannot accept connection on a socket that is not open");
+
+        flag |= SOCK_CLOEXEC;
+
+        if (op == Operation::Non_blocking)
+            flag |= SOCK_NONBLOCK;
+
+        while (n < max) {
+            int              fd;
+            sockaddr_storage info;
+
+            if ((fd = this->accept_one(info, flag, n == 0)) == -1)
+                break;
+
+            std::shared_ptr<TCPSocket> sock;
+
+            try {
+                sock.reset(new TCPSocket(Adopt(), fd, info, this->domain, op));
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+
+            sock->state = State::Connected;
+            out.push_back(std::move(sock));
+            n++;
+        }
+
+        return n;
+    }
+
     void TCPSocket::close() { Socket::close(); }
 
     size_t TCPSocket::send(const char *buf, size_t buflen) {
@@ -118,17 +221,21 @@ namespace Sockets {
         std::lock_guard<std::mutex> lock(this->mtx);
 
         do {
-            m = ::send(this->_fd, &buf[n], buflen - n, 0);
+            // A peer which went away is reported as EPIPE, not with SIGPIPE
+            stats_timestamp(start);
+            m = ::send(this->_fd, &buf[n], buflen - n, MSG_NOSIGNAL);
+            stats_record(this->stats.sent, m, buflen - n, start);
 
             if (m < 0) {
                 if (this->operation == Operation::Blocking || errno != EAGAIN)
-                    perror("TCPSocket::recv(char *, size_t)");
+                    perror("TCPSocket::send(const char *, size_t)");
                 break;
             } else if (m == 0) {
                 break;
             }
 
             n += m;
+            this->tx_count += m;
         } while (n < buflen && this->operation == Operation::Blocking);
 
         return n;
@@ -141,7 +248,9 @@ namespace Sockets {
         std::lock_guard<std::mutex> lock(this->mtx);
 
         do {
+            stats_timestamp(start);
             m = ::recv(this->_fd, &buf[n], buflen - n, 0);
+            stats_record(this->stats.received, m, buflen - n, start);
 
             if (m < 0) {
                 if (this->operation == Operation::Blocking || errno != EAGAIN)
@@ -156,4 +265,129 @@ namespace Sockets {
 
         return n;
     }
+
+    size_t TCPSocket::recv_some(char *buf, size_t buflen) {
+        ssize_t m = 0;
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        stats_timestamp(start);
+        m = ::recv(this->_fd, buf, buflen, 0);
+        stats_record(this->stats.received, m, buflen, start);
+
+        if (m < 0) {
+            if (this->operation == Operation::Blocking || errno != EAGAIN)
+                perror("TCPSocket::recv_some(char *, size_t)");
+            return 0;
+        }
+
+        // Tell an orderly shutdown apart from an empty non-blocking socket
+        if (m == 0)
+            errno = 0;
+
+        return m;
+    }
+
+    size_t TCPSocket::recv(char *buf, size_t buflen, Timestamp &ts) {
+        ssize_t m = 0;
+
+        struct iovec  iov = {buf, buflen};
+        struct msghdr msg = {};
+
+        union {
+            char           buf[CMSG_SPACE(sizeof(struct scm_timestamping))];
+            struct cmsghdr align;
+        } control;
+
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        stats_timestamp(start);
+        m = ::recvmsg(this->_fd, &msg, 0);
+        stats_record(this->stats.received, m, buflen, start);
+
+        if (m < 0) {
+            if (this->operation == Operation::Blocking || errno != EAGAIN)
+                perror("TCPSocket::recv(char *, size_t, Timestamp &)");
+            return 0;
+        }
+
+        if (m == 0)
+            errno = 0;
+
+        read_timestamp(msg, ts);
+
+        return m;
+    }
+
+    bool TCPSocket::fast_opened() {
+        struct tcp_info info;
+        socklen_t       len = sizeof(info);
+
+        if (getsockopt(this->_fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0) {
+            perror("TCPSocket::fast_opened()");
+            throw std::runtime_error("Error when reading connection info");
+        }
+
+        return info.tcpi_options & TCPI_OPT_SYN_DATA;
+    }
+
+    size_t TCPSocket::sendv(const struct iovec *iov, int iovcnt) {
+        size_t  n     = 0;
+        size_t  total = 0;
+        ssize_t m     = 0;
+
+        struct msghdr             msg = {};
+        std::vector<struct iovec> rest;
+
+        for (int i = 0; i < iovcnt; i++)
+            total += iov[i].iov_len;
+
+        msg.msg_iov    = const_cast<struct iovec *>(iov);
+        msg.msg_iovlen = iovcnt;
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        do {
+            stats_timestamp(start);
+            m = ::sendmsg(this->_fd, &msg, MSG_NOSIGNAL);
+            stats_record(this->stats.sent, m, total - n, start);
+
+            if (m < 0) {
+                if (this->operation == Operation::Blocking || errno != EAGAIN)
+                    perror("TCPSocket::sendv(const iovec *, int)");
+                break;
+            } else if (m == 0) {
+                break;
+            }
+
+            n += m;
+            this->tx_count += m;
+
+            if (n < total && this->operation == Operation::Blocking) {
+                // Only copy the vector once the kernel took part of it
+                if (rest.empty()) {
+                    rest.assign(iov, iov + iovcnt);
+                    msg.msg_iov = rest.data();
+                }
+
+                size_t skip = m;
+
+                while (skip >= msg.msg_iov->iov_len) {
+                    skip -= msg.msg_iov->iov_len;
+                    msg.msg_iov++;
+                    msg.msg_iovlen--;
+                }
+
+                msg.msg_iov->iov_base = static_cast<char *>(msg.msg_iov->iov_base) + skip;
+                msg.msg_iov->iov_len -= skip;
+            }
+        } while (n < total && this->operation == Operation::Blocking);
+
+        return n;
+    }
 } // namespace Sockets
@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
+#include <sched.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -13,6 +17,53 @@
 
 namespace Sockets {
 
+    namespace {
+        // With `SSL_MODE_ASYNC` an engine may pause the handshake or a record
+        // operation. Waits until the paused job can make progress and returns
+        // whether the call should be repeated.
+        bool resume_async(SSL *ssl, int err) {
+            if (err == SSL_ERROR_WANT_ASYNC_JOB) {
+                sched_yield();
+                return true;
+            }
+
+            if (err != SSL_ERROR_WANT_ASYNC)
+                return false;
+
+            size_t n = 0;
+
+            if (SSL_get_all_async_fds(ssl, NULL, &n) == 0 || n == 0)
+                return true;
+
+            std::vector<OSSL_ASYNC_FD> fds(n);
+            std::vector<struct pollfd> pfds(n);
+
+            SSL_get_all_async_fds(ssl, fds.data(), &n);
+
+            for (size_t i = 0; i < n; i++)
+                pfds[i] = {fds[i], POLLIN, 0};
+
+            while (::poll(pfds.data(), n, -1) < 0) {
+                if (errno != EINTR) {
+                    perror("TLSSocket::resume_async(SSL *, int)");
+                    throw std::runtime_error("Error when waiting for async job");
+                }
+            }
+
+            return true;
+        }
+
+        // Small records fit a 1460 byte segment along with the record
+        // overhead and TCP options. Records grow after `boost_after` bytes
+        // and shrink again once the connection has been idle for `idle_ns`.
+        const size_t   small_record = 1400;
+        const uint64_t boost_after  = 1 << 20;
+        const uint64_t idle_ns      = 1000000000;
+
+        // Bytes a non-blocking socket buffers before it stops accepting sends
+        const size_t coalesce_limit = 4 * SSL3_RT_MAX_PLAIN_LENGTH;
+    } // namespace
+
     TLSSocket::TLSSocket(TCPSocket &tcp, SSL_CTX *ctx) : TCPSocket(tcp) {
         if ((this->ssl = SSL_new(ctx)) == NULL) {
             throw std::runtime_error("Error when creating SSL state");
@@ -65,11 +116,27 @@ namespace Sockets {
         if (this->state != State::Instantiated)
             throw std::runtime_error("Cannot connect with a busy socket");
 
+        Operation op = this->operation;
+
+        // As with `upgrade` the handshake runs to completion, a non-blocking
+        // socket only turns non-blocking once it is done
+        if (op == Operation::Non_blocking) {
+            if (fcntl(this->_fd, F_SETFL, fcntl(this->_fd, F_GETFL, 0) & ~O_NONBLOCK) == -1) {
+                perror("TLSSocket::connect()");
+                throw std::runtime_error("Error when making socket blocking");
+            }
+            this->operation = Operation::Blocking;
+        }
+
         TCPSocket::connect();
 
         // Start handshaking process
-        if ((m = SSL_connect(this->ssl)) != 1)
-            throw_ssl_error(SSL_get_error(this->ssl, m));
+        while ((m = SSL_connect(this->ssl)) != 1) {
+            int err = SSL_get_error(this->ssl, m);
+
+            if (!resume_async(this->ssl, err))
+                throw_ssl_error(err);
+        }
 
         // Check if the socket received a certificate
         X509 *cert = SSL_get_peer_certificate(this->ssl);
@@ -82,28 +149,47 @@ namespace Sockets {
         // Verify the received certificate
         if (SSL_get_verify_result(this->ssl) != X509_V_OK)
             throw std::runtime_error("Failed to verify received certificate");
+
+        if (op == Operation::Non_blocking) {
+            if (fcntl(this->_fd, F_SETFL, fcntl(this->_fd, F_GETFL, 0) | O_NONBLOCK) == -1) {
+                perror("TLSSocket::connect()");
+                throw std::runtime_error("Error when making socket non-blocking");
+            }
+            this->operation = op;
+        }
     }
 
     void TLSSocket::service(int backlog) { TCPSocket::service(backlog); }
 
     std::shared_ptr<TLSSocket> TLSSocket::connect(std::string address, uint16_t port, Domain dom,
-                                                  SSL_CTX *ctx, Operation op) {
+                                                  SSL_CTX *ctx, Operation op, bool fast_open) {
         auto      addr = resolve(address, port, dom, Type::Stream);
         TCPSocket tcp(*addr, dom, op);
 
+        freeaddrinfo(addr);
+
         std::shared_ptr<TLSSocket> out(new TLSSocket(tcp, ctx));
 
+        if (fast_open)
+            out->fast_open_connect();
+
         out->connect();
 
         return out;
     }
     std::shared_ptr<TLSSocket> TLSSocket::service(std::string address, uint16_t port, Domain dom,
-                                                  SSL_CTX *ctx, Operation op, int backlog) {
+                                                  SSL_CTX *ctx, Operation op, int backlog,
+                                                  int fast_open) {
         auto addr = resolve(address, port, dom, Type::Stream);
         auto tcp  = TCPSocket(*addr, dom, op);
 
+        freeaddrinfo(addr);
+
         std::shared_ptr<TLSSocket> out(new TLSSocket(tcp, ctx));
 
+        if (fast_open > 0)
+            out->fast_open_listen(fast_open);
+
         out->service(backlog);
 
         return out;
@@ -113,16 +199,32 @@ namespace Sockets {
         std::shared_ptr<TCPSocket> tcp =
             TCPSocket::accept(Operation::Blocking, flag & ~SOCK_NONBLOCK);
 
-        std::shared_ptr<TLSSocket> out(new TLSSocket(*tcp, ctx));
+        return TLSSocket::upgrade(*tcp, ctx, op);
+    }
+
+    std::shared_ptr<TLSSocket> TLSSocket::upgrade(TCPSocket &conn, SSL_CTX *ctx, Operation op) {
+        std::shared_ptr<TLSSocket> out(new TLSSocket(conn, ctx));
 
         int m = 0;
 
-        if ((m = SSL_accept(out->ssl)) <= 0)
-            throw_ssl_error(SSL_get_error(this->ssl, m));
+        // The handshake runs to completion, whatever the socket was before
+        if (fcntl(out->_fd, F_SETFL, fcntl(out->_fd, F_GETFL, 0) & ~O_NONBLOCK) == -1) {
+            perror("TLSSocket::upgrade(TCPSocket &, SSL_CTX *, Operation)");
+            throw std::runtime_error("Error when making socket blocking");
+        }
+
+        out->operation = Operation::Blocking;
+
+        while ((m = SSL_accept(out->ssl)) <= 0) {
+            int err = SSL_get_error(out->ssl, m);
+
+            if (!resume_async(out->ssl, err))
+                throw_ssl_error(err);
+        }
 
         if (op == Operation::Non_blocking) {
             if (fcntl(out->_fd, F_SETFL, fcntl(out->_fd, F_GETFL, 0) | O_NONBLOCK) == -1) {
-                perror("TLSSocket::accept(SSL_CTX*, Operation, int)");
+                perror("TLSSocket::upgrade(TCPSocket &, SSL_CTX *, Operation)");
                 throw std::runtime_error("Error when making socket non-blocking");
             }
             out->operation = op;
@@ -131,6 +233,19 @@ namespace Sockets {
         return out;
     }
 
+    std::vector<int> TLSSocket::async_fds() {
+        size_t n = 0;
+
+        if (SSL_get_all_async_fds(this->ssl, NULL, &n) == 0 || n == 0)
+            return {};
+
+        std::vector<OSSL_ASYNC_FD> fds(n);
+
+        SSL_get_all_async_fds(this->ssl, fds.data(), &n);
+
+        return std::vector<int>(fds.begin(), fds.begin() + n);
+    }
+
     void TLSSocket::close() {
         int m;
 
@@ -143,9 +258,17 @@ namespace Sockets {
                 throw std::runtime_error("Error when making socket blocking");
             }
 
-            if ((m = SSL_shutdown(this->ssl)) == 0) {
-            } else if (m < 0)
-                throw_ssl_error(SSL_get_error(this->ssl, m));
+            if (!this->out.empty()) {
+                std::lock_guard<std::mutex> lock(this->mtx);
+                this->drain(true);
+            }
+
+            while ((m = SSL_shutdown(this->ssl)) < 0) {
+                int err = SSL_get_error(this->ssl, m);
+
+                if (!resume_async(this->ssl, err))
+                    throw_ssl_error(err);
+            }
         }
 
         TCPSocket::close();
@@ -157,16 +280,41 @@ namespace Sockets {
 
         std::lock_guard<std::mutex> lock(this->mtx);
 
+        if (this->coalescing) {
+            this->drain(false);
+
+            // Blocking sockets always drain down to a partial record, a
+            // non-blocking one only takes what fits below the limit
+            if (this->operation == Operation::Non_blocking)
+                buflen =
+                    std::min(buflen, coalesce_limit - std::min(coalesce_limit, this->out.size()));
+
+            this->out.insert(this->out.end(), buf, buf + buflen);
+            this->drain(false);
+
+            return buflen;
+        }
+
         do {
+            stats_timestamp(start);
             m = SSL_write(this->ssl, &buf[n], buflen - n);
 
             if (m <= 0) {
+                int err = SSL_get_error(this->ssl, m);
+
+                stats_record(this->stats.sent, -1, buflen - n, start,
+                             err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ||
+                                 err == SSL_ERROR_WANT_ASYNC);
+
+                if (this->operation == Operation::Blocking && resume_async(this->ssl, err))
+                    continue;
+
                 // If the socket is blocking then a serious error happened
                 // If the socket is non-blocking then see if the error is `SSL_ERROR_WANT_READ` or
                 // `SSL_ERROR_WANT_WRITE` If so, call `SSL_write` with the exact same parameters
 
                 try {
-                    throw_ssl_error(SSL_get_error(this->ssl, m));
+                    throw_ssl_error(err);
                 } catch (const ssl_error_want_read &e) {
                     if (this->operation == Operation::Blocking)
                         throw;
@@ -177,9 +325,14 @@ namespace Sockets {
                         throw;
 
                     continue;
+                } catch (const ssl_error_want_async &e) {
+                    // The paused job is resumed by repeating the call once
+                    // one of `async_fds` is readable
+                    continue;
                 }
             }
 
+            stats_record(this->stats.sent, m, buflen - n, start, false);
             n += m;
         } while (n < buflen && this->operation == Operation::Blocking);
 
@@ -195,15 +348,25 @@ namespace Sockets {
         std::lock_guard<std::mutex> lock(this->mtx);
 
         do {
+            stats_timestamp(start);
             m = SSL_read(this->ssl, &buf[n], buflen - n);
 
             if (m <= 0) {
+                int err = SSL_get_error(this->ssl, m);
+
+                stats_record(this->stats.received, -1, buflen - n, start,
+                             err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ||
+                                 err == SSL_ERROR_WANT_ASYNC);
+
+                if (this->operation == Operation::Blocking && resume_async(this->ssl, err))
+                    continue;
+
                 // If the socket is blocking then a serious error happened
                 // If the socket is non-blocking then see if the error is `SSL_ERROR_WANT_READ` or
                 // `SSL_ERROR_WANT_WRITE` If so, call `SSL_read` with the exact same parameters
 
                 try {
-                    throw_ssl_error(SSL_get_error(this->ssl, m));
+                    throw_ssl_error(err);
                 } catch (const ssl_error_want_read &e) {
                     if (this->operation == Operation::Blocking)
                         throw;
@@ -214,13 +377,169 @@ namespace Sockets {
                         throw;
 
                     continue;
+                } catch (const ssl_error_want_async &e) {
+                    // The paused job is resumed by repeating the call once
+                    // one of `async_fds` is readable
+                    continue;
                 }
             }
 
+            stats_record(this->stats.received, m, buflen - n, start, false);
             n += m;
         } while (n < buflen && this->operation == Operation::Blocking);
 
         return n;
     }
 
-} // namespace Sockets
\ No newline at end of file
+    size_t TLSSocket::recv_some(char *buf, size_t buflen) {
+        ssize_t m = 0;
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        while (true) {
+            stats_timestamp(start);
+            m = SSL_read(this->ssl, buf, buflen);
+
+            if (m > 0) {
+                stats_record(this->stats.received, m, buflen, start, false);
+                return m;
+            }
+
+            int  err     = SSL_get_error(this->ssl, m);
+            bool blocked = err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ||
+                           err == SSL_ERROR_WANT_ASYNC;
+
+            stats_record(this->stats.received, -1, buflen, start, blocked);
+
+            if (this->operation == Operation::Blocking && resume_async(this->ssl, err))
+                continue;
+
+            if (blocked && this->operation == Operation::Non_blocking) {
+                errno = EAGAIN;
+                return 0;
+            }
+
+            throw_ssl_error(err);
+        }
+    }
+
+    size_t TLSSocket::sendv(const struct iovec *iov, int iovcnt) {
+        if (iovcnt == 1 || this->coalescing) {
+            size_t n = 0;
+
+            for (int i = 0; i < iovcnt; i++) {
+                size_t m = this->send(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+
+                n += m;
+
+                if (m < iov[i].iov_len)
+                    break;
+            }
+
+            return n;
+        }
+
+        // Reused between calls so that gathering does not allocate
+        thread_local std::vector<char> gathered;
+
+        gathered.clear();
+
+        for (int i = 0; i < iovcnt; i++)
+            gathered.insert(gathered.end(), static_cast<const char *>(iov[i].iov_base),
+                            static_cast<const char *>(iov[i].iov_base) + iov[i].iov_len);
+
+        // A retried write is gathered again and may land at another address
+        SSL_set_mode(this->ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+        return this->send(gathered.data(), gathered.size());
+    }
+
+    size_t TLSSocket::record_size() {
+        if (now_ns() - this->last_write > idle_ns)
+            this->streamed = 0;
+
+        return this->streamed < boost_after ? small_record : SSL3_RT_MAX_PLAIN_LENGTH;
+    }
+
+    size_t TLSSocket::write_record(const char *buf, size_t len) {
+        while (true) {
+            stats_timestamp(start);
+            int m = SSL_write(this->ssl, buf, len);
+
+            if (m > 0) {
+                stats_record(this->stats.sent, m, len, start, false);
+
+                this->retry      = 0;
+                this->streamed  += m;
+                this->last_write = now_ns();
+
+                return m;
+            }
+
+            int  err     = SSL_get_error(this->ssl, m);
+            bool blocked = err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ||
+                           err == SSL_ERROR_WANT_ASYNC;
+
+            stats_record(this->stats.sent, -1, len, start, blocked);
+
+            if (this->operation == Operation::Blocking && resume_async(this->ssl, err))
+                continue;
+
+            // OpenSSL expects the same write again, whatever is buffered by then
+            if (blocked && this->operation == Operation::Non_blocking) {
+                this->retry = len;
+                errno       = EAGAIN;
+                return 0;
+            }
+
+            throw_ssl_error(err);
+        }
+    }
+
+    void TLSSocket::drain(bool all) {
+        size_t n = 0;
+
+        while (n < this->out.size()) {
+            size_t left   = this->out.size() - n;
+            size_t record = this->record_size();
+
+            // A partial record waits for more data unless it is flushed
+            if (!this->retry && !all && left < record)
+                break;
+
+            size_t len = this->retry ? this->retry : std::min(left, record);
+            size_t m   = this->write_record(&this->out[n], len);
+
+            if (m == 0)
+                break;
+
+            n += m;
+        }
+
+        this->out.erase(this->out.begin(), this->out.begin() + n);
+    }
+
+    void TLSSocket::coalesce(bool enable) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        if (enable) {
+            // Retried records are written from wherever the buffer is by then
+            SSL_set_mode(this->ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        } else {
+            this->drain(true);
+
+            if (!this->out.empty())
+                throw std::runtime_error("Cannot stop coalescing before the buffer is flushed");
+        }
+
+        this->coalescing = enable;
+    }
+
+    size_t TLSSocket::flush() {
+        std::lock_guard<std::mutex> lock(this->mtx);
+
+        this->drain(true);
+
+        return this->out.size();
+    }
+} // namespace Sockets
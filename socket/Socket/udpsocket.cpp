@@ -4,7 +4,10 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
+#include <net/if.h>
 #include <netdb.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -45,10 +48,7 @@ namespace Sockets {
             throw std::runtime_error("Error when binding socket to address");
         }
 
-        if (listen(this->_fd, backlog)) {
-            perror("UDPSocket::service(int)");
-            throw std::runtime_error("Error when trying to listen on socket");
-        }
+        // Datagram sockets have no notion of a listen queue so `backlog` is unused
     }
 
     /* std::shared_ptr<UDPSocket> UDPSocket::accept(Operation op, int flag) {
@@ -90,14 +90,19 @@ namespace Sockets {
         ssize_t                     m = 0;
 
         while (n < buflen) {
-            if ((m = ::sendto(this->_fd, &buf[n], buflen - n, 0, (struct sockaddr *)&this->addr,
-                              this->addr.ss_family == static_cast<int>(Domain::IPv4)
-                                  ? sizeof(struct sockaddr_in)
-                                  : sizeof(struct sockaddr_in6))) < 0) {
+            stats_timestamp(start);
+            m = ::sendto(this->_fd, &buf[n], buflen - n, 0, (struct sockaddr *)&this->addr,
+                         this->addr.ss_family == static_cast<int>(Domain::IPv4)
+                             ? sizeof(struct sockaddr_in)
+                             : sizeof(struct sockaddr_in6));
+            stats_record(this->stats.sent, m, buflen - n, start);
+
+            if (m < 0) {
                 perror("UDPSocket::send(const char *, size_t)");
                 throw std::runtime_error("Error when sending data");
             }
             n += m;
+            this->tx_count++;
         }
 
         return n;
@@ -108,11 +113,14 @@ namespace Sockets {
         size_t                      n = 0;
         ssize_t                     m = 0;
 
-        socklen_t len = 0;
+        socklen_t len = sizeof(this->addr);
 
         while (n < buflen) {
-            if ((m = ::recvfrom(this->_fd, &buf[n], buflen - n, 0, (struct sockaddr *)&this->addr,
-                                &len)) < 0) {
+            stats_timestamp(start);
+            m = ::recvfrom(this->_fd, &buf[n], buflen - n, 0, (struct sockaddr *)&this->addr, &len);
+            stats_record(this->stats.received, m, buflen - n, start);
+
+            if (m < 0) {
                 perror("UDPSocket::recv(char *, size_t)");
                 throw std::runtime_error("Error when receiving data");
             }
@@ -121,4 +129,418 @@ namespace Sockets {
 
         return n;
     }
+
+    size_t UDPSocket::recv_some(char *buf, size_t buflen) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        ssize_t                     m = 0;
+
+        socklen_t len = sizeof(this->addr);
+
+        // Exactly one datagram, anything beyond `buflen` is discarded
+        stats_timestamp(start);
+        m = ::recvfrom(this->_fd, buf, buflen, 0, (struct sockaddr *)&this->addr, &len);
+        stats_record(this->stats.received, m, buflen, start);
+
+        if (m < 0) {
+            if (this->operation == Operation::Non_blocking &&
+                (errno == EAGAIN || errno == EWOULDBLOCK))
+                return 0;
+
+            perror("UDPSocket::recv_some(char *, size_t)");
+            throw std::runtime_error("Error when receiving data");
+        }
+
+        return m;
+    }
+
+    size_t UDPSocket::recv_from(char *buf, size_t buflen, Peer &peer) {
+        return this->receive(buf, buflen, peer, nullptr);
+    }
+
+    size_t UDPSocket::recv_from(char *buf, size_t buflen, Peer &peer, Timestamp &ts) {
+        return this->receive(buf, buflen, peer, &ts);
+    }
+
+    size_t UDPSocket::receive(char *buf, size_t buflen, Peer &peer, Timestamp *ts) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        ssize_t                     m = 0;
+
+        struct iovec  iov = {buf, buflen};
+        struct msghdr msg = {};
+
+        // Room for the drop counter and timestamps, only asked for when they
+        // are wanted
+        union {
+            char buf[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct scm_timestamping))];
+            struct cmsghdr align;
+        } control;
+
+        msg.msg_name    = &peer.addr;
+        msg.msg_namelen = sizeof(peer.addr);
+        msg.msg_iov     = &iov;
+        msg.msg_iovlen  = 1;
+
+        if (this->overflow || ts) {
+            msg.msg_control    = control.buf;
+            msg.msg_controllen = sizeof(control.buf);
+        }
+
+        stats_timestamp(start);
+        m = ::recvmsg(this->_fd, &msg, 0);
+        stats_record(this->stats.received, m, buflen, start);
+
+        if (m < 0) {
+            if (this->operation == Operation::Non_blocking &&
+                (errno == EAGAIN || errno == EWOULDBLOCK))
+                return 0;
+
+            perror("UDPSocket::receive(char *, size_t, Peer &, Timestamp *)");
+            throw std::runtime_error("Error when receiving data");
+        }
+
+        peer.len = msg.msg_namelen;
+
+        // The rest of the datagram is gone, let the caller know rather than
+        // hand it a message which looks complete
+        if (msg.msg_flags & MSG_TRUNC) {
+            this->truncations++;
+            errno = EMSGSIZE;
+        } else {
+            errno = 0;
+        }
+
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL)
+                std::memcpy(&this->drops, CMSG_DATA(c), sizeof(this->drops));
+
+        if (ts)
+            read_timestamp(msg, *ts);
+
+        return m;
+    }
+
+    size_t UDPSocket::send_to(const char *buf, size_t buflen, const Peer &peer) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        ssize_t                     m = 0;
+
+        stats_timestamp(start);
+        m = ::sendto(this->_fd, buf, buflen, 0, (const struct sockaddr *)&peer.addr, peer.len);
+        stats_record(this->stats.sent, m, buflen, start);
+
+        if (m < 0) {
+            if (this->operation == Operation::Non_blocking &&
+                (errno == EAGAIN || errno == EWOULDBLOCK))
+                return 0;
+
+            perror("UDPSocket::send_to(const char *, size_t, const Peer &)");
+            throw std::runtime_error("Error when sending data");
+        }
+
+        this->tx_count++;
+
+        return m;
+    }
+
+    size_t UDPSocket::send_at(const char *buf, size_t buflen, uint64_t at) {
+#ifdef SCM_TXTIME
+        struct iovec  iov = {const_cast<char *>(buf), buflen};
+        struct msghdr msg = {};
+
+        union {
+            char           buf[CMSG_SPACE(sizeof(uint64_t))];
+            struct cmsghdr align;
+        } control;
+
+        std::memset(&control, 0, sizeof(control));
+
+        msg.msg_name       = &this->addr;
+        msg.msg_namelen    = this->addr.ss_family == static_cast<int>(Domain::IPv4)
+                                 ? sizeof(struct sockaddr_in)
+                                 : sizeof(struct sockaddr_in6);
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type  = SCM_TXTIME;
+        c->cmsg_len   = CMSG_LEN(sizeof(uint64_t));
+
+        // `now_ns` runs on the monotonic clock, shift `at` by how far the
+        // qdisc's clock is ahead of it
+        if (this->tx_clock != CLOCK_MONOTONIC) {
+            struct timespec ts;
+
+            clock_gettime(this->tx_clock, &ts);
+            at = at - now_ns() + ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+
+        std::memcpy(CMSG_DATA(c), &at, sizeof(at));
+
+        std::lock_guard<std::mutex> lock(this->mtx);
+        ssize_t                     m = 0;
+
+        stats_timestamp(start);
+        m = ::sendmsg(this->_fd, &msg, 0);
+        stats_record(this->stats.sent, m, buflen, start);
+
+        if (m < 0) {
+            if (this->operation == Operation::Non_blocking &&
+                (errno == EAGAIN || errno == EWOULDBLOCK))
+                return 0;
+
+            perror("UDPSocket::send_at(const char *, size_t, uint64_t)");
+            throw std::runtime_error("Error when sending data");
+        }
+
+        this->tx_count++;
+
+        return m;
+#else
+        (void)at;
+        return this->send(buf, buflen);
+#endif
+    }
+
+    std::shared_ptr<UDPSocket> UDPSocket::subscribe(std::string group, uint16_t port, Domain dom,
+                                                    Operation op, std::string interface) {
+        auto addr = resolve(group, port, dom, Type::Datagram, AI_NUMERICHOST);
+
+        std::shared_ptr<UDPSocket> sock = std::make_shared<UDPSocket>(UDPSocket(*addr, dom, op));
+
+        freeaddrinfo(addr);
+
+        int one = 1;
+
+        if (setsockopt(sock->_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+            setsockopt(sock->_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+            perror("UDPSocket::subscribe(std::string, uint16_t, Domain, Operation, std::string)");
+            throw std::runtime_error("Error when allowing the port to be shared");
+        }
+
+        // Bound to the group rather than the wildcard address, so that other
+        // groups on the same port are not delivered here
+        sock->service(0);
+        sock->state = State::Open;
+
+        sock->join(group, interface);
+
+        return sock;
+    }
+
+    void UDPSocket::membership(int option, const std::string &group, const std::string &source,
+                               const std::string &interface) {
+        std::string      grp = group;
+        std::string      src = source;
+        struct addrinfo *addr;
+        unsigned int     idx = 0;
+
+        if (!interface.empty() && (idx = if_nametoindex(interface.c_str())) == 0) {
+            perror("UDPSocket::membership(int, const std::string &, const std::string &, "
+                   "const std::string &)");
+            throw std::runtime_error("Unknown network interface " + interface);
+        }
+
+        // The protocol independent requests take the same form for IPv4 and
+        // IPv6, only the level differs
+        int level = this->addr.ss_family == AF_INET6 ? IPPROTO_IPV6 : IPPROTO_IP;
+        int err   = 0;
+
+        addr = resolve(grp, 0, this->domain, Type::Datagram, AI_NUMERICHOST);
+
+        if (src.empty()) {
+            struct group_req req = {};
+
+            req.gr_interface = idx;
+            std::memcpy(&req.gr_group, addr->ai_addr, addr->ai_addrlen);
+            freeaddrinfo(addr);
+
+            err = setsockopt(this->_fd, level, option, &req, sizeof(req));
+        } else {
+            struct group_source_req req = {};
+
+            req.gsr_interface = idx;
+            std::memcpy(&req.gsr_group, addr->ai_addr, addr->ai_addrlen);
+            freeaddrinfo(addr);
+
+            addr = resolve(src, 0, this->domain, Type::Datagram, AI_NUMERICHOST);
+            std::memcpy(&req.gsr_source, addr->ai_addr, addr->ai_addrlen);
+            freeaddrinfo(addr);
+
+            err = setsockopt(this->_fd, level, option, &req, sizeof(req));
+        }
+
+        if (err < 0) {
+            perror("UDPSocket::membership(int, const std::string &, const std::string &, "
+                   "const std::string &)");
+            throw std::runtime_error("Error when changing membership of group " + group);
+        }
+
+        // Linux otherwise delivers every group any socket on the host joined
+        // as long as address and port match, leaving made no difference then
+        if (option == MCAST_JOIN_GROUP || option == MCAST_JOIN_SOURCE_GROUP) {
+            int off = 0;
+
+            if (level == IPPROTO_IP)
+                setsockopt(this->_fd, IPPROTO_IP, IP_MULTICAST_ALL, &off, sizeof(off));
+#ifdef IPV6_MULTICAST_ALL
+            else
+                setsockopt(this->_fd, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &off, sizeof(off));
+#endif
+        }
+    }
+
+    void UDPSocket::join(const std::string &group, const std::string &interface) {
+        this->membership(MCAST_JOIN_GROUP, group, "", interface);
+    }
+
+    void UDPSocket::leave(const std::string &group, const std::string &interface) {
+        this->membership(MCAST_LEAVE_GROUP, group, "", interface);
+    }
+
+    void UDPSocket::join(const std::string &group, const std::string &source,
+                         const std::string &interface) {
+        this->membership(MCAST_JOIN_SOURCE_GROUP, group, source, interface);
+    }
+
+    void UDPSocket::leave(const std::string &group, const std::string &source,
+                          const std::string &interface) {
+        this->membership(MCAST_LEAVE_SOURCE_GROUP, group, source, interface);
+    }
+
+    void UDPSocket::multicast_loop(bool enable) {
+        int  on  = enable;
+        bool six = this->addr.ss_family == AF_INET6;
+
+        if (setsockopt(this->_fd, six ? IPPROTO_IPV6 : IPPROTO_IP,
+                       six ? IPV6_MULTICAST_LOOP : IP_MULTICAST_LOOP, &on, sizeof(on)) < 0) {
+            perror("UDPSocket::multicast_loop(bool)");
+            throw std::runtime_error("Error when setting multicast loopback");
+        }
+    }
+
+    void UDPSocket::multicast_ttl(int hops) {
+        bool six = this->addr.ss_family == AF_INET6;
+
+        if (setsockopt(this->_fd, six ? IPPROTO_IPV6 : IPPROTO_IP,
+                       six ? IPV6_MULTICAST_HOPS : IP_MULTICAST_TTL, &hops, sizeof(hops)) < 0) {
+            perror("UDPSocket::multicast_ttl(int)");
+            throw std::runtime_error("Error when setting multicast TTL");
+        }
+    }
+
+    void UDPSocket::multicast_interface(const std::string &interface) {
+        int idx = if_nametoindex(interface.c_str());
+        int err = 0;
+
+        if (idx == 0) {
+            perror("UDPSocket::multicast_interface(const std::string &)");
+            throw std::runtime_error("Unknown network interface " + interface);
+        }
+
+        if (this->addr.ss_family == AF_INET6) {
+            err = setsockopt(this->_fd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &idx, sizeof(idx));
+        } else {
+            struct ip_mreqn req = {};
+
+            req.imr_ifindex = idx;
+            err = setsockopt(this->_fd, IPPROTO_IP, IP_MULTICAST_IF, &req, sizeof(req));
+        }
+
+        if (err < 0) {
+            perror("UDPSocket::multicast_interface(const std::string &)");
+            throw std::runtime_error("Error when selecting multicast interface");
+        }
+    }
+
+    size_t UDPSocket::receive_buffer(size_t bytes) {
+        int       size = bytes > INT32_MAX / 2 ? INT32_MAX / 2 : bytes;
+        socklen_t len  = sizeof(size);
+
+        // The forced variant ignores `rmem_max` but needs privileges
+        if (setsockopt(this->_fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0 &&
+            setsockopt(this->_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+            perror("UDPSocket::receive_buffer(size_t)");
+            throw std::runtime_error("Error when resizing receive buffer");
+        }
+
+        if (getsockopt(this->_fd, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0) {
+            perror("UDPSocket::receive_buffer(size_t)");
+            throw std::runtime_error("Error when reading receive buffer size");
+        }
+
+        return size;
+    }
+
+    void UDPSocket::count_drops(bool enable) {
+        int on = enable;
+
+        if (setsockopt(this->_fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+            perror("UDPSocket::count_drops(bool)");
+            throw std::runtime_error("Error when enabling drop counter");
+        }
+
+        this->overflow = enable;
+    }
+
+    bool Peer::operator==(const Peer &other) const {
+        if (this->addr.ss_family != other.addr.ss_family)
+            return false;
+
+        switch (this->addr.ss_family) {
+        case AF_INET: {
+            auto a = reinterpret_cast<const sockaddr_in *>(&this->addr);
+            auto b = reinterpret_cast<const sockaddr_in *>(&other.addr);
+
+            return a->sin_port == b->sin_port && a->sin_addr.s_addr == b->sin_addr.s_addr;
+        }
+        case AF_INET6: {
+            auto a = reinterpret_cast<const sockaddr_in6 *>(&this->addr);
+            auto b = reinterpret_cast<const sockaddr_in6 *>(&other.addr);
+
+            return a->sin6_port == b->sin6_port && a->sin6_scope_id == b->sin6_scope_id &&
+                   memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr)) == 0;
+        }
+        default:
+            return this->len == other.len && memcmp(&this->addr, &other.addr, this->len) == 0;
+        }
+    }
+
+    size_t Peer::hash() const {
+        uint64_t h = this->addr.ss_family;
+
+        // Folds the address into 64 bits and finishes with the mixer from
+        // MurmurHash3 so that neighbouring ports and addresses spread out
+        switch (this->addr.ss_family) {
+        case AF_INET: {
+            auto a = reinterpret_cast<const sockaddr_in *>(&this->addr);
+
+            h = (uint64_t)a->sin_addr.s_addr << 16 | a->sin_port;
+            break;
+        }
+        case AF_INET6: {
+            auto     a = reinterpret_cast<const sockaddr_in6 *>(&this->addr);
+            uint64_t w[2];
+
+            memcpy(w, &a->sin6_addr, sizeof(w));
+            h = w[0] ^ (w[1] * 0x9e3779b97f4a7c15ULL) ^ a->sin6_port ^
+                (uint64_t)a->sin6_scope_id << 16;
+            break;
+        }
+        default:
+            for (socklen_t i = 0; i < this->len; i++)
+                h = (h ^ reinterpret_cast<const unsigned char *>(&this->addr)[i]) *
+                    0x100000001b3ULL;
+        }
+
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+
+        return h;
+    }
 } // namespace Sockets
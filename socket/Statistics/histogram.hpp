@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Sockets {
+
+    // Monotonic timestamp in nanoseconds used for every latency measurement in
+    // the library
+    inline uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /**
+     * @brief Bucket layout shared by `Histogram` and `HistogramSnapshot`.
+     * Values below 8 get a bucket each, every power of two above that is split
+     * into 8 linear sub-buckets which bounds the relative error to 12.5%.
+     * Anything above 2^36 (roughly 68 seconds when counting nanoseconds) ends
+     * up in the last bucket.
+     *
+     */
+    struct HistogramLayout {
+        static const unsigned sub_bits     = 3;
+        static const unsigned sub_count    = 1u << sub_bits;
+        static const unsigned max_exponent = 36;
+        static const size_t   size         = sub_count * (max_exponent - sub_bits + 2);
+
+        static size_t index(uint64_t value) {
+            if (value < sub_count)
+                return value;
+
+            unsigned e = 63 - __builtin_clzll(value);
+
+            if (e > max_exponent)
+                return size - 1;
+
+            return (e - sub_bits + 1) * sub_count + ((value >> (e - sub_bits)) & (sub_count - 1));
+        }
+
+        // Smallest value which maps to the bucket
+        static uint64_t lower(size_t idx) {
+            if (idx < sub_count)
+                return idx;
+
+            unsigned e = idx / sub_count + sub_bits - 1;
+            return (uint64_t)(sub_count + idx % sub_count) << (e - sub_bits);
+        }
+
+        // Largest value which maps to the bucket
+        static uint64_t upper(size_t idx) {
+            return idx + 1 < size ? lower(idx + 1) - 1 : UINT64_MAX;
+        }
+    };
+
+    /**
+     * @brief A plain copy of a histogram which can be merged and queried
+     * without touching the live counters.
+     *
+     */
+    class HistogramSnapshot {
+        std::array<uint64_t, HistogramLayout::size> counts;
+
+        uint64_t total = 0;
+        uint64_t sum   = 0;
+
+        friend class Histogram;
+
+        public:
+        HistogramSnapshot() { this->counts.fill(0); }
+
+        HistogramSnapshot &operator+=(const HistogramSnapshot &other) {
+            for (size_t i = 0; i < HistogramLayout::size; i++)
+                this->counts[i] += other.counts[i];
+
+            this->total += other.total;
+            this->sum += other.sum;
+            return *this;
+        }
+
+        uint64_t count() const { return this->total; }
+        uint64_t bucket(size_t idx) const { return this->counts[idx]; }
+
+        double mean() const { return this->total ? (double)this->sum / this->total : 0; }
+
+        // Upper bound of the bucket holding the p-th percentile, p in [0, 100]
+        uint64_t percentile(double p) const {
+            if (this->total == 0)
+                return 0;
+
+            uint64_t rank = static_cast<uint64_t>(p / 100.0 * this->total + 0.5);
+            uint64_t seen = 0;
+
+            if (rank == 0)
+                rank = 1;
+
+            for (size_t i = 0; i < HistogramLayout::size; i++) {
+                seen += this->counts[i];
+
+                if (seen >= rank)
+                    return HistogramLayout::upper(i);
+            }
+
+            return HistogramLayout::upper(HistogramLayout::size - 1);
+        }
+    };
+
+    /**
+     * @brief Log-linear histogram with relaxed atomic counters. `record` may
+     * be called from any thread, `add` is a cheaper variant for callers which
+     * already serialise their writers (for instance behind a socket mutex) and
+     * only need readers on other threads to see untorn values.
+     *
+     */
+    class Histogram {
+        std::array<std::atomic<uint64_t>, HistogramLayout::size> counts;
+
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> sum;
+
+        static void bump(std::atomic<uint64_t> &a, uint64_t v) {
+            a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        }
+
+        public:
+        Histogram() { this->reset(); }
+
+        Histogram(const Histogram &) = delete;
+        Histogram &operator=(const Histogram &) = delete;
+
+        void record(uint64_t value) {
+            this->counts[HistogramLayout::index(value)].fetch_add(1, std::memory_order_relaxed);
+            this->total.fetch_add(1, std::memory_order_relaxed);
+            this->sum.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        void add(uint64_t value) {
+            bump(this->counts[HistogramLayout::index(value)], 1);
+            bump(this->total, 1);
+            bump(this->sum, value);
+        }
+
+        void reset() {
+            for (auto &it : this->counts)
+                it.store(0, std::memory_order_relaxed);
+
+            this->total.store(0, std::memory_order_relaxed);
+            this->sum.store(0, std::memory_order_relaxed);
+        }
+
+        // Add the current counters to `out` without an intermediate copy
+        void accumulate(HistogramSnapshot &out) const {
+            for (size_t i = 0; i < HistogramLayout::size; i++)
+                out.counts[i] += this->counts[i].load(std::memory_order_relaxed);
+
+            out.total += this->total.load(std::memory_order_relaxed);
+            out.sum += this->sum.load(std::memory_order_relaxed);
+        }
+
+        HistogramSnapshot snapshot() const {
+            HistogramSnapshot out;
+            this->accumulate(out);
+            return out;
+        }
+    };
+} // namespace Sockets
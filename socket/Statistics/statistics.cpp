@@ -0,0 +1,125 @@
+#include <mutex>
+
+#include <errno.h>
+
+#include "statistics.hpp"
+
+namespace Sockets {
+
+    namespace {
+        // Registry of every live `IOStatistics` instance
+        std::mutex &registry_mutex() {
+            static std::mutex mtx;
+            return mtx;
+        }
+
+        IOStatistics *&registry_head() {
+            static IOStatistics *head = nullptr;
+            return head;
+        }
+
+        void bump(std::atomic<uint64_t> &a, uint64_t v) {
+            a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        }
+    } // namespace
+
+    IODirectionSnapshot &IODirectionSnapshot::operator+=(const IODirectionSnapshot &other) {
+        this->calls += other.calls;
+        this->bytes += other.bytes;
+        this->would_block += other.would_block;
+        this->partial += other.partial;
+        this->errors += other.errors;
+        this->latency += other.latency;
+        return *this;
+    }
+
+    IOSnapshot &IOSnapshot::operator+=(const IOSnapshot &other) {
+        this->sockets += other.sockets;
+        this->sent += other.sent;
+        this->received += other.received;
+        return *this;
+    }
+
+    IODirection::IODirection() : calls(0), bytes(0), would_block(0), partial(0), errors(0) { }
+
+    void IODirection::record(ssize_t result, size_t requested, uint64_t start) {
+        // `errno` is only meaningful after a failed call, a 0 left over from
+        // an earlier EAGAIN is the end of the stream
+        this->record(result, requested, start,
+                     result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+
+    void IODirection::record(ssize_t result, size_t requested, uint64_t start, bool blocked) {
+        bump(this->calls, 1);
+
+        if (result < 0 || (result == 0 && blocked)) {
+            bump(blocked ? this->would_block : this->errors, 1);
+        } else {
+            bump(this->bytes, result);
+
+            if (static_cast<size_t>(result) < requested)
+                bump(this->partial, 1);
+        }
+
+        this->latency.add(now_ns() - start);
+    }
+
+    void IODirection::accumulate(IODirectionSnapshot &out) const {
+        out.calls += this->calls.load(std::memory_order_relaxed);
+        out.bytes += this->bytes.load(std::memory_order_relaxed);
+        out.would_block += this->would_block.load(std::memory_order_relaxed);
+        out.partial += this->partial.load(std::memory_order_relaxed);
+        out.errors += this->errors.load(std::memory_order_relaxed);
+        this->latency.accumulate(out.latency);
+    }
+
+    IODirectionSnapshot IODirection::snapshot() const {
+        IODirectionSnapshot out;
+        this->accumulate(out);
+        return out;
+    }
+
+    IOStatistics::IOStatistics() {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        IOStatistics *&             head = registry_head();
+
+        this->next = head;
+        if (head)
+            head->prev = this;
+        head = this;
+    }
+
+    IOStatistics::~IOStatistics() {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+
+        if (this->prev)
+            this->prev->next = this->next;
+        else
+            registry_head() = this->next;
+
+        if (this->next)
+            this->next->prev = this->prev;
+    }
+
+    void IOStatistics::accumulate(IOSnapshot &out) const {
+        out.sockets++;
+        this->sent.accumulate(out.sent);
+        this->received.accumulate(out.received);
+    }
+
+    IOSnapshot IOStatistics::snapshot() const {
+        IOSnapshot out;
+        this->accumulate(out);
+        return out;
+    }
+
+    IOSnapshot IOStatistics::aggregate() {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        IOSnapshot                  out;
+
+        for (IOStatistics *it = registry_head(); it; it = it->next)
+            it->accumulate(out);
+
+        return out;
+    }
+} // namespace Sockets
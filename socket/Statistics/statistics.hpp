@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/types.h>
+
+#include "histogram.hpp"
+
+// Instrumentation hooks used by the socket implementations. They expand to
+// nothing unless the library is built with `SOCKETS_STATISTICS` so that the
+// send and receive paths are untouched when statistics are compiled out.
+#ifdef SOCKETS_STATISTICS
+#define stats_timestamp(name)       const uint64_t name = Sockets::now_ns()
+#define stats_record(counters, ...) (counters).record(__VA_ARGS__)
+#else
+#define stats_timestamp(name)
+#define stats_record(counters, ...)
+#endif
+
+namespace Sockets {
+
+    /**
+     * @brief Plain copy of the counters for one direction of a socket.
+     *
+     */
+    struct IODirectionSnapshot {
+        uint64_t calls       = 0;
+        uint64_t bytes       = 0;
+        uint64_t would_block = 0;
+        uint64_t partial     = 0;
+        uint64_t errors      = 0;
+
+        // Time spent inside the send or receive call, in nanoseconds
+        HistogramSnapshot latency;
+
+        IODirectionSnapshot &operator+=(const IODirectionSnapshot &other);
+    };
+
+    struct IOSnapshot {
+        size_t              sockets = 0;
+        IODirectionSnapshot sent;
+        IODirectionSnapshot received;
+
+        IOSnapshot &operator+=(const IOSnapshot &other);
+    };
+
+    /**
+     * @brief Counters for one direction of a socket. Every update happens
+     * while the owning socket holds its mutex, so the counters are single
+     * writer and only use relaxed loads and stores. Other threads may read
+     * them at any time.
+     *
+     */
+    class IODirection {
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> would_block;
+        std::atomic<uint64_t> partial;
+        std::atomic<uint64_t> errors;
+
+        Histogram latency;
+
+        public:
+        IODirection();
+
+        // Record the outcome of a single system call. A negative `result`
+        // is classified using `errno`, 0 counts as a call which moved no
+        // bytes.
+        void record(ssize_t result, size_t requested, uint64_t start);
+
+        // Record the outcome of a call which does not report through `errno`
+        // such as `SSL_write`
+        void record(ssize_t result, size_t requested, uint64_t start, bool blocked);
+
+        void                accumulate(IODirectionSnapshot &out) const;
+        IODirectionSnapshot snapshot() const;
+    };
+
+    /**
+     * @brief Per-socket I/O statistics. Every live instance is registered in a
+     * process wide list so that the totals of all sockets can be collected
+     * with `IOStatistics::aggregate`.
+     *
+     */
+    class IOStatistics {
+        IOStatistics *prev = nullptr;
+        IOStatistics *next = nullptr;
+
+        public:
+        IODirection sent;
+        IODirection received;
+
+        IOStatistics();
+        ~IOStatistics();
+
+        IOStatistics(const IOStatistics &) = delete;
+        IOStatistics &operator=(const IOStatistics &) = delete;
+
+        void       accumulate(IOSnapshot &out) const;
+        IOSnapshot snapshot() const;
+
+        // Sum of the statistics of every live socket
+        static IOSnapshot aggregate();
+    };
+} // namespace Sockets
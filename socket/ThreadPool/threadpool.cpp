@@ -1,38 +1,216 @@
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
 #include "threadpool.hpp"
 
 namespace Sockets {
-    ThreadPool::ThreadPool(size_t N) {
+    namespace {
+        thread_local int current = -1;
+
+        ThreadPoolConfig sized(size_t N, size_t capacity) {
+            ThreadPoolConfig config;
+
+            config.workers  = N;
+            config.capacity = capacity;
+
+            return config;
+        }
+    } // namespace
+
+    ThreadPool::ThreadPool(size_t N, size_t capacity) : ThreadPool(sized(N, capacity)) { }
+
+    ThreadPool::ThreadPool(const ThreadPoolConfig &config)
+        : layout(CpuTopology::detect()), name(config.name), on_start(config.on_start),
+          capacity(config.capacity), started(now_ns()), depth(0), max_depth(0), submitted(0),
+          rejected(0), completed(0) {
+        size_t N = config.workers;
+
+        std::vector<std::vector<int>> sets = config.cpus;
+
+        if (sets.empty() && config.per_core)
+            for (int cpu : this->layout.physical_cores())
+                sets.push_back({cpu});
+
+        if (N == 0)
+            N = sets.empty() ? std::max<size_t>(1, std::thread::hardware_concurrency())
+                             : sets.size();
+
+        this->placement.resize(N);
+
+        if (!sets.empty())
+            for (size_t i = 0; i < N; i++)
+                this->placement[i] = sets[i % sets.size()];
+
+        this->stats.reset(new Worker[N]);
         this->state.store(true);
 
         this->workers.reserve(N);
         for (size_t i = 0; i < N; i++)
-            this->workers.emplace_back(this->serve, std::ref(this->state), std::ref(this->jobs),
-                                       std::ref(this->mtx));
+            this->workers.emplace_back(&ThreadPool::serve, this, i);
     }
 
     ThreadPool::~ThreadPool() {
-        this->state.store(false);
+        {
+            // Under the lock so that no worker misses it between checking
+            // and going to sleep
+            std::lock_guard<std::mutex> lock(this->mtx);
+            this->state.store(false);
+        }
+
+        this->available.notify_all();
 
         for (auto it = this->workers.begin(); it != this->workers.end(); it++)
             (*it).join();
     }
 
-    void ThreadPool::serve(std::atomic_bool &state, std::queue<std::function<void()>> &q,
-                           std::mutex &mtx) {
-        while (state.load()) {
-            std::function<void()> task;
+    void ThreadPool::submit(std::function<void()> fn) {
+        if (!this->state.load()) {
+            this->rejected.fetch_add(1, std::memory_order_relaxed);
+            throw std::runtime_error("Cannot schedule task for terminated threadpool");
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mtx);
+
+            if (this->capacity && this->jobs.size() >= this->capacity) {
+                this->rejected.fetch_add(1, std::memory_order_relaxed);
+                throw std::runtime_error("Cannot schedule task for saturated threadpool");
+            }
+
+            this->jobs.push(Job{std::move(fn), now_ns()});
+
+            size_t n = this->jobs.size();
+            this->depth.store(n, std::memory_order_relaxed);
+
+            if (n > this->max_depth.load(std::memory_order_relaxed))
+                this->max_depth.store(n, std::memory_order_relaxed);
+        }
+
+        this->available.notify_one();
+        this->submitted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int ThreadPool::worker() { return current; }
+
+    void ThreadPool::place(size_t idx) {
+        const std::vector<int> &cpus = this->placement[idx];
+
+        if (!cpus.empty()) {
+            cpu_set_t set;
+
+            CPU_ZERO(&set);
+
+            for (int cpu : cpus)
+                if (cpu >= 0 && cpu < CPU_SETSIZE)
+                    CPU_SET(cpu, &set);
+
+            // The worker still runs unpinned if this fails
+            int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+            if (err != 0) {
+                errno = err;
+                perror("Non-fatal error when pinning worker thread");
+            }
+        }
+
+        // Linux keeps 15 characters, shorten the name rather than the index
+        std::string suffix = "-" + std::to_string(idx);
+        std::string label  =
+            this->name.substr(0, 15 - std::min<size_t>(15, suffix.size())) + suffix;
+
+        pthread_setname_np(pthread_self(), label.c_str());
+
+        current = idx;
+
+        if (this->on_start)
+            this->on_start(idx);
+    }
+
+    void ThreadPool::serve(size_t idx) {
+        Worker &self = this->stats[idx];
+
+        this->place(idx);
+
+        while (this->state.load()) {
+            Job job;
 
             {
-                const std::lock_guard<std::mutex> lock(mtx);
+                std::unique_lock<std::mutex> lock(this->mtx);
+
+                // Sleep instead of spinning on the queue, a pinned worker
+                // would otherwise keep its core busy while idle
+                this->available.wait(
+                    lock, [this]() { return !this->jobs.empty() || !this->state.load(); });
 
-                if (!q.empty()) {
-                    task = q.front();
-                    q.pop();
+                if (!this->jobs.empty()) {
+                    job = std::move(this->jobs.front());
+                    this->jobs.pop();
+                    this->depth.store(this->jobs.size(), std::memory_order_relaxed);
                 }
             }
 
-            if (task)
-                task();
+            if (job.fn) {
+                uint64_t start = now_ns();
+
+                this->wait.record(start - job.enqueued);
+                job.fn();
+
+                uint64_t elapsed = now_ns() - start;
+
+                this->run.record(elapsed);
+                this->completed.fetch_add(1, std::memory_order_relaxed);
+
+                // Only this worker writes its own counters
+                self.tasks.store(self.tasks.load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+                self.busy_ns.store(self.busy_ns.load(std::memory_order_relaxed) + elapsed,
+                                   std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ThreadPoolMetrics ThreadPool::metrics(bool reset_max) {
+        ThreadPoolMetrics out;
+        uint64_t          lifetime = now_ns() - this->started;
+
+        out.queue_depth = this->depth.load(std::memory_order_relaxed);
+        out.max_queue_depth =
+            reset_max ? this->max_depth.exchange(out.queue_depth, std::memory_order_relaxed)
+                      : this->max_depth.load(std::memory_order_relaxed);
+        out.submitted = this->submitted.load(std::memory_order_relaxed);
+        out.rejected  = this->rejected.load(std::memory_order_relaxed);
+        out.completed = this->completed.load(std::memory_order_relaxed);
+        out.wait      = this->wait.snapshot();
+        out.run       = this->run.snapshot();
+
+        out.workers.resize(this->workers.size());
+
+        for (size_t i = 0; i < this->workers.size(); i++) {
+            out.workers[i].tasks   = this->stats[i].tasks.load(std::memory_order_relaxed);
+            out.workers[i].busy_ns = this->stats[i].busy_ns.load(std::memory_order_relaxed);
+            out.workers[i].idle_ns =
+                lifetime > out.workers[i].busy_ns ? lifetime - out.workers[i].busy_ns : 0;
+            out.workers[i].cpus = this->placement[i];
+
+            // Only report a node if every CPU of the worker is on it
+            for (size_t j = 0; j < this->placement[i].size(); j++) {
+                int node = this->layout.node_of(this->placement[i][j]);
+
+                if (j == 0)
+                    out.workers[i].node = node;
+                else if (node != out.workers[i].node) {
+                    out.workers[i].node = -1;
+                    break;
+                }
+            }
         }
+
+        return out;
     }
-} // namespace Sockets
\ No newline at end of file
+} // namespace Sockets
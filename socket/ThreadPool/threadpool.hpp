@@ -5,62 +5,178 @@ https://github.com/progschj/ThreadPool
 It has been modified in order to try and make it as much my own as the original
 */
 
+#pragma once
+
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "../Statistics/histogram.hpp"
+#include "topology.hpp"
+
 namespace Sockets {
+
+    /**
+     * @brief Point in time copy of the instrumentation kept by a `ThreadPool`.
+     * Wait and run times are in nanoseconds.
+     *
+     */
+    struct ThreadPoolMetrics {
+        struct Worker {
+            // Time running tasks, and the rest of the worker's lifetime,
+            // which it mostly spends asleep waiting for one
+            uint64_t tasks   = 0;
+            uint64_t busy_ns = 0;
+            uint64_t idle_ns = 0;
+
+            // CPUs the worker is pinned to and their NUMA node, empty and -1
+            // when the scheduler places it
+            std::vector<int> cpus;
+            int              node = -1;
+
+            // Fraction of the lifetime of the worker spent running tasks
+            double utilisation() const {
+                return busy_ns + idle_ns ? (double)busy_ns / (busy_ns + idle_ns) : 0;
+            }
+        };
+
+        size_t   queue_depth     = 0;
+        size_t   max_queue_depth = 0;
+        uint64_t submitted       = 0;
+        uint64_t rejected        = 0;
+        uint64_t completed       = 0;
+
+        // Time from `schedule` until a worker picks the task up
+        HistogramSnapshot wait;
+        // Time spent executing the task
+        HistogramSnapshot run;
+
+        std::vector<Worker> workers;
+    };
+
+    /**
+     * @brief Where the workers of a `ThreadPool` run. By default they are left
+     * to the scheduler, which is free to migrate them between cores and NUMA
+     * nodes.
+     *
+     */
+    struct ThreadPoolConfig {
+        // Number of workers. 0 starts one per entry of `cpus`, one per
+        // physical core with `per_core` and one per CPU otherwise.
+        size_t workers = 0;
+
+        // A `capacity` of 0 leaves the queue unbounded, otherwise `schedule`
+        // rejects tasks while that many are waiting
+        size_t capacity = 0;
+
+        // CPU sets the workers are pinned to, handed out round robin
+        std::vector<std::vector<int>> cpus;
+
+        // Pin every worker to a physical core of its own, spread over the
+        // NUMA nodes. Ignored when `cpus` is given.
+        bool per_core = false;
+
+        // Threads are named "<name>-<index>", with the name shortened to fit
+        // the 15 characters Linux keeps
+        std::string name = "pool";
+
+        // Runs on every worker once it has been placed, before it takes any
+        // tasks. Memory first touched in here ends up on the worker's NUMA
+        // node, which makes it the place to allocate per-worker data.
+        std::function<void(size_t)> on_start;
+    };
+
     class ThreadPool {
+        struct Job {
+            std::function<void()> fn;
+            uint64_t              enqueued;
+        };
+
+        struct Worker {
+            std::atomic<uint64_t> tasks;
+            std::atomic<uint64_t> busy_ns;
+
+            Worker() : tasks(0), busy_ns(0) { }
+        };
+
         std::atomic_bool         state;
         std::vector<std::thread> workers;
 
-        std::queue<std::function<void()>> jobs;
-        std::mutex                        mtx;
+        CpuTopology                   layout;
+        std::vector<std::vector<int>> placement;
+        std::string                   name;
+        std::function<void(size_t)>   on_start;
+
+        std::queue<Job>         jobs;
+        std::mutex              mtx;
+        std::condition_variable available;
+        size_t                  capacity;
 
-        static void serve(std::atomic_bool &state, std::queue<std::function<void()>> &q,
-                          std::mutex &mtx);
+        // Instrumentation, readable without taking `mtx`
+        uint64_t                  started;
+        std::atomic<size_t>       depth;
+        std::atomic<size_t>       max_depth;
+        std::atomic<uint64_t>     submitted;
+        std::atomic<uint64_t>     rejected;
+        std::atomic<uint64_t>     completed;
+        Histogram                 wait;
+        Histogram                 run;
+        std::unique_ptr<Worker[]> stats;
+
+        void place(size_t idx);
+        void serve(size_t idx);
+        void submit(std::function<void()> fn);
 
         public:
-        ThreadPool(size_t N);
+        // A `capacity` of 0 leaves the queue unbounded, otherwise `schedule`
+        // rejects tasks while that many are waiting
+        ThreadPool(size_t N, size_t capacity = 0);
+
+        explicit ThreadPool(const ThreadPoolConfig &config);
 
         ~ThreadPool();
 
         template <class F, class... Args>
-        std::future<class std::result_of<F(Args...)>::type> schedule(F &&fn, Args &&... args) {
+        std::future<typename std::result_of<F(Args...)>::type> schedule(F &&fn, Args &&... args) {
             using type = typename std::result_of<F(Args...)>::type;
 
             auto task = std::make_shared<std::packaged_task<type()>>(
-                std::bind(std::forward<F>(fn, std::forward<Args>(args)...)));
+                std::bind(std::forward<F>(fn), std::forward<Args>(args)...));
             std::future<type> result = task->get_future();
 
-            if (this->state.load()) {
-                std::lock_guard<std::mutex> lock(this->mtx);
-                this->jobs.emplace([task]() { (*task)(); });
-            } else {
-                throw std::runtime_error("Cannot schedule task for terminated threadpool");
-            }
+            this->submit([task]() { (*task)(); });
 
             return result;
         }
 
         template <class R, class... Args>
-        std::future<class std::result_of<R(Args...)>::type> schedule(std::function<R(Args...)> fn) {
+        std::future<typename std::result_of<R(Args...)>::type>
+        schedule(std::function<R(Args...)> fn) {
             auto           task   = std::make_shared<std::packaged_task<R()>>(fn);
             std::future<R> result = task->get_future();
 
-            if (this->state.load()) {
-                std::lock_guard<std::mutex> lock(this->mtx);
-                this->jobs.emplace([task]() { (*task)(); });
-            } else {
-                throw std::runtime_error("Cannot schedule task for terminated threadpool");
-            }
+            this->submit([task]() { (*task)(); });
 
             return result;
         }
+
+        // Index of the calling thread within its pool, -1 outside of a pool.
+        // Lets tasks find the per-worker data set up by `on_start`.
+        static int worker();
+
+        // The machine as seen when the pool was started
+        const CpuTopology &topology() const { return this->layout; }
+
+        // Cheap enough to be scraped periodically. With `reset_max` the
+        // maximum queue depth starts over so it covers one scrape interval.
+        ThreadPoolMetrics metrics(bool reset_max = false);
     };
-} // namespace Sockets
\ No newline at end of file
+} // namespace Sockets
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <sched.h>
+
+#include "topology.hpp"
+
+namespace Sockets {
+
+    namespace {
+        const std::string sysfs = "/sys/devices/system/";
+
+        bool read_line(const std::string &path, std::string &out) {
+            std::ifstream in(path);
+
+            return static_cast<bool>(std::getline(in, out));
+        }
+
+        int read_int(const std::string &path, int fallback) {
+            std::string line;
+
+            return read_line(path, line) ? std::atoi(line.c_str()) : fallback;
+        }
+    } // namespace
+
+    std::vector<int> parse_cpu_list(const std::string &list) {
+        std::vector<int>  out;
+        std::stringstream ss(list);
+        std::string       range;
+
+        while (std::getline(ss, range, ',')) {
+            if (range.empty())
+                continue;
+
+            size_t dash  = range.find('-');
+            int    first = std::atoi(range.c_str());
+            int    last  = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+
+            for (int cpu = first; cpu <= last; cpu++)
+                out.push_back(cpu);
+        }
+
+        return out;
+    }
+
+    CpuTopology CpuTopology::detect() {
+        CpuTopology out;
+        std::string line;
+        cpu_set_t   allowed;
+
+        CPU_ZERO(&allowed);
+
+        bool masked = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+        std::vector<int> online;
+
+        if (read_line(sysfs + "cpu/online", line))
+            online = parse_cpu_list(line);
+
+        // Without sysfs every CPU is its own core on a single node
+        if (online.empty())
+            for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++)
+                online.push_back(i);
+
+        std::map<int, int> nodes;
+
+        if (read_line(sysfs + "node/online", line))
+            for (int node : parse_cpu_list(line))
+                if (read_line(sysfs + "node/node" + std::to_string(node) + "/cpulist", line))
+                    for (int cpu : parse_cpu_list(line))
+                        nodes[cpu] = node;
+
+        for (int id : online) {
+            if (masked && (id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed)))
+                continue;
+
+            std::string dir = sysfs + "cpu/cpu" + std::to_string(id) + "/topology/";
+            Cpu         cpu;
+
+            cpu.id      = id;
+            cpu.core    = read_int(dir + "core_id", id);
+            cpu.package = read_int(dir + "physical_package_id", 0);
+            cpu.node    = nodes.count(id) ? nodes[id] : 0;
+
+            out.cpus.push_back(cpu);
+        }
+
+        return out;
+    }
+
+    std::vector<int> CpuTopology::physical_cores() const {
+        std::set<std::pair<int, int>>   seen;
+        std::map<int, std::vector<int>> by_node;
+
+        for (auto &cpu : this->cpus)
+            if (seen.insert(std::make_pair(cpu.package, cpu.core)).second)
+                by_node[cpu.node].push_back(cpu.id);
+
+        // Round robin over the nodes
+        std::vector<int> out;
+
+        for (size_t i = 0; out.size() < seen.size(); i++)
+            for (auto &it : by_node)
+                if (i < it.second.size())
+                    out.push_back(it.second[i]);
+
+        return out;
+    }
+
+    std::vector<int> CpuTopology::node_cpus(int node) const {
+        std::vector<int> out;
+
+        for (auto &cpu : this->cpus)
+            if (cpu.node == node)
+                out.push_back(cpu.id);
+
+        return out;
+    }
+
+    int CpuTopology::node_of(int cpu) const {
+        for (auto &it : this->cpus)
+            if (it.id == cpu)
+                return it.node;
+
+        return 0;
+    }
+
+    size_t CpuTopology::nodes() const {
+        std::set<int> out;
+
+        for (auto &cpu : this->cpus)
+            out.insert(cpu.node);
+
+        return out.size();
+    }
+
+    size_t CpuTopology::cores() const {
+        std::set<std::pair<int, int>> out;
+
+        for (auto &cpu : this->cpus)
+            out.insert(std::make_pair(cpu.package, cpu.core));
+
+        return out.size();
+    }
+
+    std::string CpuTopology::describe() const {
+        return std::to_string(this->nodes()) + " nodes, " + std::to_string(this->cores()) +
+               " cores, " + std::to_string(this->cpus.size()) + " cpus";
+    }
+} // namespace Sockets
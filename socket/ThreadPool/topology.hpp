@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Sockets {
+
+    /**
+     * @brief The CPUs this process may run on as laid out by the kernel in
+     * `/sys/devices/system`. Hyperthreads of one physical core share a
+     * `core` and `package`, `node` is the NUMA node whose memory is local.
+     *
+     */
+    struct CpuTopology {
+        struct Cpu {
+            int id      = 0;
+            int core    = 0;
+            int package = 0;
+            int node    = 0;
+        };
+
+        std::vector<Cpu> cpus;
+
+        // Read the topology of the machine, restricted to the CPUs in the
+        // affinity mask of the calling thread
+        static CpuTopology detect();
+
+        // The first hyperthread of every physical core, spread over the NUMA
+        // nodes so that a prefix of the list uses all of them
+        std::vector<int> physical_cores() const;
+
+        // CPUs belonging to NUMA node `node`
+        std::vector<int> node_cpus(int node) const;
+
+        // NUMA node of `cpu`, 0 for an unknown CPU
+        int node_of(int cpu) const;
+
+        size_t nodes() const;
+        size_t cores() const;
+
+        // One line summary such as "2 nodes, 32 cores, 64 cpus"
+        std::string describe() const;
+    };
+
+    // Parse a kernel CPU list such as "0-3,8,10-11"
+    std::vector<int> parse_cpu_list(const std::string &list);
+} // namespace Sockets
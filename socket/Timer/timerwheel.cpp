@@ -0,0 +1,254 @@
+#include <algorithm>
+
+#include "timerwheel.hpp"
+
+namespace Sockets {
+
+    void Timer::cancel() {
+        if (this->wheel)
+            this->wheel->cancel(*this);
+    }
+
+    TimerWheel::TimerWheel(std::chrono::milliseconds resolution, uint64_t now)
+        : resolution(std::max<uint64_t>(
+              1, std::chrono::duration_cast<std::chrono::nanoseconds>(resolution).count())),
+          origin(now) { }
+
+    TimerWheel::~TimerWheel() {
+        // Disarm whatever is left so that timers outliving the wheel do not
+        // reach back into it
+        for (int level = due_level; level >= firing_level; level--)
+            while (Timer *t = this->list(level, 0).head)
+                this->cancel(*t);
+
+        for (int level = 0; level < levels; level++)
+            for (int slot = 0; slot < slots; slot++)
+                while (Timer *t = this->wheel[level][slot].head)
+                    this->cancel(*t);
+    }
+
+    TimerWheel::List &TimerWheel::list(int level, int slot) {
+        if (level == due_level)
+            return this->due;
+
+        if (level == firing_level)
+            return this->firing;
+
+        return this->wheel[level][slot];
+    }
+
+    void TimerWheel::link(Timer &t, int level, int slot) {
+        List &l = this->list(level, slot);
+
+        t.prev  = l.tail;
+        t.next  = nullptr;
+        t.level = level;
+        t.slot  = slot;
+
+        if (l.tail)
+            l.tail->next = &t;
+        else
+            l.head = &t;
+
+        l.tail = &t;
+
+        if (level >= 0)
+            this->occupied[level] |= 1ULL << slot;
+    }
+
+    void TimerWheel::unlink(Timer &t) {
+        List &l = this->list(t.level, t.slot);
+
+        if (t.prev)
+            t.prev->next = t.next;
+        else
+            l.head = t.next;
+
+        if (t.next)
+            t.next->prev = t.prev;
+        else
+            l.tail = t.prev;
+
+        t.prev = t.next = nullptr;
+
+        if (t.level >= 0 && !l.head)
+            this->occupied[t.level] &= ~(1ULL << t.slot);
+    }
+
+    uint64_t TimerWheel::ticks(uint64_t ns) const {
+        return ns > this->origin ? (ns - this->origin) / this->resolution : 0;
+    }
+
+    void TimerWheel::place(Timer &t) {
+        if (t.expiry <= this->current) {
+            this->link(t, due_level, 0);
+            return;
+        }
+
+        uint64_t delta = t.expiry - this->current;
+
+        for (int level = 0; level < levels; level++) {
+            uint64_t span = 1ULL << (bits * (level + 1));
+
+            if (delta < span) {
+                this->link(t, level, (t.expiry >> (bits * level)) & mask);
+                return;
+            }
+        }
+
+        // Beyond the range of the wheel. Park the timer in the furthest slot,
+        // it is placed again once that slot is cascaded.
+        uint64_t at = this->current + (1ULL << (bits * levels)) - 1;
+        this->link(t, levels - 1, (at >> (bits * (levels - 1))) & mask);
+    }
+
+    void TimerWheel::cascade(int level) {
+        int   idx   = (this->current >> (bits * level)) & mask;
+        List &slot  = this->wheel[level][idx];
+        Timer *head = slot.head;
+
+        slot.head = slot.tail = nullptr;
+        this->occupied[level] &= ~(1ULL << idx);
+
+        while (head) {
+            Timer *t = head;
+            head     = t->next;
+            this->place(*t);
+        }
+
+        if (idx == 0 && level + 1 < levels)
+            this->cascade(level + 1);
+    }
+
+    void TimerWheel::collect(int slot) {
+        while (Timer *t = this->wheel[0][slot].head) {
+            this->unlink(*t);
+            this->link(*t, due_level, 0);
+        }
+    }
+
+    void TimerWheel::schedule(Timer &t, std::chrono::milliseconds delay) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+
+        if (t.wheel)
+            t.wheel->cancel(t);
+
+        t.wheel  = this;
+        t.expiry = this->ticks(now_ns()) + (ns + this->resolution - 1) / this->resolution;
+        this->place(t);
+        this->count++;
+    }
+
+    void TimerWheel::cancel(Timer &t) {
+        if (t.wheel != this)
+            return;
+
+        this->unlink(t);
+        t.wheel = nullptr;
+        this->count--;
+    }
+
+    size_t TimerWheel::advance(uint64_t now) {
+        uint64_t target = this->ticks(now);
+        size_t   fired  = 0;
+
+        while (this->current < target) {
+            uint64_t any = 0;
+
+            for (int level = 0; level < levels; level++)
+                any |= this->occupied[level];
+
+            if (!any) {
+                this->current = target;
+                break;
+            }
+
+            // Jump straight to the next occupied slot on the lowest level or
+            // the next cascade, whichever comes first. Cascades of empty
+            // levels are skipped as well.
+            uint64_t pos  = this->current & mask;
+            uint64_t next = (this->current | mask) + 1;
+
+            if (this->occupied[0]) {
+                uint64_t pending = pos < mask ? this->occupied[0] & (~0ULL << (pos + 1)) : 0;
+
+                if (pending)
+                    next = (this->current & ~mask) + __builtin_ctzll(pending);
+            } else {
+                int level = 1;
+
+                while (!this->occupied[level])
+                    level++;
+
+                next = (this->current | ((1ULL << (bits * level)) - 1)) + 1;
+            }
+
+            if (next > target) {
+                this->current = target;
+                break;
+            }
+
+            this->current = next;
+
+            if ((this->current & mask) == 0)
+                this->cascade(1);
+
+            if (this->occupied[0] & (1ULL << (this->current & mask)))
+                this->collect(this->current & mask);
+        }
+
+        // Run the callbacks of everything collected above as one batch.
+        // Timers armed by the callbacks wait for the next call.
+        std::swap(this->firing, this->due);
+
+        for (Timer *t = this->firing.head; t; t = t->next)
+            t->level = firing_level;
+
+        while (Timer *t = this->firing.head) {
+            this->cancel(*t);
+            fired++;
+
+            if (t->callback)
+                t->callback();
+        }
+
+        return fired;
+    }
+
+    int TimerWheel::timeout(int cap) const {
+        if (this->count == 0)
+            return cap;
+
+        if (this->due.head)
+            return 0;
+
+        uint64_t soonest = UINT64_MAX;
+
+        // The start of the first occupied slot on every level bounds when the
+        // next timer can fire. Higher levels may wake the loop early to
+        // cascade, which is harmless.
+        for (int level = 0; level < levels; level++) {
+            uint64_t occ = this->occupied[level];
+
+            if (!occ)
+                continue;
+
+            int      shift = bits * level;
+            uint64_t pos   = (this->current >> shift) & mask;
+            uint64_t s     = pos + 1;
+            uint64_t rot   = s == slots ? occ : (occ >> s) | (occ << (slots - s));
+            uint64_t block = (this->current >> shift) + __builtin_ctzll(rot) + 1;
+
+            soonest = std::min(soonest, block << shift);
+        }
+
+        uint64_t deadline = this->origin + soonest * this->resolution;
+        uint64_t now      = now_ns();
+        uint64_t ms       = deadline > now ? (deadline - now + 999999) / 1000000 : 0;
+
+        if (cap >= 0 && ms > static_cast<uint64_t>(cap))
+            return cap;
+
+        return static_cast<int>(std::min<uint64_t>(ms, INT32_MAX));
+    }
+} // namespace Sockets
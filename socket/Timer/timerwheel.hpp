@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "../Statistics/histogram.hpp"
+
+namespace Sockets {
+    class TimerWheel;
+
+    /**
+     * @brief A timer which can be armed on a `TimerWheel`. The timer is an
+     * intrusive list node, so arming, cancelling and re-arming never allocate.
+     * The owner keeps the timer alive while it is armed; destroying it
+     * cancels it.
+     *
+     */
+    class Timer {
+        friend class TimerWheel;
+
+        Timer *     prev   = nullptr;
+        Timer *     next   = nullptr;
+        TimerWheel *wheel  = nullptr;
+        uint64_t    expiry = 0;
+        int         level  = 0;
+        int         slot   = 0;
+
+        public:
+        std::function<void()> callback;
+
+        Timer() = default;
+        explicit Timer(std::function<void()> callback) : callback(std::move(callback)) { }
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+        ~Timer() { this->cancel(); }
+
+        bool armed() const { return this->wheel != nullptr; }
+        void cancel();
+    };
+
+    /**
+     * @brief Hierarchical timing wheel in the style of Varghese and Lauck.
+     * Four levels of 64 slots cover 2^24 ticks, timers further out are parked
+     * in the last level and re-inserted as the wheel turns. Insertion,
+     * cancellation and rescheduling are O(1). Expired timers are collected in
+     * one pass and their callbacks run afterwards.
+     *
+     */
+    class TimerWheel {
+        static const int      bits   = 6;
+        static const int      slots  = 1 << bits;
+        static const int      levels = 4;
+        static const uint64_t mask   = slots - 1;
+
+        // Pseudo levels for timers which have expired and wait for their
+        // callback, and for the batch whose callbacks are currently running
+        static const int due_level    = -1;
+        static const int firing_level = -2;
+
+        struct List {
+            Timer *head = nullptr;
+            Timer *tail = nullptr;
+        };
+
+        List     wheel[levels][slots];
+        uint64_t occupied[levels] = {};
+        List     due;
+        List     firing;
+
+        uint64_t resolution;
+        uint64_t origin;
+        uint64_t current = 0;
+        size_t   count   = 0;
+
+        List &   list(int level, int slot);
+        void     link(Timer &t, int level, int slot);
+        void     unlink(Timer &t);
+        uint64_t ticks(uint64_t ns) const;
+        void     place(Timer &t);
+        void     cascade(int level);
+        void     collect(int slot);
+
+        friend class Timer;
+
+        public:
+        TimerWheel(std::chrono::milliseconds resolution = std::chrono::milliseconds(1),
+                   uint64_t                  now        = now_ns());
+        ~TimerWheel();
+
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+
+        // Arm `t` to fire after `delay`. An armed timer is moved to its new
+        // expiry.
+        void schedule(Timer &t, std::chrono::milliseconds delay);
+        void cancel(Timer &t);
+
+        // Fire every timer which is due by `now` and return how many fired
+        size_t advance(uint64_t now = now_ns());
+
+        // Milliseconds until the next timer could fire, suitable as a `poll`
+        // timeout. Returns `cap` when nothing is armed and never more than
+        // `cap` unless `cap` is negative.
+        int timeout(int cap = -1) const;
+
+        size_t size() const { return this->count; }
+    };
+} // namespace Sockets
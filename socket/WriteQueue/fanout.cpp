@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "fanout.hpp"
+
+namespace Sockets {
+
+    FanOut::FanOut(SlowConsumer policy, size_t limit) : policy(policy), limit(limit) { }
+
+    void FanOut::evict(const std::shared_ptr<TCPSocket> &sock, bool slow) {
+        // Hold on to the socket, the subscriber owning it goes away below
+        std::shared_ptr<TCPSocket> s = sock;
+
+        this->unsubscribe(s);
+        this->stats.evicted++;
+
+        if (this->on_evict)
+            this->on_evict(s, slow);
+    }
+
+    bool FanOut::send(Subscriber &sub) {
+        bool drained = sub.queue.flush();
+
+        this->stats.flushes++;
+
+        if (drained == sub.blocked) {
+            sub.blocked = !drained;
+
+            if (this->on_interest)
+                this->on_interest(sub.sock, sub.blocked);
+        }
+
+        return drained;
+    }
+
+    void FanOut::subscribe(std::shared_ptr<TCPSocket> sock) {
+        int fd = sock->fd();
+
+        if (this->index.count(fd))
+            return;
+
+        this->index[fd] = this->subscribers.size();
+        this->subscribers.emplace_back(new Subscriber(std::move(sock)));
+    }
+
+    void FanOut::unsubscribe(const std::shared_ptr<TCPSocket> &sock) {
+        auto it = this->index.find(sock->fd());
+
+        // A closed socket no longer knows its descriptor, look for the
+        // socket itself instead
+        if (it == this->index.end() || this->subscribers[it->second]->sock != sock) {
+            auto sub = std::find_if(this->subscribers.begin(), this->subscribers.end(),
+                                    [&sock](const std::unique_ptr<Subscriber> &s) {
+                                        return s->sock == sock;
+                                    });
+
+            if (sub == this->subscribers.end())
+                return;
+
+            it = this->index.find((*sub)->fd);
+        }
+
+        size_t idx  = it->second;
+        size_t last = this->subscribers.size() - 1;
+
+        // Move the last subscriber into the hole to keep the vector dense
+        if (idx != last) {
+            this->subscribers[idx].swap(this->subscribers[last]);
+            this->index[this->subscribers[idx]->fd] = idx;
+        }
+
+        this->subscribers.pop_back();
+        this->index.erase(it);
+    }
+
+    void FanOut::publish(std::shared_ptr<const std::string> buf) {
+        const char *data = buf->data();
+        size_t      size = buf->size();
+
+        this->publish(std::move(buf), data, size);
+    }
+
+    void FanOut::publish(std::shared_ptr<const void> owner, const char *data, size_t size) {
+        std::vector<std::shared_ptr<TCPSocket>> slow;
+
+        this->stats.published++;
+
+        if (!size)
+            return;
+
+        for (auto &sub : this->subscribers) {
+            WriteQueue &queue = sub->queue;
+
+            // A message larger than the limit still goes to subscribers
+            // which are keeping up
+            if (!queue.empty() && queue.pending() + size > this->limit) {
+                if (this->policy == SlowConsumer::Skip)
+                    this->stats.skipped++;
+                else
+                    slow.push_back(sub->sock);
+
+                continue;
+            }
+
+            queue.append(owner, data, size);
+            this->stats.queued++;
+        }
+
+        for (auto &s : slow)
+            this->evict(s, true);
+    }
+
+    size_t FanOut::flush() {
+        std::vector<std::shared_ptr<TCPSocket>> failed;
+        size_t                                  waiting = 0;
+
+        for (auto &sub : this->subscribers) {
+            // Subscribers waiting on POLLOUT are flushed by `ready`
+            if (sub->blocked) {
+                waiting++;
+                continue;
+            }
+
+            if (sub->queue.empty())
+                continue;
+
+            try {
+                waiting += !this->send(*sub);
+            } catch (const std::runtime_error &) {
+                failed.push_back(sub->sock);
+            }
+        }
+
+        for (auto &s : failed)
+            this->evict(s, false);
+
+        return waiting;
+    }
+
+    bool FanOut::ready(const std::shared_ptr<TCPSocket> &sock) {
+        auto it = this->index.find(sock->fd());
+
+        if (it == this->index.end())
+            return true;
+
+        try {
+            return this->send(*this->subscribers[it->second]);
+        } catch (const std::runtime_error &) {
+            this->evict(sock, false);
+            return false;
+        }
+    }
+
+    size_t FanOut::pending(const std::shared_ptr<TCPSocket> &sock) const {
+        auto it = this->index.find(sock->fd());
+
+        return it == this->index.end() ? 0 : this->subscribers[it->second]->queue.pending();
+    }
+} // namespace Sockets
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Socket/socket.hpp"
+#include "writequeue.hpp"
+
+namespace Sockets {
+
+    // What a `FanOut` does with a subscriber whose queue has no room left
+    // for the next message
+    enum class SlowConsumer {
+        // Leave the message out for that subscriber. Whole messages are
+        // dropped, so the stream it receives stays well framed.
+        Skip,
+        // Remove the subscriber and report it through `on_evict`
+        Evict,
+    };
+
+    /**
+     * @brief Counters kept by a `FanOut`. `queued` and `skipped` count
+     * messages per subscriber, `flushes` the subscriber flushes it took to
+     * push them out.
+     *
+     */
+    struct FanOutStatistics {
+        uint64_t published = 0;
+        uint64_t queued    = 0;
+        uint64_t skipped   = 0;
+        uint64_t evicted   = 0;
+        uint64_t flushes   = 0;
+    };
+
+    /**
+     * @brief Sends the same messages to many non-blocking sockets. A
+     * published buffer is queued by reference on every subscriber, nothing
+     * is copied, and `flush` then writes out everything a subscriber has
+     * pending with one `sendv`. Publishing a burst before flushing sends the
+     * whole burst in a single call per subscriber.
+     *
+     * A subscriber whose socket is full is left out of `flush` until `ready`
+     * reports it writable again, so slow readers cost no syscalls while they
+     * catch up. Once more than `limit` bytes are queued for one of them the
+     * policy decides whether it misses messages or gets evicted.
+     * `on_interest` reports when a subscriber needs to be polled for
+     * `POLLOUT`.
+     *
+     * Like `WriteQueue` it is not thread-safe, it belongs to the thread which
+     * polls the subscribers.
+     *
+     */
+    class FanOut {
+        struct Subscriber {
+            std::shared_ptr<TCPSocket> sock;
+            WriteQueue                 queue;
+            bool                       blocked = false;
+
+            // Descriptor it is indexed by, which `sock` forgets on close
+            int fd;
+
+            Subscriber(std::shared_ptr<TCPSocket> sock)
+                : sock(sock), queue(sock, SIZE_MAX, SIZE_MAX), fd(sock->fd()) { }
+        };
+
+        std::vector<std::unique_ptr<Subscriber>> subscribers;
+
+        // Position of every subscriber in `subscribers` by descriptor
+        std::unordered_map<int, size_t> index;
+
+        SlowConsumer     policy;
+        size_t           limit;
+        FanOutStatistics stats;
+
+        void evict(const std::shared_ptr<TCPSocket> &sock, bool slow);
+        bool send(Subscriber &sub);
+
+        public:
+        // Runs for every evicted subscriber, `slow` tells the queue limit
+        // apart from a failed write
+        std::function<void(const std::shared_ptr<TCPSocket> &, bool slow)> on_evict;
+
+        // Runs when a subscriber has to be polled for `POLLOUT`, and again
+        // once it drained
+        std::function<void(const std::shared_ptr<TCPSocket> &, bool)> on_interest;
+
+        FanOut(SlowConsumer policy = SlowConsumer::Skip, size_t limit = 1024 * 1024);
+
+        FanOut(const FanOut &) = delete;
+        FanOut &operator=(const FanOut &) = delete;
+
+        // `sock` has to be non-blocking
+        void subscribe(std::shared_ptr<TCPSocket> sock);
+        // Drops whatever is still queued for `sock`
+        void unsubscribe(const std::shared_ptr<TCPSocket> &sock);
+
+        // Queue a message on every subscriber without sending anything. The
+        // buffer must not be modified until it has been sent everywhere.
+        void publish(std::shared_ptr<const std::string> buf);
+        void publish(std::shared_ptr<const void> owner, const char *data, size_t size);
+
+        // Send what is pending to every subscriber which is not waiting on
+        // `POLLOUT`. Returns the number of subscribers left waiting.
+        size_t flush();
+
+        // Flush `sock` after the poller reported it writable. Returns true
+        // once its queue is empty, false while data is pending or after a
+        // failed write evicted it.
+        bool ready(const std::shared_ptr<TCPSocket> &sock);
+
+        // Bytes queued for `sock`
+        size_t pending(const std::shared_ptr<TCPSocket> &sock) const;
+
+        size_t size() const { return this->subscribers.size(); }
+
+        const FanOutStatistics &statistics() const { return this->stats; }
+    };
+} // namespace Sockets
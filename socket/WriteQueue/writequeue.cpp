@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+
+#include <sys/uio.h>
+
+#include "writequeue.hpp"
+
+namespace Sockets {
+
+    const size_t WriteQueue::chunk_size;
+
+    WriteQueue::WriteQueue(std::shared_ptr<TCPSocket> sock, size_t high, size_t low)
+        : sock(std::move(sock)), high(high), low(std::min(low, high)) { }
+
+    void WriteQueue::enqueue(std::shared_ptr<const void> owner, const char *data, size_t size) {
+        this->segments.push_back(Segment{std::move(owner), data, size});
+        this->bytes += size;
+    }
+
+    void WriteQueue::copy(const char *data, size_t size) {
+        this->bytes += size;
+
+        // Append to the current chunk while it has room and nothing else was
+        // queued behind it. The capacity is reserved up front so queued
+        // segments never move.
+        if (this->chunk && this->chunk->size() + size <= this->chunk->capacity()) {
+            bool tail = !this->segments.empty() && this->segments.back().owner == this->chunk;
+
+            if (tail || this->chunk->empty()) {
+                const char *at = this->chunk->data() + this->chunk->size();
+
+                this->chunk->insert(this->chunk->end(), data, data + size);
+
+                if (tail)
+                    this->segments.back().size += size;
+                else
+                    this->segments.push_back(Segment{this->chunk, at, size});
+
+                return;
+            }
+        }
+
+        auto buf = std::make_shared<std::vector<char>>();
+        buf->reserve(std::max(size, chunk_size));
+        buf->insert(buf->end(), data, data + size);
+
+        if (size < chunk_size)
+            this->chunk = buf;
+
+        this->segments.push_back(Segment{buf, buf->data(), size});
+    }
+
+    void WriteQueue::consume(size_t n) {
+        this->bytes -= n;
+
+        while (n) {
+            Segment &front = this->segments.front();
+
+            if (n < front.size) {
+                front.data += n;
+                front.size -= n;
+                return;
+            }
+
+            n -= front.size;
+            this->segments.pop_front();
+        }
+    }
+
+    void WriteQueue::update() {
+        bool want = this->bytes != 0;
+
+        if (want != this->interested) {
+            this->interested = want;
+
+            if (this->on_interest)
+                this->on_interest(want);
+        }
+
+        if (!this->above && this->bytes >= this->high) {
+            this->above = true;
+
+            if (this->on_high)
+                this->on_high();
+        } else if (this->above && this->bytes <= this->low) {
+            this->above = false;
+
+            if (this->on_low)
+                this->on_low();
+        }
+    }
+
+    void WriteQueue::write(const char *buf, size_t buflen) {
+        size_t n = 0;
+
+        // Nothing queued means nothing to keep in order with, try the socket
+        // directly and only queue what it refused
+        if (this->segments.empty() && buflen) {
+            errno = 0;
+            n     = this->sock->send(buf, buflen);
+
+            if (n < buflen && errno && errno != EAGAIN && errno != EWOULDBLOCK)
+                throw std::runtime_error("Error when writing to socket");
+        }
+
+        if (n < buflen)
+            this->copy(buf + n, buflen - n);
+
+        this->update();
+    }
+
+    void WriteQueue::write(std::shared_ptr<const std::string> buf) {
+        const char *data = buf->data();
+        size_t      size = buf->size();
+
+        this->write(std::move(buf), data, size);
+    }
+
+    void WriteQueue::write(std::shared_ptr<const void> owner, const char *data, size_t size) {
+        if (size) {
+            this->enqueue(std::move(owner), data, size);
+            this->flush();
+        }
+    }
+
+    void WriteQueue::append(std::shared_ptr<const void> owner, const char *data, size_t size) {
+        if (size) {
+            this->enqueue(std::move(owner), data, size);
+            this->update();
+        }
+    }
+
+    bool WriteQueue::flush() {
+        struct iovec iov[batch];
+
+        while (!this->segments.empty()) {
+            int    count = 0;
+            size_t total = 0;
+
+            for (auto it = this->segments.begin(); it != this->segments.end() && count < batch;
+                 it++, count++) {
+                iov[count].iov_base = const_cast<char *>(it->data);
+                iov[count].iov_len  = it->size;
+                total += it->size;
+            }
+
+            errno    = 0;
+            size_t n = this->sock->sendv(iov, count);
+
+            if (n == 0 && errno && errno != EAGAIN && errno != EWOULDBLOCK)
+                throw std::runtime_error("Error when flushing write queue");
+
+            this->consume(n);
+
+            if (n < total)
+                break;
+        }
+
+        // Once everything is sent the chunk is referenced by nothing else
+        // and can be refilled from the start
+        if (this->segments.empty() && this->chunk)
+            this->chunk->clear();
+
+        this->update();
+
+        return this->segments.empty();
+    }
+} // namespace Sockets
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+
+#include "../Polling/polling.hpp"
+#include "../Socket/socket.hpp"
+
+namespace Sockets {
+
+    /**
+     * @brief Outbound buffer for a non-blocking socket. Writes never block,
+     * whatever the kernel does not take right away is queued and sent with
+     * one `sendv` per flush once the socket becomes writable again.
+     *
+     * Small copied writes are packed into shared chunks, so a burst of tiny
+     * messages still goes out in a few large segments. Reference counted
+     * buffers are queued without copying them.
+     *
+     * Producers are throttled through the watermarks. `on_high` runs once the
+     * queue reaches `high` bytes and `on_low` once it drained back to `low`.
+     * `on_interest` reports when the socket needs to be polled for `POLLOUT`,
+     * which is only while data is pending.
+     *
+     * The queue is not thread-safe, it belongs to the thread which polls the
+     * socket.
+     *
+     */
+    class WriteQueue {
+        struct Segment {
+            std::shared_ptr<const void> owner;
+            const char *                data;
+            size_t                      size;
+        };
+
+        static const size_t chunk_size = 16 * 1024;
+        static const int    batch      = 64;
+
+        std::shared_ptr<TCPSocket>         sock;
+        std::deque<Segment>                segments;
+        std::shared_ptr<std::vector<char>> chunk;
+
+        size_t bytes = 0;
+        size_t high;
+        size_t low;
+        bool   above      = false;
+        bool   interested = false;
+
+        void enqueue(std::shared_ptr<const void> owner, const char *data, size_t size);
+        void copy(const char *data, size_t size);
+        void consume(size_t n);
+        void update();
+
+        public:
+        std::function<void()>     on_high;
+        std::function<void()>     on_low;
+        std::function<void(bool)> on_interest;
+
+        WriteQueue(std::shared_ptr<TCPSocket> sock, size_t high = 1024 * 1024,
+                   size_t low = 256 * 1024);
+
+        WriteQueue(const WriteQueue &) = delete;
+        WriteQueue &operator=(const WriteQueue &) = delete;
+
+        // Send what the socket takes right away and queue the rest by copy
+        void write(const char *buf, size_t buflen);
+        void write(const std::string &s) { this->write(s.data(), s.size()); }
+
+        // Queue a shared buffer without copying it. The buffer must not be
+        // modified until it has been sent.
+        void write(std::shared_ptr<const std::string> buf);
+        void write(std::shared_ptr<const void> owner, const char *data, size_t size);
+
+        // Queue a shared buffer behind whatever is pending without trying
+        // the socket. It goes out with the next `flush`, so several messages
+        // can share one `sendv`.
+        void append(std::shared_ptr<const void> owner, const char *data, size_t size);
+
+        // Send as much of the queue as the socket accepts. Call this when
+        // the socket is reported writable. Returns true once the queue is
+        // empty.
+        bool flush();
+
+        size_t pending() const { return this->bytes; }
+        bool   empty() const { return this->bytes == 0; }
+
+        // Between crossing the high watermark and draining to the low one
+        bool throttled() const { return this->above; }
+
+        // Keep the registration of `s` on `poll` in line with the queue,
+        // `events` plus `POLLOUT` while data is pending
+        template <class S>
+        void watch(Poll<S> &poll, std::shared_ptr<S> s, short events = POLLIN) {
+            this->on_interest = [&poll, s, events](bool writable) {
+                poll.modify(s, writable ? events | POLLOUT : events);
+            };
+
+            poll.enroll(s, this->interested ? events | POLLOUT : events);
+        }
+    };
+
+    /**
+     * @brief Flushes write queues when `Poll` reports their sockets
+     * writable. Queues are registered by descriptor through `watch`, and
+     * `dispatch` hands every socket in the `POLLOUT` list of a `Poll::poll`
+     * result to its queue, so the event loop only deals with reads and
+     * errors.
+     *
+     * Like the queues it is not thread-safe, it belongs to the thread which
+     * polls the sockets.
+     *
+     */
+    template <class S>
+    class WriteDispatch {
+        Poll<S> &poll;
+
+        struct Watched {
+            std::shared_ptr<S> sock;
+            WriteQueue *       queue;
+        };
+
+        // Queue of every watched socket by descriptor
+        std::unordered_map<int, Watched> queues;
+
+        public:
+        explicit WriteDispatch(Poll<S> &poll) : poll(poll) { }
+
+        WriteDispatch(const WriteDispatch &) = delete;
+        WriteDispatch &operator=(const WriteDispatch &) = delete;
+
+        // Flush `queue` whenever `s` is reported writable. `s` is enrolled
+        // for `events` and for `POLLOUT` while data is pending, as with
+        // `WriteQueue::watch`. The queue has to outlive the registration.
+        void watch(WriteQueue &queue, std::shared_ptr<S> s, short events = POLLIN) {
+            this->queues[s->fd()] = {s, &queue};
+            queue.watch(this->poll, std::move(s), events);
+        }
+
+        // Stop flushing the queue of `s` and take it off the poll
+        void forget(const std::shared_ptr<S> &s) {
+            auto it = this->queues.find(s->fd());
+
+            // A closed socket no longer knows its descriptor, look for the
+            // socket itself instead
+            if (it == this->queues.end() || it->second.sock != s)
+                it = std::find_if(this->queues.begin(), this->queues.end(),
+                                  [&s](const std::pair<const int, Watched> &w) {
+                                      return w.second.sock == s;
+                                  });
+
+            if (it == this->queues.end())
+                return;
+
+            it->second.queue->on_interest = nullptr;
+            this->queues.erase(it);
+            this->poll.disenroll(s);
+        }
+
+        // Flush the queues of the writable sockets in `events`, the result
+        // of `Poll::poll`. Sockets whose flush failed are added to the error
+        // list. Returns how many queues drained.
+        size_t dispatch(std::array<std::vector<std::shared_ptr<S>>, 3> &events) {
+            size_t drained = 0;
+
+            for (auto &s : events[2]) {
+                auto it = this->queues.find(s->fd());
+
+                if (it == this->queues.end())
+                    continue;
+
+                try {
+                    drained += it->second.queue->flush();
+                } catch (const std::runtime_error &) {
+                    if (std::find(events[0].begin(), events[0].end(), s) == events[0].end())
+                        events[0].push_back(s);
+                }
+            }
+
+            return drained;
+        }
+
+        // Poll and flush in one go, see `dispatch`
+        std::array<std::vector<std::shared_ptr<S>>, 3> wait(int timeout = -1) {
+            auto events = this->poll.poll(timeout);
+
+            this->dispatch(events);
+            return events;
+        }
+    };
+} // namespace Sockets
@@ -0,0 +1,180 @@
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <socket/Arena/arena.hpp>
+
+#include "../utility/headers/check.hpp"
+
+using Sockets::SocketHandle;
+
+typedef Sockets::SocketArena<Sockets::TCPSocket> TCPArena;
+
+// A listener in `arena` on a loopback port of its own, see `Check::tcp_pair`
+template <class S>
+SocketHandle listener(Sockets::SocketArena<S> &arena, uint16_t &port) {
+    static uint16_t next = 40000 + getpid() % 20000;
+
+    for (int attempt = 0; attempt < 16; attempt++) {
+        try {
+            port = next++;
+            return arena.service("127.0.0.1", port, Sockets::Domain::IPv4);
+        } catch (const std::runtime_error &) {
+        }
+    }
+
+    throw std::runtime_error("No free port for a listener");
+}
+
+// Whether `a` gets what `b` sends
+bool talks(Sockets::Socket &a, Sockets::Socket &b) {
+    char buf[4];
+
+    b.send("ping", 4);
+    return a.recv(buf, sizeof(buf)) == 4 && std::memcmp(buf, "ping", 4) == 0;
+}
+
+void accept() {
+    TCPArena                  arena;
+    uint16_t                  port;
+    SocketHandle              l = listener(arena, port);
+    std::vector<SocketHandle> accepted;
+
+    SocketHandle a = arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+    SocketHandle b = arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+
+    CHECK(arena.accept(*arena.get(l), accepted, 8) == 2);
+    CHECK(accepted.size() == 2 && arena.size() == 5);
+
+    for (auto &h : accepted)
+        CHECK(arena.contains(h));
+
+    CHECK(talks(*arena.get(accepted[0]), *arena.get(a)));
+    CHECK(talks(*arena.get(b), *arena.get(accepted[1])));
+
+    // Erasing a socket which was closed in its slot leaves the descriptor
+    // alone, by then it belongs to the next connection
+    arena.get(a)->close();
+
+    SocketHandle c = arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+
+    CHECK(arena.accept(*arena.get(l), accepted, 8) == 1);
+
+    arena.erase(a);
+
+    CHECK(talks(*arena.get(accepted[2]), *arena.get(c)));
+}
+
+void handles() {
+    Sockets::SocketArena<Sockets::UDPSocket> arena(3);
+    uint16_t                                 port;
+    SocketHandle                             server = listener(arena, port);
+    Sockets::Peer                            peer;
+    char                                     buf[4];
+
+    SocketHandle client = arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+
+    CHECK(!arena.contains(SocketHandle()));
+    CHECK(arena.size() == 2);
+
+    arena.get(client)->send("ping", 4);
+    CHECK(arena.get(server)->recv_from(buf, sizeof(buf), peer) == 4);
+    CHECK(arena.get(server)->send_to("pong", 4, peer) == 4);
+    CHECK(arena.get(client)->recv(buf, sizeof(buf)) == 4);
+
+    // The freed slot is reused under the next generation, and the old
+    // handle stays stale
+    arena.erase(client);
+    arena.erase(client);
+
+    CHECK(!arena.contains(client) && arena.get(client) == nullptr);
+    CHECK(arena.size() == 1);
+
+    SocketHandle again = arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+
+    CHECK(again.index() == client.index());
+    CHECK(again.generation() == client.generation() + 1);
+    CHECK(!arena.contains(client) && arena.contains(again));
+
+    // Running out of room fails without giving up a slot
+    arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+
+    bool full = false;
+
+    try {
+        arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+    } catch (const std::runtime_error &) {
+        full = true;
+    }
+
+    CHECK(full && arena.size() == 3);
+
+    // Generations wrap around without ever using 0, which marks empty slots
+    for (uint32_t i = 0; i < SocketHandle::max_generation; i++) {
+        SocketHandle old = again;
+
+        arena.erase(again);
+        again = arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+
+        CHECK(again.index() == old.index() && again.generation() != 0);
+        CHECK(!arena.contains(old) && arena.contains(again));
+    }
+
+    CHECK(again.generation() == client.generation() + 1);
+}
+
+void polling() {
+    TCPArena                               arena;
+    Sockets::ArenaPoll<Sockets::TCPSocket> poll(arena);
+    uint16_t                               port;
+    SocketHandle                           l = listener(arena, port);
+    std::vector<SocketHandle>              accepted;
+
+    SocketHandle a = arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+    SocketHandle b = arena.connect("127.0.0.1", port, Sockets::Domain::IPv4);
+
+    CHECK(arena.accept(*arena.get(l), accepted, 8) == 2);
+
+    poll.enroll(accepted[0], POLLIN);
+    poll.enroll(accepted[1], POLLIN);
+
+    CHECK(poll.size() == 2 && poll.enrolled(accepted[1]));
+    CHECK(poll.poll(0)[1].empty());
+
+    arena.get(b)->send("x", 1);
+
+    auto events = poll.poll(2000);
+
+    CHECK(events[1].size() == 1 && events[1][0] == accepted[1]);
+
+    // An erased socket is dropped once it would be reported
+    arena.erase(accepted[0]);
+
+    events = poll.poll(0);
+
+    CHECK(poll.size() == 1 && !poll.enrolled(accepted[0]));
+    CHECK(events[1].size() == 1 && events[1][0] == accepted[1]);
+
+    poll.disenroll(accepted[1]);
+    CHECK(poll.size() == 0);
+
+    bool refused = false;
+
+    try {
+        poll.enroll(accepted[0]);
+    } catch (const std::runtime_error &) {
+        refused = true;
+    }
+
+    CHECK(refused);
+    CHECK(arena.contains(a));
+}
+
+int main() {
+    accept();
+    handles();
+    polling();
+
+    return Check::result("arena");
+}
@@ -0,0 +1,144 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <socket/Async/async.hpp>
+
+#include "../utility/headers/check.hpp"
+
+using std::chrono::milliseconds;
+
+const size_t stream_size = 1024 * 1024;
+
+// A non-blocking listener on a loopback port of its own, see `Check::tcp_pair`
+std::shared_ptr<Sockets::TCPSocket> listener(uint16_t &port) {
+    static uint16_t next = 40000 + getpid() % 20000;
+
+    for (int attempt = 0; attempt < 16; attempt++) {
+        try {
+            port = next++;
+            return Sockets::TCPSocket::service("127.0.0.1", port, Sockets::Domain::IPv4,
+                                               Sockets::Operation::Non_blocking);
+        } catch (const std::runtime_error &) {
+        }
+    }
+
+    throw std::runtime_error("No free port for a listener");
+}
+
+// Accept one connection and send back whatever it sends until it closes
+Sockets::Task<> echo(Sockets::Reactor &r, std::shared_ptr<Sockets::TCPSocket> l, size_t &echoed) {
+    auto conn = co_await Sockets::async_accept(r, l);
+    char buf[4096];
+
+    while (size_t n = co_await Sockets::async_recv(r, conn, buf, sizeof(buf))) {
+        co_await Sockets::async_send(r, conn, buf, n);
+        echoed += n;
+    }
+
+    conn->close();
+}
+
+// More than the socket buffers hold, so the sender has to wait for POLLOUT
+Sockets::Task<> produce(Sockets::Reactor &r, std::shared_ptr<Sockets::TCPSocket> conn,
+                        const std::string &out) {
+    size_t sent = co_await Sockets::async_send(r, conn, out.data(), out.size());
+
+    CHECK(sent == out.size());
+}
+
+Sockets::Task<> consume(Sockets::Reactor &r, std::shared_ptr<Sockets::TCPSocket> conn,
+                        std::string &in) {
+    char buf[4096];
+
+    while (in.size() < stream_size) {
+        size_t n = co_await Sockets::async_recv(r, conn, buf, sizeof(buf));
+
+        if (!n)
+            break;
+
+        in.append(buf, n);
+    }
+
+    conn->close();
+}
+
+Sockets::Task<> client(Sockets::Reactor &r, uint16_t port, const std::string &out,
+                       std::string &in) {
+    auto conn = co_await Sockets::async_connect(r, "127.0.0.1", port, Sockets::Domain::IPv4);
+
+    // Reading and writing the same socket from two tasks at once
+    r.spawn(produce(r, conn, out));
+    co_await consume(r, conn, in);
+}
+
+Sockets::Task<> nap(Sockets::Reactor &r, milliseconds delay, std::chrono::nanoseconds &slept) {
+    auto start = std::chrono::steady_clock::now();
+
+    co_await Sockets::async_sleep(r, delay);
+    slept = std::chrono::steady_clock::now() - start;
+}
+
+// Accept, connect, a stream echoed both ways and a sleep, all on one reactor
+void round_trip() {
+    Sockets::Reactor         r;
+    uint16_t                 port;
+    auto                     l = listener(port);
+    std::string              out(stream_size, '\0');
+    std::string              in;
+    size_t                   echoed = 0;
+    std::chrono::nanoseconds slept(0);
+
+    for (size_t i = 0; i < out.size(); i++)
+        out[i] = static_cast<char>(i * 7 + i / 1000);
+
+    r.spawn(echo(r, l, echoed));
+    r.spawn(client(r, port, out, in));
+    r.spawn(nap(r, milliseconds(20), slept));
+
+    CHECK(r.pending() == 3);
+
+    r.run();
+
+    CHECK(r.pending() == 0);
+    CHECK(echoed == out.size());
+    CHECK(in == out);
+
+    // The wheel counts whole ticks of 1 ms from the start of the current
+    // one, so the sleep may come up to a tick short
+    CHECK(slept >= milliseconds(19));
+}
+
+Sockets::Task<> wait_for_nothing(Sockets::Reactor &r, std::shared_ptr<Sockets::TCPSocket> conn,
+                                 bool &timed_out) {
+    char buf[16];
+
+    try {
+        co_await Sockets::async_recv(r, conn, buf, sizeof(buf)).within(milliseconds(20));
+    } catch (const Sockets::timeout_error &) {
+        timed_out = true;
+    }
+}
+
+// A deadline abandons a receive nothing arrives for, and the reactor lets go
+// of the socket
+void deadline() {
+    Sockets::Reactor r;
+    auto             pair      = Check::tcp_pair(Sockets::Operation::Non_blocking);
+    bool             timed_out = false;
+    auto             start     = std::chrono::steady_clock::now();
+
+    r.spawn(wait_for_nothing(r, pair.second, timed_out));
+    r.run();
+
+    CHECK(timed_out);
+    CHECK(std::chrono::steady_clock::now() - start >= milliseconds(19));
+    CHECK(!r.run_once(0));
+}
+
+int main() {
+    round_trip();
+    deadline();
+
+    return Check::result("async");
+}
@@ -0,0 +1,181 @@
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <socket/Framing/framing.hpp>
+
+#include "../utility/headers/check.hpp"
+
+using Sockets::Frame;
+
+// Send `s` and give the loopback a moment to deliver it, so that the next
+// call of a non-blocking reader sees all of it
+void deliver(Sockets::TCPSocket &sock, const std::string &s) {
+    sock.send(s.data(), s.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+void frames_split(Sockets::Prefix prefix) {
+    auto                 pair = Check::tcp_pair(Sockets::Operation::Non_blocking);
+    Sockets::FrameCodec  codec(prefix);
+    Sockets::FrameReader reader(pair.second, codec, 256);
+    std::string          payload(1000, '\0');
+    char                 header[Sockets::FrameCodec::max_header];
+    size_t               len;
+    Frame                frame;
+
+    for (size_t i = 0; i < payload.size(); i++)
+        payload[i] = static_cast<char>('a' + i % 26);
+
+    std::string wire(header, codec.encode(payload.size(), header));
+
+    wire += payload;
+    wire.append(header, codec.encode(3, header));
+    wire += "end";
+
+    // The first byte of the header, then the rest of it
+    deliver(*pair.first, wire.substr(0, 1));
+    CHECK(!reader.next(frame));
+
+    size_t hlen = codec.decode(wire.data(), wire.size(), len);
+
+    deliver(*pair.first, wire.substr(1, hlen - 1));
+    CHECK(!reader.next(frame));
+
+    // Part of the payload, which outgrows the initial buffer
+    deliver(*pair.first, wire.substr(hlen, 600));
+    CHECK(!reader.next(frame));
+
+    // The rest of it and the whole next frame in one read
+    deliver(*pair.first, wire.substr(hlen + 600));
+
+    CHECK(Check::eventually([&]() { return reader.next(frame); }));
+    CHECK(frame.str() == payload);
+    CHECK(reader.next(frame));
+    CHECK(frame.str() == "end");
+    CHECK(!reader.next(frame));
+    CHECK(reader.buffered() == 0);
+
+    // The end of the connection is only reported once the frames before it
+    // were handed out
+    pair.first->close();
+    CHECK(Check::eventually([&]() { return !reader.next(frame) && reader.closed(); }));
+}
+
+void frames_blocking() {
+    auto                 pair = Check::tcp_pair();
+    Sockets::FrameWriter writer(pair.first);
+    Sockets::FrameReader reader(pair.second);
+    Frame                frame;
+
+    std::thread producer([&]() {
+        Sockets::FrameCodec codec;
+        std::string         wire;
+        char                header[Sockets::FrameCodec::max_header];
+
+        // Trickle a frame in so the blocking reader has to wait for every
+        // part of it
+        wire.append(header, codec.encode(5, header));
+        wire += "hello";
+
+        for (char c : wire) {
+            pair.first->send(&c, 1);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        writer.write("world");
+    });
+
+    CHECK(reader.next(frame) && frame.str() == "hello");
+    CHECK(reader.next(frame) && frame.str() == "world");
+
+    producer.join();
+}
+
+void frames_oversized() {
+    auto                 pair = Check::tcp_pair();
+    Sockets::FrameCodec  codec(Sockets::Prefix::Fixed32, 100);
+    Sockets::FrameReader reader(pair.second, codec);
+    char                 header[Sockets::FrameCodec::max_header];
+    Frame                frame;
+    bool                 refused = false;
+
+    // Encoded with a codec which permits it, the reader's does not
+    Sockets::FrameCodec loose(Sockets::Prefix::Fixed32);
+
+    pair.first->send(header, loose.encode(101, header));
+
+    try {
+        reader.next(frame);
+    } catch (const Sockets::frame_error &) {
+        refused = true;
+    }
+
+    CHECK(refused);
+}
+
+void lines_split() {
+    auto                pair = Check::tcp_pair(Sockets::Operation::Non_blocking);
+    Sockets::LineReader reader(pair.second, Sockets::LineEnding::LF, 1024, 16);
+    Frame               line;
+
+    deliver(*pair.first, "hel");
+    CHECK(!reader.next(line));
+
+    // The carriage return arrives apart from its line feed
+    deliver(*pair.first, "lo\r");
+    CHECK(!reader.next(line));
+
+    deliver(*pair.first, "\nwor");
+    CHECK(reader.next(line) && line.str() == "hello");
+    CHECK(!reader.next(line));
+    CHECK(reader.buffered() == 3);
+
+    // Longer than the initial buffer and split across three reads
+    std::string long_line(40, 'x');
+
+    deliver(*pair.first, "ld\n" + long_line.substr(0, 20));
+    CHECK(reader.next(line) && line.str() == "world");
+    CHECK(!reader.next(line));
+
+    deliver(*pair.first, long_line.substr(20));
+    CHECK(!reader.next(line));
+
+    deliver(*pair.first, "\n\n");
+    CHECK(reader.next(line) && line.str() == long_line);
+    CHECK(reader.next(line) && line.size == 0);
+    CHECK(!reader.next(line));
+
+    // An unterminated last line is held back
+    deliver(*pair.first, "tail");
+    pair.first->close();
+
+    CHECK(Check::eventually([&]() { return !reader.next(line) && reader.closed(); }));
+    CHECK(reader.buffered() == 4);
+}
+
+void lines_crlf() {
+    auto                pair = Check::tcp_pair(Sockets::Operation::Non_blocking);
+    Sockets::LineReader reader(pair.second, Sockets::LineEnding::CRLF);
+    Frame               line;
+
+    deliver(*pair.first, "a\nb\r");
+    CHECK(!reader.next(line));
+
+    deliver(*pair.first, "\nc\r\n");
+    CHECK(reader.next(line) && line.str() == "a\nb");
+    CHECK(reader.next(line) && line.str() == "c");
+    CHECK(!reader.next(line));
+}
+
+int main() {
+    frames_split(Sockets::Prefix::Varint);
+    frames_split(Sockets::Prefix::Fixed16);
+    frames_split(Sockets::Prefix::Fixed32);
+    frames_blocking();
+    frames_oversized();
+    lines_split();
+    lines_crlf();
+
+    return Check::result("framing");
+}
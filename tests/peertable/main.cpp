@@ -0,0 +1,131 @@
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <socket/PeerTable/peertable.hpp>
+
+#include "../utility/headers/check.hpp"
+
+// IPv4 peer number `n`, spread over a few addresses and ports
+Sockets::Peer ipv4(uint32_t n) {
+    Sockets::Peer peer;
+    sockaddr_in   sin;
+
+    std::memset(&peer.addr, 0, sizeof(peer.addr));
+    std::memset(&sin, 0, sizeof(sin));
+    sin.sin_family      = AF_INET;
+    sin.sin_port        = htons(10000 + n % 500);
+    sin.sin_addr.s_addr = htonl(0x7f000001 + n / 500);
+
+    std::memcpy(&peer.addr, &sin, sizeof(sin));
+    peer.len = sizeof(sin);
+    return peer;
+}
+
+Sockets::Peer ipv6(uint32_t n) {
+    Sockets::Peer peer;
+    sockaddr_in6  sin6;
+
+    std::memset(&peer.addr, 0, sizeof(peer.addr));
+    std::memset(&sin6, 0, sizeof(sin6));
+    sin6.sin6_family           = AF_INET6;
+    sin6.sin6_port             = htons(10000 + n);
+    sin6.sin6_addr.s6_addr[15] = 1;
+
+    std::memcpy(&peer.addr, &sin6, sizeof(sin6));
+    peer.len = sizeof(sin6);
+    return peer;
+}
+
+void basics() {
+    Sockets::PeerTable<int> table;
+
+    CHECK(table.empty());
+    CHECK(table.find(ipv4(1)) == nullptr);
+
+    auto first = table.emplace(ipv4(1), 10);
+
+    CHECK(first.second && *first.first == 10);
+    CHECK(!table.emplace(ipv4(1), 20).second);
+    CHECK(*table.find(ipv4(1)) == 10);
+
+    // Same port on another family is another peer
+    CHECK(table.emplace(ipv6(1), 30).second);
+    CHECK(table.size() == 2);
+
+    CHECK(table.erase(ipv4(1)));
+    CHECK(!table.erase(ipv4(1)));
+    CHECK(table.find(ipv4(1)) == nullptr);
+    CHECK(*table.find(ipv6(1)) == 30);
+    CHECK(table.size() == 1);
+}
+
+// Random inserts and erasures against a `std::map`. The pool of peers is
+// small against the number of operations, so probe sequences wrap around
+// the end of the table and erasure keeps shifting entries into the holes.
+void erase_model() {
+    Sockets::PeerTable<uint32_t> table;
+    std::map<uint32_t, uint32_t> model;
+    std::mt19937                 rng(42);
+    std::vector<Sockets::Peer>   peers;
+
+    for (uint32_t i = 0; i < 200; i++)
+        peers.push_back(i % 4 ? ipv4(i * 7919) : ipv6(i));
+
+    for (uint32_t op = 0; op < 50000; op++) {
+        uint32_t n = rng() % peers.size();
+
+        if (rng() % 2) {
+            bool created = table.emplace(peers[n], op).second;
+
+            CHECK(created == (model.find(n) == model.end()));
+
+            if (created)
+                model[n] = op;
+        } else {
+            CHECK(table.erase(peers[n]) == (model.erase(n) == 1));
+        }
+
+        if (op % 1000)
+            continue;
+
+        CHECK(table.size() == model.size());
+
+        for (uint32_t i = 0; i < peers.size(); i++) {
+            uint32_t *value = table.find(peers[i]);
+            auto      it    = model.find(i);
+
+            CHECK((value != nullptr) == (it != model.end()));
+
+            if (value && it != model.end())
+                CHECK(*value == it->second);
+        }
+    }
+
+    size_t visited = 0;
+
+    table.for_each([&](const Sockets::Peer &, uint32_t &) { visited++; });
+
+    CHECK(visited == model.size());
+
+    // Draining the table leaves every peer unreachable
+    for (auto &it : model)
+        CHECK(table.erase(peers[it.first]));
+
+    CHECK(table.empty());
+
+    for (auto &peer : peers)
+        CHECK(table.find(peer) == nullptr);
+}
+
+int main() {
+    basics();
+    erase_model();
+
+    return Check::result("peertable");
+}
@@ -0,0 +1,309 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <socket/Polling/polling.hpp>
+#include <socket/Socket/socket.hpp>
+
+#include "../utility/headers/check.hpp"
+
+typedef std::pair<std::shared_ptr<Sockets::ShmSocket>, std::shared_ptr<Sockets::ShmSocket>> Pair;
+
+// A connected pair, the client first and the accepted end second
+Pair shm_pair(Sockets::Operation op = Sockets::Operation::Blocking, size_t capacity = 4096) {
+    std::string path = "/tmp/sockets_test_shm_" + std::to_string(getpid());
+
+    auto listener = Sockets::ShmSocket::service(path, Sockets::Operation::Blocking, 1, capacity);
+    auto accepted = std::async(std::launch::async, [&]() { return listener->accept(op); });
+    auto client   = Sockets::ShmSocket::connect(path, op);
+
+    Pair pair(client, accepted.get());
+
+    listener->close();
+    return pair;
+}
+
+// A receiver asleep on an empty ring is woken up by the first byte
+void wake_reader() {
+    Pair                     pair = shm_pair();
+    std::string              got(5, '\0');
+    std::chrono::nanoseconds waited;
+
+    std::thread reader([&]() {
+        auto start = std::chrono::steady_clock::now();
+
+        pair.second->recv(&got[0], got.size());
+        waited = std::chrono::steady_clock::now() - start;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pair.first->send("hello", 5);
+    reader.join();
+
+    CHECK(got == "hello");
+    CHECK(waited >= std::chrono::milliseconds(10));
+}
+
+// A sender asleep on a full ring is woken up as the receiver drains it,
+// and the stream survives wrapping around the ring many times
+void wake_writer() {
+    Pair        pair = shm_pair();
+    std::string out(1024 * 1024, '\0');
+    std::string in(out.size(), '\0');
+
+    for (size_t i = 0; i < out.size(); i++)
+        out[i] = static_cast<char>(i * 31 + i / 4096);
+
+    std::thread writer([&]() { pair.first->send(out.data(), out.size()); });
+
+    CHECK(pair.second->recv(&in[0], in.size()) == in.size());
+    writer.join();
+
+    CHECK(in == out);
+}
+
+// A non-blocking socket reports EAGAIN on an empty ring, and its descriptor
+// turns readable once data arrives
+void poll_wakeup() {
+    Pair pair = shm_pair(Sockets::Operation::Non_blocking);
+    char buf[16];
+
+    CHECK(pair.second->recv(buf, sizeof(buf)) == 0 && errno == EAGAIN);
+
+    struct pollfd fd = {pair.second->fd(), POLLIN, 0};
+
+    CHECK(::poll(&fd, 1, 0) == 0);
+
+    std::thread writer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pair.first->send("ping", 4);
+    });
+
+    CHECK(::poll(&fd, 1, 2000) == 1 && (fd.revents & POLLIN));
+    CHECK(pair.second->recv(buf, sizeof(buf)) == 4);
+    writer.join();
+
+    // Consuming the data consumes the wakeup as well
+    CHECK(::poll(&fd, 1, 0) == 0);
+
+    // Reading part of it leaves the descriptor readable, and one which was
+    // emptied still wakes up for the next data
+    std::string part(1000, 'p');
+
+    CHECK(pair.first->send(part.data(), part.size()) == part.size());
+    CHECK(::poll(&fd, 1, 2000) == 1);
+    CHECK(pair.second->recv(&part[0], 100) == 100);
+    CHECK(::poll(&fd, 1, 200) == 1 && (fd.revents & POLLIN));
+    CHECK(pair.second->recv(&part[0], part.size()) == 900);
+    CHECK(::poll(&fd, 1, 0) == 0);
+
+    pair.first->send("pong", 4);
+    CHECK(::poll(&fd, 1, 2000) == 1);
+    CHECK(pair.second->recv(buf, sizeof(buf)) == 4);
+    CHECK(::poll(&fd, 1, 0) == 0);
+
+    // So does a full ring for the sender, which turns writable again once
+    // the receiver made room
+    std::string big(8192, 'x');
+
+    CHECK(pair.first->send(big.data(), big.size()) == 4096);
+    CHECK(pair.first->send(big.data(), big.size()) == 0 && errno == EAGAIN);
+
+    struct pollfd wfd = {pair.first->fd(), POLLIN, 0};
+
+    CHECK(::poll(&wfd, 1, 0) == 0);
+    CHECK(pair.second->recv(&big[0], 1000) == 1000);
+    CHECK(::poll(&wfd, 1, 2000) == 1);
+    CHECK(pair.first->send(big.data(), big.size()) == 1000);
+}
+
+// Data written before a close is still delivered, then the end is reported.
+// Writing to a closed peer fails instead of blocking.
+void hangup() {
+    Pair pair = shm_pair();
+    char buf[16];
+
+    pair.first->send("bye", 3);
+    pair.first->close();
+
+    CHECK(pair.second->recv(buf, sizeof(buf)) == 3);
+    CHECK(pair.second->recv(buf, sizeof(buf)) == 0);
+
+    bool refused = false;
+
+    try {
+        pair.second->send("x", 1);
+    } catch (const std::runtime_error &) {
+        refused = true;
+    }
+
+    CHECK(refused);
+
+    // A reader asleep when the peer goes away wakes up
+    Pair        other = shm_pair();
+    std::thread closer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        other.first->close();
+    });
+
+    CHECK(other.second->recv(buf, sizeof(buf)) == 0);
+    closer.join();
+}
+
+// A spinning `Poll` takes shared memory sockets, and closing one through
+// the base class releases the rings so the peer sees the end
+void base_calls() {
+    Pair                              pair = shm_pair(Sockets::Operation::Non_blocking);
+    Sockets::Poll<Sockets::ShmSocket> poll;
+    char                              buf[16];
+
+    poll.spin(std::chrono::microseconds(50));
+    poll.enroll(pair.second, POLLIN);
+
+    pair.first->send("x", 1);
+
+    CHECK(poll.poll(2000)[1].size() == 1);
+    CHECK(pair.second->recv(buf, sizeof(buf)) == 1);
+
+    // Room in the ring is reported as `POLLOUT`, although the descriptor
+    // itself only ever polls readable
+    std::string big(8192, 'x');
+
+    poll.enroll(pair.first, POLLOUT);
+
+    CHECK(pair.first->send(big.data(), big.size()) == 4096);
+    CHECK(pair.first->send(big.data(), big.size()) == 0 && errno == EAGAIN);
+    CHECK(poll.poll(0)[2].empty());
+
+    auto events = poll.poll(2000);
+
+    CHECK(events[1].size() == 1 && events[1][0] == pair.second);
+    CHECK(events[2].empty());
+    CHECK(pair.second->recv(&big[0], 1000) == 1000);
+
+    events = poll.poll(2000);
+
+    CHECK(events[2].size() == 1 && events[2][0] == pair.first);
+    CHECK(pair.first->send(big.data(), big.size()) == 1000);
+    CHECK(pair.second->recv(&big[0], big.size()) == 4096);
+
+    poll.disenroll(pair.first);
+
+    Sockets::Socket &base = *pair.first;
+
+    base.close();
+
+    CHECK(pair.second->recv(buf, sizeof(buf)) == 0 && errno != EAGAIN);
+}
+
+// Start of the first mapping of a ring in this process, both ends of a pair
+// map the same memory
+volatile uint64_t *mapped_ring() {
+    std::ifstream maps("/proc/self/maps");
+    std::string   line;
+
+    while (std::getline(maps, line))
+        if (line.find("memfd:ShmSocket") != std::string::npos)
+            return reinterpret_cast<volatile uint64_t *>(std::stoull(line, nullptr, 16));
+
+    return nullptr;
+}
+
+// A peer moving the head of a ring past what the ring can hold is refused
+// and the socket is closed, instead of copying from beyond the ring
+void corrupt_head() {
+    Pair                pair = shm_pair();
+    volatile uint64_t * head = mapped_ring();
+    char                buf[16];
+    bool                refused = false;
+
+    CHECK(head != nullptr);
+
+    if (!head)
+        return;
+
+    // The head of the listener's sending ring comes first in the mapping
+    pair.second->send("ok", 2);
+    CHECK(pair.first->recv(buf, 2) == 2);
+
+    *head = uint64_t(1) << 40;
+
+    try {
+        pair.first->recv(buf, sizeof(buf));
+    } catch (const std::runtime_error &) {
+        refused = true;
+    }
+
+    CHECK(refused && errno == EPROTO);
+
+    refused = false;
+
+    try {
+        pair.first->recv(buf, sizeof(buf));
+    } catch (const std::runtime_error &) {
+        refused = true;
+    }
+
+    CHECK(refused);
+}
+
+// A second listener cannot take the path of a live one, but takes over the
+// path of one which died without removing it. Closing removes the path.
+void paths() {
+    std::string path = "/tmp/sockets_test_shm_path_" + std::to_string(getpid());
+    struct stat st;
+    bool        refused = false;
+
+    auto listener = Sockets::ShmSocket::service(path);
+
+    try {
+        Sockets::ShmSocket::service(path);
+    } catch (const std::runtime_error &) {
+        refused = true;
+    }
+
+    CHECK(refused);
+
+    listener->close();
+    CHECK(stat(path.c_str(), &st) != 0);
+
+    // What a crashed listener leaves behind, a socket file nobody accepts on
+    sockaddr_un sun;
+    int         fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    std::memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    std::memcpy(sun.sun_path, path.c_str(), path.size());
+
+    CHECK(bind(fd, (struct sockaddr *)&sun, sizeof(sun)) == 0);
+    ::close(fd);
+
+    listener = Sockets::ShmSocket::service(path);
+    CHECK(stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode));
+
+    listener.reset();
+    CHECK(stat(path.c_str(), &st) != 0);
+}
+
+int main() {
+    wake_reader();
+    wake_writer();
+    poll_wakeup();
+    hangup();
+    base_calls();
+    corrupt_head();
+    paths();
+
+    return Check::result("shm");
+}
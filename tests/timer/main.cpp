@@ -0,0 +1,123 @@
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <socket/Timer/timerwheel.hpp>
+
+#include "../utility/headers/check.hpp"
+
+using std::chrono::milliseconds;
+
+// Timers are armed relative to the clock, but the wheel only turns when it
+// is advanced, so every check below feeds it explicit times well clear of
+// the expiry to stay independent of scheduling delays.
+const uint64_t ms = 1000000;
+
+void expiry() {
+    uint64_t            origin = Sockets::now_ns();
+    Sockets::TimerWheel wheel(milliseconds(1), origin);
+    std::vector<int>    fired;
+    Sockets::Timer      a([&fired]() { fired.push_back(1); });
+    Sockets::Timer      b([&fired]() { fired.push_back(2); });
+    Sockets::Timer      c([&fired]() { fired.push_back(3); });
+
+    wheel.schedule(a, milliseconds(50));
+    wheel.schedule(b, milliseconds(10));
+    wheel.schedule(c, milliseconds(5000));
+
+    CHECK(wheel.size() == 3);
+    CHECK(a.armed() && b.armed() && c.armed());
+
+    CHECK(wheel.advance(origin + 5 * ms) == 0);
+    CHECK(wheel.advance(origin + 30 * ms) == 1);
+    CHECK(fired == std::vector<int>({2}));
+    CHECK(!b.armed());
+
+    // Skipping far ahead fires everything in between in one call, across
+    // the cascade from the second level
+    CHECK(wheel.advance(origin + 4000 * ms) == 1);
+    CHECK(wheel.advance(origin + 6000 * ms) == 1);
+    CHECK(fired == std::vector<int>({2, 1, 3}));
+    CHECK(wheel.size() == 0);
+    CHECK(wheel.timeout(7) == 7);
+}
+
+void cancel() {
+    uint64_t            origin = Sockets::now_ns();
+    Sockets::TimerWheel wheel(milliseconds(1), origin);
+    int                 fired = 0;
+    Sockets::Timer      a([&fired]() { fired++; });
+
+    wheel.schedule(a, milliseconds(10));
+    a.cancel();
+
+    CHECK(!a.armed());
+    CHECK(wheel.size() == 0);
+
+    {
+        Sockets::Timer b([&fired]() { fired++; });
+        wheel.schedule(b, milliseconds(10));
+        CHECK(wheel.size() == 1);
+    }
+
+    // Destroying an armed timer takes it off the wheel
+    CHECK(wheel.size() == 0);
+
+    // Re-arming moves the timer instead of adding it twice
+    wheel.schedule(a, milliseconds(10));
+    wheel.schedule(a, milliseconds(200));
+
+    CHECK(wheel.size() == 1);
+    CHECK(wheel.advance(origin + 100 * ms) == 0);
+    CHECK(wheel.advance(origin + 300 * ms) == 1);
+    CHECK(fired == 1);
+}
+
+void far_out() {
+    uint64_t            origin = Sockets::now_ns();
+    Sockets::TimerWheel wheel(milliseconds(1), origin);
+    int                 fired = 0;
+    Sockets::Timer      a([&fired]() { fired++; });
+
+    // Beyond the 2^24 ticks the four levels cover, parked and placed again
+    // on the way
+    wheel.schedule(a, milliseconds(20000000));
+
+    CHECK(wheel.advance(origin + 16777000 * ms) == 0);
+    CHECK(wheel.advance(origin + 19999000 * ms) == 0);
+    CHECK(a.armed());
+    CHECK(wheel.advance(origin + 20001000 * ms) == 1);
+    CHECK(fired == 1);
+}
+
+void rearm() {
+    uint64_t            origin = Sockets::now_ns();
+    Sockets::TimerWheel wheel(milliseconds(1), origin);
+    int                 fired = 0;
+    Sockets::Timer      a;
+
+    // A timer armed again from its own callback waits for the next advance
+    a.callback = [&]() {
+        fired++;
+        wheel.schedule(a, milliseconds(0));
+    };
+
+    wheel.schedule(a, milliseconds(10));
+
+    CHECK(wheel.advance(origin + 50 * ms) == 1);
+    CHECK(a.armed());
+    CHECK(wheel.timeout(100) == 0);
+    CHECK(wheel.advance(origin + 60 * ms) == 1);
+    CHECK(fired == 2);
+
+    a.cancel();
+}
+
+int main() {
+    expiry();
+    cancel();
+    far_out();
+    rearm();
+
+    return Check::result("timer");
+}
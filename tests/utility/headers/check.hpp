@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <unistd.h>
+
+#include <socket/Socket/socket.hpp>
+
+// Record a failure, with the expression and where it is, if `expr` is false.
+// The test carries on so that one run reports every broken check.
+#define CHECK(expr) Check::expect(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+
+namespace Check {
+
+    int failures = 0;
+
+    void expect(bool ok, const char *expr, const char *file, int line) {
+        if (ok)
+            return;
+
+        failures++;
+        std::cerr << file << ":" << line << ": check failed: " << expr << std::endl;
+    }
+
+    // Exit status for `main`, after a summary line for the test log
+    int result(const std::string &name) {
+        if (failures)
+            std::cout << name << ": " << failures << " checks failed" << std::endl;
+        else
+            std::cout << name << ": passed" << std::endl;
+
+        return failures ? 1 : 0;
+    }
+
+    // Poll `ready` for up to `timeout`, for things which happen on another
+    // thread or in the kernel
+    template <class F>
+    bool eventually(F ready, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000)) {
+        auto end = std::chrono::steady_clock::now() + timeout;
+
+        while (!ready()) {
+            if (std::chrono::steady_clock::now() > end)
+                return false;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return true;
+    }
+
+    // A connected pair over the loopback interface, the client first and the
+    // accepted end second. Listeners do not set SO_REUSEADDR, so every pair
+    // takes a port of its own and runs of the same test start at different
+    // ports to stay clear of connections still in TIME_WAIT.
+    std::pair<std::shared_ptr<Sockets::TCPSocket>, std::shared_ptr<Sockets::TCPSocket>>
+    tcp_pair(Sockets::Operation op = Sockets::Operation::Blocking) {
+        static uint16_t port = 20000 + getpid() % 20000;
+
+        for (int attempt = 0; attempt < 16; attempt++) {
+            std::shared_ptr<Sockets::TCPSocket> listener;
+
+            try {
+                listener = Sockets::TCPSocket::service("127.0.0.1", port++, Sockets::Domain::IPv4);
+            } catch (const std::runtime_error &) {
+                continue;
+            }
+
+            auto client = Sockets::TCPSocket::connect("127.0.0.1", port - 1, Sockets::Domain::IPv4);
+
+            return std::make_pair(client, listener->accept(op));
+        }
+
+        throw std::runtime_error("No free port for a loopback connection");
+    }
+} // namespace Check
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <socket/WriteQueue/fanout.hpp>
+#include <socket/WriteQueue/writequeue.hpp>
+
+#include "../utility/headers/check.hpp"
+
+typedef std::pair<std::shared_ptr<Sockets::TCPSocket>, std::shared_ptr<Sockets::TCPSocket>> Pair;
+
+const size_t message_size = 1000;
+
+// Accepted end non-blocking, and both ends with small buffers so that the
+// kernel stops taking data after a few kilobytes
+Pair small_pair() {
+    Pair pair = Check::tcp_pair(Sockets::Operation::Non_blocking);
+    int  size = 4096;
+
+    setsockopt(pair.first->fd(), SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(pair.second->fd(), SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    return pair;
+}
+
+// Message `seq`, every byte of it holding the sequence number
+std::shared_ptr<const std::string> message(size_t seq) {
+    return std::make_shared<const std::string>(message_size, static_cast<char>(seq));
+}
+
+// Read whole messages off `sock` until it closes and return their sequence
+// numbers, or -1 for a message which is not uniform
+std::vector<int> receive(Sockets::TCPSocket &sock) {
+    std::vector<int> seqs;
+    std::string      buf(message_size, '\0');
+
+    while (sock.recv(&buf[0], buf.size()) == buf.size()) {
+        bool uniform = std::count(buf.begin(), buf.end(), buf[0]) == (long)buf.size();
+        seqs.push_back(uniform ? static_cast<unsigned char>(buf[0]) : -1);
+    }
+
+    return seqs;
+}
+
+void watermarks() {
+    Pair                pair = small_pair();
+    Sockets::WriteQueue queue(pair.second, 64 * 1024, 16 * 1024);
+    int                 highs = 0;
+    int                 lows  = 0;
+    std::vector<bool>   interest;
+    size_t              sent = 0;
+
+    queue.on_high     = [&highs]() { highs++; };
+    queue.on_low      = [&lows]() { lows++; };
+    queue.on_interest = [&interest](bool on) { interest.push_back(on); };
+
+    // Copied writes until the peer, which is not reading, holds it up
+    while (!queue.throttled() && sent < 10000) {
+        auto m = message(sent++);
+        queue.write(m->data(), m->size());
+    }
+
+    CHECK(queue.throttled());
+    CHECK(highs == 1 && lows == 0);
+    CHECK(queue.pending() >= 64 * 1024);
+    CHECK(interest == std::vector<bool>({true}));
+
+    // Shared buffers queue behind the copies
+    for (int i = 0; i < 4; i++)
+        queue.write(message(sent++));
+
+    std::vector<int> seqs;
+    std::thread      reader([&]() { seqs = receive(*pair.first); });
+
+    CHECK(Check::eventually([&]() { return queue.flush(); }));
+
+    CHECK(queue.empty() && !queue.throttled());
+    CHECK(highs == 1 && lows == 1);
+    CHECK(interest == std::vector<bool>({true, false}));
+
+    pair.second->close();
+    reader.join();
+
+    CHECK(seqs.size() == sent);
+
+    for (size_t i = 0; i < seqs.size(); i++)
+        CHECK(seqs[i] == static_cast<unsigned char>(i));
+}
+
+// One subscriber reading along and one which never reads. The silent one
+// is left waiting on POLLOUT and goes over the limit, the other one is
+// given the time to keep up.
+void fanout(Sockets::SlowConsumer policy) {
+    Pair              fast = Check::tcp_pair(Sockets::Operation::Non_blocking);
+    Pair              slow = small_pair();
+    Sockets::FanOut   fanout(policy, 32 * 1024);
+    std::vector<int>  seqs;
+    std::vector<bool> evicted;
+    std::thread       reader([&]() { seqs = receive(*fast.first); });
+    size_t            published = 0;
+
+    fanout.on_evict = [&](const std::shared_ptr<Sockets::TCPSocket> &sock, bool slow_consumer) {
+        CHECK(sock == slow.second);
+        evicted.push_back(slow_consumer);
+    };
+
+    fanout.subscribe(fast.second);
+    fanout.subscribe(slow.second);
+
+    while (published < 500) {
+        fanout.publish(message(published++));
+        fanout.flush();
+
+        // Stand in for the poller, but only ever for the reading subscriber
+        Check::eventually([&]() {
+            return fanout.ready(fast.second) || fanout.pending(fast.second) < 8 * 1024;
+        });
+    }
+
+    CHECK(Check::eventually([&]() { return fanout.ready(fast.second); }));
+    CHECK(fanout.pending(fast.second) == 0);
+
+    const Sockets::FanOutStatistics &stats = fanout.statistics();
+
+    CHECK(stats.published == published);
+
+    if (policy == Sockets::SlowConsumer::Evict) {
+        CHECK(evicted == std::vector<bool>({true}));
+        CHECK(stats.evicted == 1 && stats.skipped == 0);
+        CHECK(fanout.size() == 1);
+        CHECK(fanout.pending(slow.second) == 0);
+    } else {
+        CHECK(evicted.empty());
+        CHECK(stats.skipped > 0);
+        CHECK(stats.queued + stats.skipped == 2 * published);
+        CHECK(fanout.size() == 2);
+    }
+
+    fast.second->close();
+    reader.join();
+
+    // The subscriber keeping up misses nothing
+    CHECK(seqs.size() == published);
+
+    for (size_t i = 0; i < seqs.size(); i++)
+        CHECK(seqs[i] == static_cast<unsigned char>(i));
+
+    if (policy == Sockets::SlowConsumer::Skip) {
+        // The silent subscriber gets whole messages with gaps once it reads
+        fanout.unsubscribe(slow.second);
+        slow.second->close();
+
+        std::vector<int> got = receive(*slow.first);
+
+        CHECK(!got.empty() && got.size() < published);
+        CHECK(std::find(got.begin(), got.end(), -1) == got.end());
+    }
+}
+
+// A subscriber whose peer closed is evicted by the failed write, without
+// the process being killed by SIGPIPE
+void disconnected() {
+    Pair              pair = Check::tcp_pair(Sockets::Operation::Non_blocking);
+    Sockets::FanOut   fanout(Sockets::SlowConsumer::Evict);
+    std::vector<bool> evicted;
+    size_t            published = 0;
+
+    fanout.on_evict = [&](const std::shared_ptr<Sockets::TCPSocket> &sock, bool slow) {
+        CHECK(sock == pair.second);
+        evicted.push_back(slow);
+    };
+
+    fanout.subscribe(pair.second);
+    pair.first->close();
+
+    // The first writes after the close still succeed, the reset the peer
+    // answers them with fails the ones after that
+    CHECK(Check::eventually([&]() {
+        fanout.publish(message(published++));
+        fanout.flush();
+        return !evicted.empty();
+    }));
+
+    CHECK(evicted == std::vector<bool>({false}));
+    CHECK(fanout.size() == 0);
+    CHECK(fanout.statistics().evicted == 1);
+}
+
+// The poll result flushes a queue on POLLOUT, and the socket is only polled
+// for it while data is pending
+void dispatch() {
+    Pair                                       pair = small_pair();
+    Sockets::Poll<Sockets::TCPSocket>          poll;
+    Sockets::WriteDispatch<Sockets::TCPSocket> writers(poll);
+    Sockets::WriteQueue                        queue(pair.second);
+    size_t                                     sent = 0;
+
+    writers.watch(queue, pair.second);
+
+    while (queue.empty())
+        queue.write(message(sent++));
+
+    std::vector<int> seqs;
+    std::thread      reader([&]() { seqs = receive(*pair.first); });
+
+    CHECK(Check::eventually([&]() {
+        auto events = writers.wait(10);
+        return events[0].empty() && queue.empty();
+    }));
+
+    // Nothing is pending any more, so nothing reports the socket writable
+    CHECK(writers.wait(0)[2].empty());
+
+    writers.forget(pair.second);
+    CHECK(!poll.enrolled(pair.second));
+
+    pair.second->close();
+    reader.join();
+
+    CHECK(seqs.size() == sent);
+}
+
+// Sockets closed before they are let go of are still found, although they
+// no longer know their descriptor
+void closed_first() {
+    Pair                                       pair  = Check::tcp_pair();
+    Pair                                       other = Check::tcp_pair();
+    Sockets::Poll<Sockets::TCPSocket>          poll;
+    Sockets::WriteDispatch<Sockets::TCPSocket> writers(poll);
+    Sockets::WriteQueue                        queue(pair.second);
+    Sockets::FanOut                            fanout;
+
+    writers.watch(queue, pair.second);
+    fanout.subscribe(pair.second);
+    fanout.subscribe(other.second);
+
+    pair.second->close();
+    CHECK(pair.second->fd() == -1);
+
+    writers.forget(pair.second);
+    CHECK(poll.size() == 0);
+
+    fanout.unsubscribe(pair.second);
+    CHECK(fanout.size() == 1);
+
+    // The subscriber moved into the hole is still indexed
+    fanout.unsubscribe(other.second);
+    CHECK(fanout.size() == 0);
+}
+
+int main() {
+    watermarks();
+    fanout(Sockets::SlowConsumer::Evict);
+    fanout(Sockets::SlowConsumer::Skip);
+    disconnected();
+    dispatch();
+    closed_first();
+
+    return Check::result("writequeue");
+}